@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_BENCH_HPP_INCLUDED
+#define NANOMSGPP_BENCH_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdio>
+
+namespace bench {
+
+	typedef std::chrono::steady_clock clock;
+
+	// A stopwatch measures the wall time elapsed since it was constructed or restarted.
+	class stopwatch {
+		clock::time_point d_start;
+
+	public:
+		// Default constructor, starts the stopwatch.
+		stopwatch() : d_start(clock::now()) {}
+
+		// Restart the stopwatch.
+		void restart() { d_start = clock::now(); }
+
+		// Get the elapsed time in seconds.
+		double seconds() const {
+			return std::chrono::duration<double>(clock::now() - d_start).count();
+		}
+
+		// Get the elapsed time in nanoseconds.
+		double nanoseconds() const {
+			return std::chrono::duration<double, std::nano>(clock::now() - d_start).count();
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// One direction of a hand-off between two threads, over a channel or an inproc socket.
+	class link {
+		std::unique_ptr<nn::channel> d_channel;
+		std::unique_ptr<nn::socket>  d_in;
+		std::unique_ptr<nn::socket>  d_out;
+
+	public:
+		link(const std::string& kind, const std::string& addr) {
+			if ("inproc" == kind) {
+				d_in.reset(new nn::socket(nn::socket_domain::sp, nn::socket_type::pair));
+				d_out.reset(new nn::socket(nn::socket_domain::sp, nn::socket_type::pair));
+				d_in->bind(addr);
+				d_out->connect(addr);
+			} else {
+				d_channel.reset(new nn::channel(1024, ("spsc" == kind)
+					? nn::channel::mode::spsc : nn::channel::mode::mpmc));
+			}
+		}
+
+		void send(nn::message&& msg) {
+			if (d_channel) {
+				d_channel->sendmsg(std::move(msg), false);
+			} else {
+				d_out->sendmsg(std::move(msg), false);
+			}
+		}
+
+		std::unique_ptr<nn::message> receive() {
+			if (d_channel) {
+				return d_channel->recvmsg(false);
+			}
+			return d_in->recvmsg(1, false);
+		}
+	};
+
+	nn::message make(size_t size) {
+		nn::message msg;
+		msg << std::string(size, 'x');
+		return msg;
+	}
+
+	// Bounce a message between two threads n times, and then stream n messages one way,
+	// printing the round trip percentiles and the rate.
+	void run(const std::string& kind, size_t size, int n) {
+		link ping(kind, "inproc://channel_bench_ping_" + kind);
+		link pong(kind, "inproc://channel_bench_pong_" + kind);
+
+		std::thread echo([&]() {
+			for (int i = 0; i < n; ++i) {
+				pong.send(std::move(*ping.receive()));
+			}
+			for (int i = 0; i < n; ++i) {
+				ping.receive();
+			}
+		});
+
+		std::vector<double> rtt(n);
+		for (int i = 0; i < n; ++i) {
+			bench::stopwatch watch;
+			ping.send(make(size));
+			pong.receive();
+			rtt[i] = watch.nanoseconds();
+		}
+		std::sort(rtt.begin(), rtt.end());
+
+		bench::stopwatch watch;
+		for (int i = 0; i < n; ++i) {
+			ping.send(make(size));
+		}
+		echo.join();
+		double elapsed = watch.seconds();
+
+		std::printf("%-8s %8zu %12.0f %12.0f %14.0f\n", kind.c_str(), size, rtt[n / 2],
+			rtt[n * 99 / 100], n / elapsed);
+	}
+
+}
+
+// Compare handing messages between two threads over spsc and mpmc channels with an inproc
+// PAIR socket. Usage: channel_bench [messages] [size]
+int main(int argc, char const* argv[]) {
+	int n_messages = (argc > 1) ? std::atoi(argv[1]) : 100000;
+	size_t size    = (argc > 2) ? std::atoi(argv[2]) : 64;
+
+	try {
+		std::printf("%-8s %8s %12s %12s %14s\n", "", "size", "rtt p50 ns", "rtt p99 ns",
+			"messages/s");
+		for (const char* kind : { "spsc", "mpmc", "inproc" }) {
+			run(kind, size, n_messages);
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
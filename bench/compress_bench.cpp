@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Text resembling a feed of small JSON records.
+	std::string records(size_t n) {
+		std::string s;
+		for (size_t i = 0; s.size() < n; ++i) {
+			s += "{\"topic\":\"prices\",\"seq\":" + std::to_string(i) + ",\"bid\":"
+				+ std::to_string(100 + i % 17) + ".25,\"ask\":" + std::to_string(101 + i % 13)
+				+ ".5},";
+		}
+		s.resize(n);
+		return s;
+	}
+
+	// Bytes from a linear congruential generator, which do not compress.
+	std::string noise(size_t n) {
+		std::string s(n, '\0');
+		uint32_t x = 1;
+		for (auto& c : s) {
+			x = x * 1103515245 + 12345;
+			c = static_cast<char>(x >> 24);
+		}
+		return s;
+	}
+
+	// Compress and decompress the data until about total bytes have been processed, and print
+	// the ratio and the cost per MB.
+	void run(const char* name, const std::string& data, size_t total) {
+		nn::compressor c(0);
+		size_t rounds = std::max<size_t>(1, total / data.size());
+		for (size_t i = 0; i < rounds; ++i) {
+			size_t size;
+			void* packed = c.compress(data.data(), data.size(), 0, size);
+			if (packed != nullptr) {
+				nn_freemsg(c.decompress(packed, size, data.size(), 0));
+				nn_freemsg(packed);
+			}
+		}
+		nn::compressor::statistics s = c.get_statistics();
+		std::printf("%-10s %10zu %8.2f %14.0f %14.0f\n", name, data.size(), s.ratio(),
+			s.compress_ns_per_mb(), s.decompress_ns_per_mb());
+	}
+
+}
+
+// Measure the ratio and CPU cost of the built in codec. Usage: compress_bench [total MB]
+int main(int argc, char const* argv[]) {
+	size_t total = ((argc > 1) ? std::atoi(argv[1]) : 256) * size_t(1048576);
+
+	std::printf("%-10s %10s %8s %14s %14s\n", "data", "size", "ratio", "compress ns/MB",
+		"expand ns/MB");
+	for (size_t size = 256; size <= 1048576; size *= 16) {
+		run("records", records(size), total);
+	}
+	for (size_t size = 256; size <= 1048576; size *= 16) {
+		run("noise", noise(size), total);
+	}
+	return (EXIT_SUCCESS);
+}
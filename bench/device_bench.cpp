@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Push n_messages of the given size through a forwarder between two raw pipeline sockets,
+	// returning the messages per second seen by the consumer.
+	double run(const std::string& name, int n_messages, size_t size,
+			std::function<void(nn::socket&, nn::socket&)> forward) {
+		std::string in  = "inproc://device_bench_in_" + name;
+		std::string out = "inproc://device_bench_out_" + name;
+
+		nn::socket a(nn::socket_domain::sp_raw, nn::socket_type::pull);
+		a.bind(in);
+		nn::socket b(nn::socket_domain::sp_raw, nn::socket_type::push);
+		b.bind(out);
+
+		nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+		producer.connect(in);
+		nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+		consumer.connect(out);
+
+		forward(a, b);
+
+		std::string payload(size, 'x');
+		bench::stopwatch watch;
+		std::thread t([&]() {
+			for (int i = 0; i < n_messages; ++i) {
+				producer.send_raw(payload.data(), payload.size(), 0);
+			}
+		});
+		std::string buf(size, '\0');
+		for (int i = 0; i < n_messages; ++i) {
+			consumer.recv_raw(&buf[0], buf.size(), 0);
+		}
+		double elapsed = watch.seconds();
+		t.join();
+		return n_messages / elapsed;
+	}
+
+}
+
+// Compare the throughput of the device engine against nn_device, and measure the overhead of
+// device hooks. Usage: device_bench [messages] [size]
+int main(int argc, char const* argv[]) {
+	int n_messages = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+	size_t size    = (argc > 2) ? std::atoi(argv[2]) : 64;
+
+	try {
+		std::printf("%-20s %14s\n", "forwarder", "messages/s");
+		for (size_t n_workers = 1; n_workers <= 4; n_workers *= 2) {
+			std::unique_ptr<nn::device> d;
+			std::string name = "device/" + std::to_string(n_workers);
+			double rate = run(name, n_messages, size, [&](nn::socket& a, nn::socket& b) {
+				d.reset(new nn::device(a, b, n_workers));
+				d->start();
+			});
+			d.reset();
+			std::printf("%-20s %14.0f\n", name.c_str(), rate);
+		}
+
+		// measure the cost of each hook stage against the fast path without hooks
+		double base = 0;
+		std::printf("\n%-20s %14s %14s\n", "hooks", "messages/s", "ns/stage");
+		for (int n_hooks = 0; n_hooks <= 4; n_hooks = (0 == n_hooks) ? 1 : n_hooks * 2) {
+			std::unique_ptr<nn::device> d;
+			std::string name = "hooks/" + std::to_string(n_hooks);
+			double rate = run(name, n_messages, size, [&](nn::socket& a, nn::socket& b) {
+				d.reset(new nn::device(a, b));
+				for (int i = 0; i < n_hooks; ++i) {
+					d->add_hook([](nn::device::direction, nn::message_view& msg) {
+						return msg.size() == 0 || msg.data()[0] != 0;
+					});
+				}
+				d->start();
+			});
+			d.reset();
+			if (0 == n_hooks) {
+				base = rate;
+				std::printf("%-20s %14.0f %14s\n", name.c_str(), rate, "-");
+			} else {
+				double overhead = (1e9 / rate - 1e9 / base) / n_hooks;
+				std::printf("%-20s %14.0f %14.1f\n", name.c_str(), rate, overhead);
+			}
+		}
+
+		// nn_device only returns once the library is terminated, so it must run last
+		std::thread t;
+		double rate = run("nn_device", n_messages, size, [&](nn::socket& a, nn::socket& b) {
+			t = std::thread([&a, &b]() { nn_device(a.get_fd(), b.get_fd()); });
+		});
+		nn_term();
+		t.join();
+		std::printf("%-20s %14.0f\n", "nn_device", rate);
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Send n_messages of the given size to each of n_targets sockets with fan_out, and return
+	// the fan outs per second.
+	template<typename F>
+	double run(const std::string& name, int n_targets, int n_messages, size_t size, F fan_out) {
+		std::vector<nn::socket> targets;
+		std::vector<nn::socket> consumers;
+		for (int i = 0; i < n_targets; ++i) {
+			std::string addr = "inproc://fanout_bench_" + name + std::to_string(i);
+			targets.emplace_back(nn::socket_domain::sp, nn::socket_type::push);
+			targets.back().bind(addr);
+			consumers.emplace_back(nn::socket_domain::sp, nn::socket_type::pull);
+			consumers.back().connect(addr);
+		}
+
+		std::vector<std::thread> threads;
+		for (auto& c : consumers) {
+			threads.emplace_back([&c, n_messages, size]() {
+				std::string buf(size, '\0');
+				for (int i = 0; i < n_messages; ++i) {
+					c.recv_raw(&buf[0], buf.size(), 0);
+				}
+			});
+		}
+
+		std::string payload(size, 'x');
+		bench::stopwatch watch;
+		for (int i = 0; i < n_messages; ++i) {
+			fan_out(targets, payload);
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		return n_messages / watch.seconds();
+	}
+
+}
+
+// Compare fanning a payload out as a message per socket against a shared payload.
+// Usage: fanout_bench [messages] [size]
+int main(int argc, char const* argv[]) {
+	int n_messages = (argc > 1) ? std::atoi(argv[1]) : 100000;
+	size_t size    = (argc > 2) ? std::atoi(argv[2]) : 4096;
+
+	try {
+		std::printf("%8s %16s %16s\n", "targets", "message/s", "shared/s");
+		for (int n_targets : { 1, 4, 16 }) {
+			double per_socket = run("message", n_targets, n_messages, size,
+				[](std::vector<nn::socket>& targets, const std::string& payload) {
+					for (auto& t : targets) {
+						nn::message m;
+						m << nn::part(payload.data(), payload.size());
+						t.sendmsg(std::move(m), false);
+					}
+				});
+			double shared = run("shared", n_targets, n_messages, size,
+				[](std::vector<nn::socket>& targets, const std::string& payload) {
+					nn::shared_payload p(payload.data(), payload.size());
+					for (size_t i = 0; i + 1 < targets.size(); ++i) {
+						targets[i].sendmsg(p, false);
+					}
+					targets.back().sendmsg(std::move(p), false);
+				});
+			std::printf("%8d %16.0f %16.0f\n", n_targets, per_socket, shared);
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
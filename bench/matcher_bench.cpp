@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	typedef nn::prefix_matcher::isa isa;
+
+	const size_t width = 12;
+
+	std::string instrument(size_t i) {
+		std::string s = "XNAS:" + std::to_string(i * 7919 % 1000003);
+		s.resize(width, '_');
+		return s;
+	}
+
+	// Time n_messages lookups, returning the nanoseconds per lookup.
+	template<typename F>
+	double time(const std::vector<std::string>& messages, size_t n_messages, F lookup) {
+		size_t found = 0;
+		bench::stopwatch watch;
+		for (size_t i = 0; i < n_messages; ++i) {
+			const std::string& m = messages[i % messages.size()];
+			found += lookup(m);
+		}
+		double ns = watch.nanoseconds() / n_messages;
+		if (found > n_messages) {
+			std::printf("impossible\n");
+		}
+		return ns;
+	}
+
+	void run(size_t n_topics, size_t n_messages) {
+		std::vector<std::string> topics;
+		for (size_t i = 0; i < n_topics; ++i) {
+			topics.push_back(instrument(i));
+		}
+		// one message in four has a topic which is not subscribed to
+		std::vector<std::string> messages;
+		for (size_t i = 0; i < 4096; ++i) {
+			size_t k = (i * 2654435761u) % n_topics;
+			messages.push_back(((i % 4) ? topics[k] : instrument(n_topics + k)) + " bid=101.25");
+		}
+
+		nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+		nn::subscription_router router(sub);
+		for (auto& t : topics) {
+			router.subscribe(t, [](nn::message_view&) {});
+		}
+		std::printf("%10zu %10.1f", n_topics, time(messages, n_messages,
+			[&router](const std::string& m) {
+				return router.match(m.data(), m.size()) != nullptr;
+			}));
+
+		for (isa i : { isa::scalar, isa::sse42, isa::avx2 }) {
+			if (!nn::prefix_matcher::supported(i)) {
+				std::printf(" %10s", "-");
+				continue;
+			}
+			nn::prefix_matcher matcher(width, i);
+			for (size_t k = 0; k < topics.size(); ++k) {
+				matcher.insert(topics[k].data(), k);
+			}
+			std::printf(" %10.1f", time(messages, n_messages, [&matcher](const std::string& m) {
+				return matcher.find(m.data(), m.size()) != nn::prefix_matcher::npos;
+			}));
+		}
+		std::printf("\n");
+	}
+
+}
+
+// Compare the nanoseconds per lookup of fixed width topics in the subscription router trie and
+// in the prefix matcher with each instruction set. Usage: matcher_bench [messages]
+int main(int argc, char const* argv[]) {
+	size_t n_messages = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+
+	try {
+		std::printf("%10s %10s %10s %10s %10s\n", "topics", "trie", "scalar", "sse4.2", "avx2");
+		for (size_t n_topics : { 1000, 10000, 100000 }) {
+			run(n_topics, n_messages);
+		}
+	} catch (nn::exception &e) {
+		std::fprintf(stderr, "Error: %s.\n", e.what());
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
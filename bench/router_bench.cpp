@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	std::string topic(size_t i) {
+		return "market." + std::to_string(i * 7919 % 1000003) + ".quote";
+	}
+
+	// Match n_messages against n_topics topics, with the trie and with a chain of string
+	// compares, and print the nanoseconds per match.
+	void run(size_t n_topics, size_t n_messages) {
+		nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+		nn::subscription_router router(sub);
+		std::vector<std::string> topics;
+		uint64_t hits = 0;
+		for (size_t i = 0; i < n_topics; ++i) {
+			topics.push_back(topic(i));
+			router.subscribe(topics.back(), [&hits](nn::message_view&) { hits++; });
+		}
+
+		std::vector<std::string> messages;
+		for (size_t i = 0; i < 1024; ++i) {
+			messages.push_back(topics[(i * 2654435761u) % n_topics] + " bid=101.25 ask=101.5");
+		}
+
+		bench::stopwatch watch;
+		size_t matched = 0;
+		for (size_t i = 0; i < n_messages; ++i) {
+			const std::string& m = messages[i % messages.size()];
+			matched += (router.match(m.data(), m.size()) != nullptr);
+		}
+		double trie = watch.nanoseconds() / n_messages;
+
+		// the chain is quadratic in the topics, so it is run for fewer messages
+		size_t n_chain = std::max<size_t>(1000, n_messages / n_topics);
+		watch.restart();
+		for (size_t i = 0; i < n_chain; ++i) {
+			const std::string& m = messages[i % messages.size()];
+			for (auto& t : topics) {
+				if (m.compare(0, t.size(), t) == 0) {
+					matched++;
+					break;
+				}
+			}
+		}
+		double chain = watch.nanoseconds() / n_chain;
+
+		std::printf("%10zu %14.1f %14.1f %10zu\n", n_topics, trie, chain, matched);
+	}
+
+}
+
+// Measure the cost of matching a message to its topic with the subscription router.
+// Usage: router_bench [messages]
+int main(int argc, char const* argv[]) {
+	size_t n_messages = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+
+	try {
+		std::printf("%10s %14s %14s %10s\n", "topics", "trie ns", "compare ns", "matched");
+		for (size_t n_topics : { 10, 1000, 100000 }) {
+			run(n_topics, n_messages);
+		}
+	} catch (nn::exception &e) {
+		std::fprintf(stderr, "Error: %s.\n", e.what());
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
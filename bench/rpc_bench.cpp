@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+// Measure rpc_client throughput against an echo server as the number of requests in flight
+// grows. Usage: rpc_bench [address] [requests]
+int main(int argc, char const* argv[]) {
+	std::string addr = (argc > 1) ? argv[1] : "inproc://rpc_bench";
+	int n_requests   = (argc > 2) ? std::atoi(argv[2]) : 100000;
+
+	try {
+		nn::server srv(nn::socket_type::reply, [](nn::message& request) {
+			nn::message reply;
+			reply << *request.at(0).as<uint64_t>();
+			return reply;
+		});
+		srv.bind(addr);
+		srv.start();
+
+		std::printf("%-10s %14s %12s\n", "in-flight", "requests/s", "timeouts");
+		for (size_t depth = 1; depth <= 4096; depth *= 4) {
+			nn::rpc_client client(depth);
+			client.connect(addr);
+			client.start();
+
+			std::atomic<int> done(0);
+			bench::stopwatch watch;
+			for (int i = 0; i < n_requests; ++i) {
+				nn::message request;
+				request << uint64_t(i);
+				client.call(std::move(request), [&](std::unique_ptr<nn::message>, int) {
+					done++;
+				}, 5000);
+			}
+			while (done.load() < n_requests) {
+				std::this_thread::yield();
+			}
+			double elapsed = watch.seconds();
+			std::printf("%-10zu %14.0f %12llu\n", depth, n_requests / elapsed,
+				static_cast<unsigned long long>(client.timeouts()));
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
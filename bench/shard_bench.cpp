@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Publish n_messages from n_producers threads over n_shards shards, and return the
+	// messages per second received by a subscriber on each shard.
+	double run(size_t n_shards, int n_producers, int n_messages, size_t size) {
+		std::vector<std::string> endpoints;
+		for (size_t i = 0; i < n_shards; ++i) {
+			endpoints.push_back("inproc://shard_bench_" + std::to_string(n_shards) + "_"
+				+ std::to_string(i));
+		}
+		nn::sharded_publisher publisher(endpoints);
+
+		// one subscriber per shard, so receiving scales with the shards too
+		std::atomic<int> received(0);
+		std::atomic<bool> done(false);
+		std::vector<std::thread> consumers;
+		for (size_t i = 0; i < n_shards; ++i) {
+			consumers.emplace_back([&, i]() {
+				nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+				sub.set_option(NN_SUB, nn::socket_option::sub_subscribe, "");
+				sub.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 100);
+				sub.connect(endpoints[i]);
+				std::string buf(size, '\0');
+				while (!done.load()) {
+					if (nn_recv(sub.get_fd(), &buf[0], buf.size(), 0) >= 0) {
+						received.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			});
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		publisher.start();
+
+		bench::stopwatch watch;
+		std::vector<std::thread> producers;
+		for (int p = 0; p < n_producers; ++p) {
+			producers.emplace_back([&, p]() {
+				std::string body(size, 'x');
+				for (int i = 0; i < n_messages / n_producers; ++i) {
+					std::string topic = "T" + std::to_string((p * 7919 + i) % 1000) + ":";
+					body.replace(0, topic.size(), topic);
+					while (!publisher.publish(body.data(), body.size(), topic.size())) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (auto& t : producers) {
+			t.join();
+		}
+		publisher.stop();
+		double elapsed = watch.seconds();
+		done.store(true);
+		for (auto& t : consumers) {
+			t.join();
+		}
+		return received.load() / elapsed;
+	}
+
+}
+
+// Measure how publishing scales with the number of shards. Messages a subscriber cannot keep up
+// with are dropped by the PUB sockets, so the rate counts the messages received.
+// Usage: shard_bench [messages] [size]
+int main(int argc, char const* argv[]) {
+	int n_messages = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+	size_t size    = (argc > 2) ? std::atoi(argv[2]) : 64;
+
+	try {
+		std::printf("%8s %16s\n", "shards", "messages/s");
+		for (size_t n_shards = 1; n_shards <= 8; n_shards *= 2) {
+			double rate = run(n_shards, static_cast<int>(n_shards), n_messages, size);
+			std::printf("%8zu %16.0f\n", n_shards, rate);
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
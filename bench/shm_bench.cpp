@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// One end of a two way connection to the peer process.
+	class channel {
+	public:
+		virtual ~channel() {}
+
+		// Send a body of the given size, copying it from buf.
+		virtual void send(const char* buf, size_t size) = 0;
+
+		// Receive a message, reading its first byte in place, and return its size.
+		virtual size_t receive() = 0;
+
+		// Receive a message and send it back.
+		virtual void echo() = 0;
+	};
+
+	// A pair of shared memory rings, one for each direction.
+	class ring_channel : public channel {
+		std::unique_ptr<nn::shm_ring> d_out;
+		std::unique_ptr<nn::shm_ring> d_in;
+
+	public:
+		ring_channel(std::unique_ptr<nn::shm_ring> out, std::unique_ptr<nn::shm_ring> in)
+			: d_out(std::move(out))
+			, d_in(std::move(in)) {}
+
+		void send(const char* buf, size_t size) {
+			nn::shm_ring::slot s;
+			d_out->reserve(size, s, false);
+			std::memcpy(s.data, buf, size);
+			d_out->commit(s);
+		}
+
+		size_t receive() {
+			nn::shm_ring::slot s;
+			d_in->peek(s, false);
+			volatile unsigned char first = s.data[0];
+			(void) first;
+			d_in->release(s);
+			return s.size;
+		}
+
+		void echo() {
+			nn::shm_ring::slot in;
+			nn::shm_ring::slot out;
+			d_in->peek(in, false);
+			d_out->reserve(in.size, out, false);
+			std::memcpy(out.data, in.data, in.size);
+			d_out->commit(out);
+			d_in->release(in);
+		}
+	};
+
+	// A PAIR socket, receiving into chunks allocated by nanomsg.
+	class socket_channel : public channel {
+		nn::socket d_socket;
+
+	public:
+		socket_channel(const std::string& addr, bool bind)
+			: d_socket(nn::socket_domain::sp, nn::socket_type::pair) {
+			int unlimited = -1;
+			d_socket.set_option_raw(NN_SOL_SOCKET, NN_RCVMAXSIZE, &unlimited, sizeof(unlimited));
+			if (bind) {
+				d_socket.bind(addr);
+			} else {
+				d_socket.connect(addr);
+			}
+		}
+
+		void send(const char* buf, size_t size) {
+			d_socket.send_raw(buf, size, 0);
+		}
+
+		size_t receive() {
+			void* chunk = nullptr;
+			int nb = d_socket.recv_raw(&chunk, NN_MSG, 0);
+			volatile unsigned char first = *static_cast<unsigned char*>(chunk);
+			(void) first;
+			nn_freemsg(chunk);
+			return nb;
+		}
+
+		void echo() {
+			void* chunk = nullptr;
+			d_socket.recv_raw(&chunk, NN_MSG, 0);
+			d_socket.send_raw(&chunk, NN_MSG, 0);
+		}
+	};
+
+	const size_t ring_capacity = 64 * 1024 * 1024;
+
+	// The loop run by the peer process: echo n messages, then receive n messages and
+	// acknowledge them with a single message.
+	int peer(const std::string& transport, const std::string& out, const std::string& in, int n) {
+		std::unique_ptr<channel> c;
+		if ("shm" == transport) {
+			c.reset(new ring_channel(nn::shm_ring::attach(out), nn::shm_ring::attach(in)));
+		} else {
+			c.reset(new socket_channel(out, false));
+		}
+		for (int i = 0; i < n; ++i) {
+			c->echo();
+		}
+		for (int i = 0; i < n; ++i) {
+			c->receive();
+		}
+		c->send("k", 1);
+		return (EXIT_SUCCESS);
+	}
+
+	// Measure round trips and then one way throughput of size byte messages with a peer
+	// process, and print the results.
+	void run(const char* self, const std::string& transport, size_t size, int n) {
+		std::unique_ptr<channel> c;
+		std::string out;
+		std::string in;
+		if ("shm" == transport) {
+			std::unique_ptr<nn::shm_ring> to_peer = nn::shm_ring::create(ring_capacity);
+			std::unique_ptr<nn::shm_ring> from_peer = nn::shm_ring::create(ring_capacity);
+			out = from_peer->path();
+			in = to_peer->path();
+			c.reset(new ring_channel(std::move(to_peer), std::move(from_peer)));
+		} else {
+			out = in = ("ipc" == transport) ? "ipc:///tmp/nanomsgpp_shm_bench.ipc"
+				: "tcp://127.0.0.1:15899";
+			c.reset(new socket_channel(out, true));
+		}
+
+		pid_t child = fork();
+		if (0 == child) {
+			execl(self, self, "--peer", transport.c_str(), out.c_str(), in.c_str(),
+				std::to_string(n).c_str(), static_cast<char*>(nullptr));
+			_exit(EXIT_FAILURE);
+		}
+
+		std::string body(size, 'x');
+		std::vector<double> rtt(n);
+		for (int i = 0; i < n; ++i) {
+			bench::stopwatch watch;
+			c->send(body.data(), body.size());
+			c->receive();
+			rtt[i] = watch.nanoseconds();
+		}
+		std::sort(rtt.begin(), rtt.end());
+
+		bench::stopwatch watch;
+		for (int i = 0; i < n; ++i) {
+			c->send(body.data(), body.size());
+		}
+		c->receive();
+		double elapsed = watch.seconds();
+		waitpid(child, nullptr, 0);
+
+		std::printf("%-6s %10zu %12.0f %12.0f %14.0f %12.1f\n", transport.c_str(), size,
+			rtt[n / 2], rtt[n * 99 / 100], n / elapsed, n * double(size) / elapsed / 1e6);
+	}
+
+}
+
+// Compare a shared memory ring with nanomsg's ipc:// and tcp:// transports between two
+// processes, for round trip latency and one way throughput.
+// Usage: shm_bench [messages] [transport...]
+int main(int argc, char const* argv[]) {
+	if (argc > 5 && 0 == std::strcmp(argv[1], "--peer")) {
+		try {
+			return peer(argv[2], argv[3], argv[4], std::atoi(argv[5]));
+		} catch (nn::exception &e) {
+			std::cerr << "Peer error: " << e.what() << "." << std::endl;
+			return (EXIT_FAILURE);
+		}
+	}
+
+	int n_messages = (argc > 1) ? std::atoi(argv[1]) : 10000;
+	std::vector<std::string> transports;
+	for (int i = 2; i < argc; ++i) {
+		transports.push_back(argv[i]);
+	}
+	if (transports.empty()) {
+		transports = { "shm", "ipc", "tcp" };
+	}
+
+	try {
+		std::printf("%-6s %10s %12s %12s %14s %12s\n", "", "size", "rtt p50 ns", "rtt p99 ns",
+			"messages/s", "MB/s");
+		for (auto& t : transports) {
+			for (size_t size = 64; size <= 1024 * 1024; size *= 4) {
+				run("/proc/self/exe", t, size, n_messages);
+			}
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// How a pattern is measured: messages streamed one way, or bounced back by the peer.
+	enum class measure { throughput, latency };
+
+	// A pair of socket types, the first of which binds and sends.
+	struct pattern {
+		const char*     name;
+		nn::socket_type sender;
+		nn::socket_type receiver;
+		measure         kind;
+	};
+
+	const pattern patterns[] = {
+		{ "pair",                nn::socket_type::pair,      nn::socket_type::pair,       measure::throughput },
+		{ "push/pull",           nn::socket_type::push,      nn::socket_type::pull,       measure::throughput },
+		{ "pub/sub",             nn::socket_type::publish,   nn::socket_type::subscribe,  measure::throughput },
+		{ "bus",                 nn::socket_type::bus,       nn::socket_type::bus,        measure::throughput },
+		{ "pair",                nn::socket_type::pair,      nn::socket_type::pair,       measure::latency },
+		{ "req/rep",             nn::socket_type::request,   nn::socket_type::reply,      measure::latency },
+		{ "surveyor/respondent", nn::socket_type::surveyor,  nn::socket_type::respondent, measure::latency },
+	};
+
+	// The results of one pattern, transport and size.
+	struct result {
+		std::string pattern;
+		std::string transport;
+		const char* kind;
+		size_t      size;
+		int         sent;
+		int         received;
+		double      messages_per_second;
+		double      mb_per_second;
+		double      p50_ns;
+		double      p99_ns;
+		double      p999_ns;
+	};
+
+	struct options {
+		std::vector<std::string> transports;
+		std::vector<std::string> patterns;
+		size_t                   min_size;
+		size_t                   max_size;
+		double                   budget_mb;
+		int                      max_messages;
+		std::string              json;
+	};
+
+	std::vector<std::string> split(const std::string& list) {
+		std::vector<std::string> items;
+		std::stringstream in(list);
+		std::string item;
+		while (std::getline(in, item, ',')) {
+			items.push_back(item);
+		}
+		return items;
+	}
+
+	bool selected(const std::vector<std::string>& list, const std::string& name) {
+		return list.empty() || std::find(list.begin(), list.end(), name) != list.end();
+	}
+
+	// A new address on the transport, so every run gets fresh endpoints.
+	std::string address(const std::string& transport) {
+		static int next = 0;
+		int id = next++;
+		if ("inproc" == transport) {
+			return "inproc://socket_bench_" + std::to_string(id);
+		} else if ("ipc" == transport) {
+			return "ipc:///tmp/nanomsgpp_socket_bench_" + std::to_string(id) + ".ipc";
+		}
+		return "tcp://127.0.0.1:" + std::to_string(17000 + id);
+	}
+
+	// The number of messages to send of a size, spending about budget_mb on each run.
+	int message_count(const options& opts, size_t size, int minimum) {
+		double n = opts.budget_mb * 1024 * 1024 / size;
+		return std::max(minimum, std::min(opts.max_messages, static_cast<int>(n)));
+	}
+
+	nn::message make(const std::string& body) {
+		nn::message msg;
+		msg << body;
+		return msg;
+	}
+
+	void configure(nn::socket& s, nn::socket_type type) {
+		int unlimited = -1;
+		s.set_option_raw(NN_SOL_SOCKET, NN_RCVMAXSIZE, &unlimited, sizeof(unlimited));
+		if (nn::socket_type::subscribe == type) {
+			s.set_option(NN_SUB, nn::socket_option::sub_subscribe, "");
+		} else if (nn::socket_type::surveyor == type) {
+			s.set_option(NN_SURVEYOR, nn::socket_option::surveyor_deadline, 60000);
+		}
+	}
+
+	// Stream n messages from the sender to a receiving thread. Patterns which drop messages
+	// are measured by what arrives, with the receiver giving up once the stream goes quiet.
+	void stream(const pattern&, nn::socket& sender, nn::socket& receiver, size_t size, int n,
+			result& r) {
+		typedef std::chrono::steady_clock clock;
+		receiver.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+		std::atomic<int> received(0);
+		clock::time_point last;
+		std::thread sink([&]() {
+			try {
+				for (int i = 0; i < n; ++i) {
+					receiver.recvmsg(1, false);
+					received++;
+					last = clock::now();
+				}
+			} catch (nn::exception& e) {
+				// the stream went quiet, so the rest was dropped
+			}
+		});
+
+		std::string body(size, 'x');
+		clock::time_point start = clock::now();
+		for (int i = 0; i < n; ++i) {
+			sender.sendmsg(make(body), false);
+		}
+		sink.join();
+		double elapsed = std::chrono::duration<double>(last - start).count();
+		r.sent = n;
+		r.received = received.load();
+		r.messages_per_second = (elapsed > 0) ? r.received / elapsed : 0;
+		r.mb_per_second = r.messages_per_second * size / 1e6;
+	}
+
+	// Bounce n messages off an echoing thread and record the round trip percentiles.
+	void bounce(const pattern&, nn::socket& sender, nn::socket& receiver, size_t size, int n,
+			result& r) {
+		std::thread echo([&]() {
+			for (int i = 0; i < n; ++i) {
+				std::unique_ptr<nn::message> msg = receiver.recvmsg(1, false);
+				receiver.sendmsg(std::move(*msg), false);
+			}
+		});
+
+		std::string body(size, 'x');
+		std::vector<double> rtt(n);
+		bench::stopwatch total;
+		for (int i = 0; i < n; ++i) {
+			bench::stopwatch watch;
+			sender.sendmsg(make(body), false);
+			sender.recvmsg(1, false);
+			rtt[i] = watch.nanoseconds();
+		}
+		double elapsed = total.seconds();
+		echo.join();
+
+		std::sort(rtt.begin(), rtt.end());
+		r.sent = r.received = n;
+		r.messages_per_second = n / elapsed;
+		r.mb_per_second = r.messages_per_second * size / 1e6;
+		r.p50_ns = rtt[n / 2];
+		r.p99_ns = rtt[std::min<size_t>(n - 1, n * 99 / 100)];
+		r.p999_ns = rtt[std::min<size_t>(n - 1, n * 999 / 1000)];
+	}
+
+	result run(const pattern& p, const std::string& transport, size_t size, const options& opts) {
+		result r = { p.name, transport, (measure::throughput == p.kind) ? "throughput" : "latency",
+			size, 0, 0, 0, 0, 0, 0, 0 };
+		nn::socket sender(nn::socket_domain::sp, p.sender);
+		nn::socket receiver(nn::socket_domain::sp, p.receiver);
+		configure(sender, p.sender);
+		configure(receiver, p.receiver);
+		std::string addr = address(transport);
+		sender.bind(addr);
+		receiver.connect(addr);
+		// let the connection come up, so nothing sent by a PUB or BUS socket is lost to it
+		std::this_thread::sleep_for(std::chrono::milliseconds("inproc" == transport ? 10 : 100));
+
+		if (measure::throughput == p.kind) {
+			stream(p, sender, receiver, size, message_count(opts, size, 16), r);
+		} else {
+			bounce(p, sender, receiver, size, message_count(opts, size / 4 + 1, 16), r);
+		}
+		return r;
+	}
+
+	void print(const result& r) {
+		std::printf("%-20s %-10s %-7s %9zu %12.0f %10.1f", r.pattern.c_str(), r.kind,
+			r.transport.c_str(), r.size, r.messages_per_second, r.mb_per_second);
+		if (0 == std::strcmp(r.kind, "latency")) {
+			std::printf(" %11.0f %11.0f %11.0f\n", r.p50_ns, r.p99_ns, r.p999_ns);
+		} else {
+			std::printf(" %11s %11s %11s%s\n", "-", "-", "-",
+				(r.received < r.sent) ? "  (dropped)" : "");
+		}
+	}
+
+	bool write_json(const std::string& path, const std::vector<result>& results) {
+		FILE* out = std::fopen(path.c_str(), "w");
+		if (nullptr == out) {
+			return (false);
+		}
+		std::fprintf(out, "[\n");
+		for (size_t i = 0; i < results.size(); ++i) {
+			const result& r = results[i];
+			std::fprintf(out, "  {\"pattern\": \"%s\", \"kind\": \"%s\", \"transport\": \"%s\", "
+				"\"size\": %zu, \"sent\": %d, \"received\": %d, \"messages_per_second\": %.1f, "
+				"\"mb_per_second\": %.3f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f}%s\n",
+				r.pattern.c_str(), r.kind, r.transport.c_str(), r.size, r.sent, r.received,
+				r.messages_per_second, r.mb_per_second, r.p50_ns, r.p99_ns, r.p999_ns,
+				(i + 1 < results.size()) ? "," : "");
+		}
+		std::fprintf(out, "]\n");
+		return 0 == std::fclose(out);
+	}
+
+}
+
+// Measure throughput and round trip latency of each socket type pair over inproc, ipc and
+// loopback tcp, at message sizes from 16 B to 16 MB, through the socket and message API.
+// Usage: socket_bench [--json file] [--transports inproc,ipc,tcp] [--patterns req/rep,...]
+//                     [--min-size bytes] [--max-size bytes] [--budget mb] [--messages n]
+int main(int argc, char const* argv[]) {
+	options opts;
+	opts.transports = { "inproc", "ipc", "tcp" };
+	opts.min_size = 16;
+	opts.max_size = 16 * 1024 * 1024;
+	opts.budget_mb = 64;
+	opts.max_messages = 100000;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if ("--json" == arg) {
+			opts.json = argv[i + 1];
+		} else if ("--transports" == arg) {
+			opts.transports = split(argv[i + 1]);
+		} else if ("--patterns" == arg) {
+			opts.patterns = split(argv[i + 1]);
+		} else if ("--min-size" == arg) {
+			opts.min_size = std::strtoul(argv[i + 1], nullptr, 10);
+		} else if ("--max-size" == arg) {
+			opts.max_size = std::strtoul(argv[i + 1], nullptr, 10);
+		} else if ("--budget" == arg) {
+			opts.budget_mb = std::atof(argv[i + 1]);
+		} else if ("--messages" == arg) {
+			opts.max_messages = std::atoi(argv[i + 1]);
+		} else {
+			std::cerr << "Unknown option " << arg << "." << std::endl;
+			return (EXIT_FAILURE);
+		}
+	}
+
+	std::vector<result> results;
+	try {
+		std::printf("%-20s %-10s %-7s %9s %12s %10s %11s %11s %11s\n", "pattern", "measure",
+			"over", "size", "messages/s", "MB/s", "p50 ns", "p99 ns", "p99.9 ns");
+		for (const pattern& p : patterns) {
+			if (!selected(opts.patterns, p.name)) {
+				continue;
+			}
+			for (const std::string& t : opts.transports) {
+				for (size_t size = opts.min_size; size <= opts.max_size; size *= 4) {
+					results.push_back(run(p, t, size, opts));
+					print(results.back());
+				}
+			}
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	if (!opts.json.empty() && !write_json(opts.json, results)) {
+		std::cerr << "Error: cannot write " << opts.json << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
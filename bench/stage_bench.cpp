@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Spin for about the given number of nanoseconds, standing in for a CPU heavy step.
+	void spin(uint64_t ns) {
+		bench::stopwatch watch;
+		while (watch.nanoseconds() < ns) {
+		}
+	}
+
+	// Run n_messages through a stage with n_workers, each costing work_ns, and print the
+	// rate along with the reorder buffer's memory and latency.
+	void run(size_t n_workers, int n_messages, size_t size, uint64_t work_ns, size_t window) {
+		std::string suffix = std::to_string(n_workers);
+		nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+		nn::socket input(nn::socket_domain::sp, nn::socket_type::pull);
+		nn::socket output(nn::socket_domain::sp, nn::socket_type::push);
+		nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+		input.bind("inproc://stage_bench_in_" + suffix);
+		producer.connect("inproc://stage_bench_in_" + suffix);
+		consumer.bind("inproc://stage_bench_out_" + suffix);
+		output.connect("inproc://stage_bench_out_" + suffix);
+
+		nn::ordered_stage stage(input, output, n_workers, [work_ns](nn::message_view&) {
+			spin(work_ns);
+			return (true);
+		});
+		stage.set_window(window);
+		stage.start();
+
+		std::thread feeder([&]() {
+			std::string body(size, 'x');
+			for (int i = 0; i < n_messages; ++i) {
+				producer.send_raw(body.data(), body.size(), 0);
+			}
+		});
+		bench::stopwatch watch;
+		std::string buf(size, '\0');
+		for (int i = 0; i < n_messages; ++i) {
+			consumer.recv_raw(&buf[0], buf.size(), 0);
+		}
+		double elapsed = watch.seconds();
+		feeder.join();
+		stage.stop();
+
+		nn::ordered_stage::statistics st = stage.get_statistics();
+		double mean_wait = (0 == st.reordered) ? 0.0 : double(st.total_wait_ns) / st.reordered;
+		std::printf("%8zu %14.0f %10.1f%% %10zu %12zu %12.0f %12llu\n", n_workers,
+			n_messages / elapsed, 100.0 * st.reordered / n_messages, st.max_buffered,
+			st.max_buffered_bytes, mean_wait, static_cast<unsigned long long>(st.max_wait_ns));
+	}
+
+}
+
+// Measure how an ordered stage scales with its workers when each message costs work_ns of CPU,
+// and what restoring the order costs in reorder buffer memory and waiting time.
+// Usage: stage_bench [messages] [size] [work_ns] [window]
+int main(int argc, char const* argv[]) {
+	int n_messages  = (argc > 1) ? std::atoi(argv[1]) : 100000;
+	size_t size     = (argc > 2) ? std::atoi(argv[2]) : 256;
+	uint64_t work   = (argc > 3) ? std::atoi(argv[3]) : 10000;
+	size_t window   = (argc > 4) ? std::atoi(argv[4]) : 1024;
+
+	try {
+		std::printf("%8s %14s %11s %10s %12s %12s %12s\n", "workers", "messages/s", "reordered",
+			"max held", "max bytes", "mean wait ns", "max wait ns");
+		for (size_t n_workers = 1; n_workers <= 8; n_workers *= 2) {
+			run(n_workers, n_messages, size, work, window);
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.hpp"
+#include "alloc_counter.hpp"
+
+#include <nanomsgpp/nanomsgpp.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	const int batch_size = 1024;
+
+	// Whether the allocator wrappers of alloc_counter.cpp are counting.
+	const bool counting = test::alloc_counter::supported();
+
+	struct sample {
+		double ns;
+		double allocations;
+		double frees;
+	};
+
+	// Time n calls of op(i), running setup(i) for each call beforehand in untimed batches,
+	// and count the allocations and frees made by op.
+	template<typename Setup, typename Op>
+	sample measure(int n, Setup setup, Op op) {
+		sample s = { 0, 0, 0 };
+		for (int done = 0; done < n; done += batch_size) {
+			int count = std::min(batch_size, n - done);
+			for (int i = 0; i < count; ++i) {
+				setup(i);
+			}
+			test::alloc_counter counter;
+			bench::stopwatch watch;
+			for (int i = 0; i < count; ++i) {
+				op(i);
+			}
+			s.ns += watch.nanoseconds();
+			s.allocations += counter.allocations();
+			s.frees += counter.frees();
+		}
+		s.ns /= n;
+		s.allocations /= n;
+		s.frees /= n;
+		return s;
+	}
+
+	template<typename Op>
+	sample measure(int n, Op op) {
+		return measure(n, [](int) {}, op);
+	}
+
+	void report(const char* name, size_t size, const sample& s, const sample& baseline) {
+		std::printf("%-40s %7zu %10.1f %10.1f", name, size, s.ns, s.ns - baseline.ns);
+		if (counting) {
+			std::printf(" %9.2f %9.2f\n", s.allocations, s.frees);
+		} else {
+			std::printf(" %9s %9s\n", "n/a", "n/a");
+		}
+	}
+
+	void run(int n, size_t size) {
+		nn::socket a(nn::socket_domain::sp, nn::socket_type::pair);
+		nn::socket b(nn::socket_domain::sp, nn::socket_type::pair);
+		a.bind("inproc://wrapper_bench_" + std::to_string(size));
+		b.connect("inproc://wrapper_bench_" + std::to_string(size));
+		int fa = a.get_fd();
+		int fb = b.get_fd();
+		std::string body(size, 'x');
+		std::vector<char> buffer(size);
+		std::vector<nn::message> messages(batch_size);
+		std::vector<nn::msghdr_unique_ptr> headers(batch_size);
+
+		// the raw C API, which every wrapper operation is compared with
+		sample baseline = measure(n, [&](int) {
+			nn_send(fa, body.data(), body.size(), 0);
+			nn_recv(fb, buffer.data(), buffer.size(), 0);
+		});
+		sample none = { 0, 0, 0 };
+		report("nn_send + nn_recv", size, baseline, baseline);
+
+		report("nn_allocmsg zero-copy send + NN_MSG recv", size, measure(n, [&](int) {
+			void* chunk = nn_allocmsg(size, 0);
+			std::memcpy(chunk, body.data(), size);
+			nn_send(fa, &chunk, NN_MSG, 0);
+			void* received = nullptr;
+			nn_recv(fb, &received, NN_MSG, 0);
+			nn_freemsg(received);
+		}), baseline);
+
+		// the wrapper's own work, without any socket calls
+		report("part(ptr, size) copy", size, measure(n, [&](int) {
+			nn::part p(body.data(), body.size());
+		}), none);
+
+		report("message << std::string", size, measure(n, [&](int) {
+			nn::message m;
+			m << body;
+		}), none);
+
+		report("message::gen_nn_msghdr", size, measure(n, [&](int i) {
+			messages[i] = nn::message();
+			messages[i] << body;
+		}, [&](int i) {
+			headers[i] = messages[i].gen_nn_msghdr();
+		}), none);
+
+		// the wrapper's socket calls in place of the C API
+		report("socket::send_raw + socket::recv_raw", size, measure(n, [&](int) {
+			a.send_raw(body.data(), body.size(), 0);
+			b.recv_raw(buffer.data(), buffer.size(), 0);
+		}), baseline);
+
+		report("socket::sendmsg + nn_recv", size, measure(n, [&](int i) {
+			messages[i] = nn::message();
+			messages[i] << body;
+		}, [&](int i) {
+			a.sendmsg(std::move(messages[i]), false);
+			nn_recv(fb, buffer.data(), buffer.size(), 0);
+		}), baseline);
+
+		report("nn_send + socket::recvmsg", size, measure(n, [&](int) {
+			nn_send(fa, body.data(), body.size(), 0);
+			std::unique_ptr<nn::message> m = b.recvmsg(1, false);
+		}), baseline);
+
+		report("message << + sendmsg + recvmsg", size, measure(n, [&](int) {
+			nn::message m;
+			m << body;
+			a.sendmsg(std::move(m), false);
+			std::unique_ptr<nn::message> r = b.recvmsg(1, false);
+		}), baseline);
+	}
+
+}
+
+// Measure the cost the C++ layer adds to building, sending and receiving messages over
+// inproc, in ns per operation over the raw C API and allocations and frees per operation.
+// Usage: wrapper_bench [operations] [size...]
+int main(int argc, char const* argv[]) {
+	int n = (argc > 1) ? std::atoi(argv[1]) : 200000;
+	std::vector<size_t> sizes;
+	for (int i = 2; i < argc; ++i) {
+		sizes.push_back(std::atoi(argv[i]));
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 4096 };
+	}
+
+	try {
+		std::printf("%-40s %7s %10s %10s %9s %9s\n", "operation", "size", "ns/op", "added ns",
+			"allocs/op", "frees/op");
+		for (size_t size : sizes) {
+			run(n, size);
+		}
+	} catch (nn::exception &e) {
+		std::cerr << "Error: " << e.what() << "." << std::endl;
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
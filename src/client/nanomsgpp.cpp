@@ -205,6 +205,24 @@ rw_loop(nn::socket& socket, const options& ops) {
 	}
 }
 
+void
+survey_loop(nn::socket& socket, const options& ops) {
+	std::string data = ops.get_data();
+	nn::survey survey(socket);
+	while (true) {
+		nn::message m;
+		m << data;
+		survey.run(std::move(m), [&ops](nn::message_view& response) {
+			print_message_part(response.as<char>(), response.size(), ops);
+		});
+		if (ops.interval >= 0) {
+			std::this_thread::sleep_for(std::chrono::seconds(ops.interval));
+		} else {
+			break;
+		}
+	}
+}
+
 void
 resp_loop(nn::socket& socket, const options& ops) {
 	std::string data = ops.get_data();
@@ -272,6 +290,8 @@ int main(int argc, char const* argv[]) {
 			}
 			break;
 		case nn::socket_type::surveyor:
+			survey_loop(socket, ops);
+			break;
 		case nn::socket_type::request:
 			rw_loop(socket, ops);
 			break;
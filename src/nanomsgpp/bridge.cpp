@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/bridge.hpp"
+#include "nanomsgpp/message_view.hpp"
+#include <nanomsg/nn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	typedef std::chrono::steady_clock clock;
+
+	// A batch frame starts with a version byte, a flags byte, two reserved bytes and the
+	// number of records. Each record holds the header size, the body size, the header and the
+	// body. Integers are little endian. When the frame is compressed, the records are replaced
+	// by their size before compression and the compressed records.
+	const unsigned char frame_version = 1;
+	const unsigned char frame_compressed = 0x01;
+	const size_t        frame_header_size = 8;
+	const size_t        compressed_header_size = 12;
+	const size_t        record_header_size = 8;
+
+	void put_u32(unsigned char* p, uint32_t v) {
+		p[0] = static_cast<unsigned char>(v);
+		p[1] = static_cast<unsigned char>(v >> 8);
+		p[2] = static_cast<unsigned char>(v >> 16);
+		p[3] = static_cast<unsigned char>(v >> 24);
+	}
+
+	uint32_t get_u32(const unsigned char* p) {
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16)
+			| (uint32_t(p[3]) << 24);
+	}
+
+	// Receive a message into NN_MSG body and control chunks.
+	int recv_chunk(int fd, void** body, void** control, struct nn_iovec* iov,
+			struct nn_msghdr* hdr) {
+		iov->iov_base = body;
+		iov->iov_len = NN_MSG;
+		std::memset(hdr, 0, sizeof(*hdr));
+		hdr->msg_iov = iov;
+		hdr->msg_iovlen = 1;
+		hdr->msg_control = control;
+		hdr->msg_controllen = NN_MSG;
+		return nn_recvmsg(fd, hdr, NN_DONTWAIT);
+	}
+
+	void free_chunks(void* body, void* control) {
+		nn_freemsg(body);
+		if (control != nullptr) {
+			nn_freemsg(control);
+		}
+	}
+
+	// Get the bucket of the batch size distribution for a batch of n messages.
+	size_t bucket_of(uint32_t n) {
+		size_t i = 0;
+		while (n > 1 && i < bridge::n_buckets - 1) {
+			n >>= 1;
+			i++;
+		}
+		return i;
+	}
+
+	bool is_fatal(int error) {
+		return error == ETERM || error == EBADF;
+	}
+
+}
+
+const size_t bridge::n_buckets;
+
+bridge::bridge(socket& from, socket& to, mode m)
+	: d_from(from)
+	, d_to(to)
+	, d_mode(m)
+	, d_compressor(nullptr)
+	, d_max_batch_size(64 * 1024)
+	, d_max_latency(1000)
+	, d_poll_interval(100)
+	, d_drain_timeout(1000)
+	, d_running(false)
+	, d_frame(nullptr)
+	, d_frame_capacity(0)
+	, d_frame_size(0)
+	, d_frame_count(0)
+	, d_messages_in(0)
+	, d_messages_out(0)
+	, d_bytes_in(0)
+	, d_bytes_out(0)
+	, d_batches(0)
+	, d_flushed_by_size(0)
+	, d_flushed_by_time(0)
+	, d_flushed_by_stop(0)
+	, d_dropped(0)
+	, d_errors(0)
+{
+	for (auto& b : d_batch_sizes) {
+		b.store(0);
+	}
+}
+
+bridge::~bridge() {
+	stop();
+}
+
+void
+bridge::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	if (d_thread.joinable()) {
+		d_thread.join();
+	}
+	if (mode::batch == d_mode) {
+		d_thread = std::thread(&bridge::batch_loop, this);
+	} else {
+		d_thread = std::thread(&bridge::split_loop, this);
+	}
+}
+
+void
+bridge::stop() {
+	d_running.store(false);
+	if (d_thread.joinable()) {
+		d_thread.join();
+	}
+}
+
+bridge::statistics
+bridge::get_statistics() const {
+	statistics s;
+	s.messages_in     = d_messages_in.load(std::memory_order_relaxed);
+	s.messages_out    = d_messages_out.load(std::memory_order_relaxed);
+	s.bytes_in        = d_bytes_in.load(std::memory_order_relaxed);
+	s.bytes_out       = d_bytes_out.load(std::memory_order_relaxed);
+	s.batches         = d_batches.load(std::memory_order_relaxed);
+	s.flushed_by_size = d_flushed_by_size.load(std::memory_order_relaxed);
+	s.flushed_by_time = d_flushed_by_time.load(std::memory_order_relaxed);
+	s.flushed_by_stop = d_flushed_by_stop.load(std::memory_order_relaxed);
+	s.dropped         = d_dropped.load(std::memory_order_relaxed);
+	s.errors          = d_errors.load(std::memory_order_relaxed);
+	for (auto& b : d_batch_sizes) {
+		s.batch_sizes.push_back(b.load(std::memory_order_relaxed));
+	}
+	return s;
+}
+
+void
+bridge::batch_loop() {
+	int from = d_from.get_fd();
+	clock::time_point deadline;
+	while (d_running.load(std::memory_order_relaxed)) {
+		if (d_frame_count > 0 && clock::now() >= deadline) {
+			flush(flush_reason::time);
+		}
+
+		void* body = nullptr;
+		void* control = nullptr;
+		struct nn_iovec iov;
+		struct nn_msghdr hdr;
+		int nb = recv_chunk(from, &body, &control, &iov, &hdr);
+		if (nb >= 0) {
+			message_view view(&hdr, nb);
+			if (0 == d_frame_count) {
+				deadline = clock::now() + std::chrono::microseconds(d_max_latency);
+			}
+			append(view.data(), view.size(), view.header(), view.header_size());
+			free_chunks(body, control);
+			d_messages_in.fetch_add(1, std::memory_order_relaxed);
+			d_bytes_in.fetch_add(nb, std::memory_order_relaxed);
+			continue;
+		}
+		if (nn_errno() != EAGAIN) {
+			if (is_fatal(nn_errno())) {
+				break;
+			}
+			continue;
+		}
+
+		// wait for the next message, but no longer than the pending batch may wait. nn_poll
+		// has millisecond resolution, so the wait is rounded up to the next millisecond
+		int timeout = d_poll_interval;
+		if (d_frame_count > 0) {
+			auto left = std::chrono::duration_cast<std::chrono::microseconds>
+				(deadline - clock::now()).count();
+			timeout = std::min<int>(timeout, std::max<int>(0, (left + 999) / 1000));
+		}
+		struct nn_pollfd pfd = { from, NN_POLLIN, 0 };
+		if (-1 == nn_poll(&pfd, 1, timeout) && is_fatal(nn_errno())) {
+			break;
+		}
+	}
+	if (d_frame_count > 0) {
+		flush(flush_reason::stop);
+	}
+	if (d_frame != nullptr) {
+		nn_freemsg(d_frame);
+		d_frame = nullptr;
+	}
+}
+
+void
+bridge::append(const void* body, size_t size, const unsigned char* header, size_t header_size) {
+	size_t record = record_header_size + header_size + size;
+	if (d_frame_count > 0 && d_frame_size + record > d_max_batch_size) {
+		flush(flush_reason::size);
+	}
+	if (d_frame != nullptr && d_frame_size + record > d_frame_capacity) {
+		void* frame = nn_reallocmsg(d_frame, d_frame_size + record);
+		if (nullptr == frame) {
+			// the batch is left intact, so send it and start a new one for this message
+			flush(flush_reason::size);
+		} else {
+			d_frame = frame;
+			d_frame_capacity = d_frame_size + record;
+		}
+	}
+	if (nullptr == d_frame) {
+		d_frame_capacity = std::max(d_max_batch_size, frame_header_size + record);
+		d_frame = nn_allocmsg(d_frame_capacity, 0);
+		d_frame_size = frame_header_size;
+		if (nullptr == d_frame) {
+			d_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	unsigned char* p = static_cast<unsigned char*>(d_frame) + d_frame_size;
+	put_u32(p, static_cast<uint32_t>(header_size));
+	put_u32(p + 4, static_cast<uint32_t>(size));
+	if (header_size > 0) {
+		std::memcpy(p + record_header_size, header, header_size);
+	}
+	std::memcpy(p + record_header_size + header_size, body, size);
+	d_frame_size += record;
+	d_frame_count++;
+}
+
+void
+bridge::flush(flush_reason reason) {
+	unsigned char* p = static_cast<unsigned char*>(d_frame);
+	p[0] = frame_version;
+	p[1] = 0;
+	p[2] = 0;
+	p[3] = 0;
+	put_u32(p + 4, d_frame_count);
+
+	void* frame = nullptr;
+	size_t size = d_frame_size;
+	if (d_compressor != nullptr) {
+		size_t records = d_frame_size - frame_header_size;
+		frame = d_compressor->compress(p + frame_header_size, records, compressed_header_size,
+			size);
+		if (frame != nullptr) {
+			unsigned char* c = static_cast<unsigned char*>(frame);
+			std::memcpy(c, p, frame_header_size);
+			c[1] |= frame_compressed;
+			put_u32(c + frame_header_size, static_cast<uint32_t>(records));
+			nn_freemsg(d_frame);
+		} else {
+			d_compressor->skipped(records);
+			size = d_frame_size;
+		}
+	}
+	if (nullptr == frame) {
+		// shrink the chunk to the frame, which nanomsg does in place. If that fails the
+		// whole chunk is sent, as the splitter ignores the bytes after the last record
+		frame = nn_reallocmsg(d_frame, d_frame_size);
+		if (nullptr == frame) {
+			frame = d_frame;
+			size = d_frame_capacity;
+		}
+	}
+	uint32_t count = d_frame_count;
+	d_frame = nullptr;
+	d_frame_size = 0;
+	d_frame_count = 0;
+
+	d_batches.fetch_add(1, std::memory_order_relaxed);
+	d_batch_sizes[bucket_of(count)].fetch_add(1, std::memory_order_relaxed);
+	switch (reason) {
+	case flush_reason::size:
+		d_flushed_by_size.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case flush_reason::time:
+		d_flushed_by_time.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case flush_reason::stop:
+		d_flushed_by_stop.fetch_add(1, std::memory_order_relaxed);
+		break;
+	}
+	if (send(frame, nullptr, 0)) {
+		d_messages_out.fetch_add(1, std::memory_order_relaxed);
+		d_bytes_out.fetch_add(size, std::memory_order_relaxed);
+	} else {
+		d_dropped.fetch_add(count, std::memory_order_relaxed);
+	}
+}
+
+void
+bridge::split_loop() {
+	int from = d_from.get_fd();
+	while (d_running.load(std::memory_order_relaxed)) {
+		void* body = nullptr;
+		void* control = nullptr;
+		struct nn_iovec iov;
+		struct nn_msghdr hdr;
+		int nb = recv_chunk(from, &body, &control, &iov, &hdr);
+		if (-1 == nb) {
+			if (is_fatal(nn_errno())) {
+				break;
+			}
+			struct nn_pollfd pfd = { from, NN_POLLIN, 0 };
+			if (-1 == nn_poll(&pfd, 1, d_poll_interval) && is_fatal(nn_errno())) {
+				break;
+			}
+			continue;
+		}
+		d_messages_in.fetch_add(1, std::memory_order_relaxed);
+		d_bytes_in.fetch_add(nb, std::memory_order_relaxed);
+
+		const unsigned char* p = static_cast<const unsigned char*>(body);
+		const unsigned char* end = p + nb;
+		if (nb < static_cast<int>(frame_header_size) || p[0] != frame_version) {
+			d_errors.fetch_add(1, std::memory_order_relaxed);
+			free_chunks(body, control);
+			continue;
+		}
+		uint32_t count = get_u32(p + 4);
+
+		// a compressed frame is split from a decompressed copy of its records
+		void* records = nullptr;
+		if (p[1] & frame_compressed) {
+			if (nb >= static_cast<int>(compressed_header_size) && d_compressor != nullptr) {
+				size_t size = get_u32(p + frame_header_size);
+				records = d_compressor->decompress(p + compressed_header_size,
+					nb - compressed_header_size, size, 0);
+				p = static_cast<const unsigned char*>(records);
+				end = p + size;
+			}
+			if (nullptr == records) {
+				d_errors.fetch_add(1, std::memory_order_relaxed);
+				free_chunks(body, control);
+				continue;
+			}
+		} else {
+			p += frame_header_size;
+		}
+		uint32_t i = 0;
+		for (; i < count; ++i) {
+			if (static_cast<size_t>(end - p) < record_header_size) {
+				break;
+			}
+			size_t header_size = get_u32(p);
+			size_t size = get_u32(p + 4);
+			if (static_cast<size_t>(end - p) - record_header_size < header_size + size) {
+				break;
+			}
+			const unsigned char* header = p + record_header_size;
+			void* chunk = nn_allocmsg(size, 0);
+			if (nullptr == chunk) {
+				break;
+			}
+			std::memcpy(chunk, header + header_size, size);
+			if (send(chunk, header, header_size)) {
+				d_messages_out.fetch_add(1, std::memory_order_relaxed);
+				d_bytes_out.fetch_add(size, std::memory_order_relaxed);
+			} else {
+				d_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			p += record_header_size + header_size + size;
+		}
+		if (i < count) {
+			d_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		d_batches.fetch_add(1, std::memory_order_relaxed);
+		d_batch_sizes[bucket_of(count)].fetch_add(1, std::memory_order_relaxed);
+		free_chunks(body, control);
+		if (records != nullptr) {
+			nn_freemsg(records);
+		}
+	}
+}
+
+bool
+bridge::send(void* chunk, const unsigned char* header, size_t header_size) {
+	int to = d_to.get_fd();
+	struct nn_iovec iov = { &chunk, NN_MSG };
+	struct nn_msghdr hdr;
+	std::memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = &iov;
+	hdr.msg_iovlen = 1;
+
+	// the protocol header is passed as SP_HDR control data, which nanomsg copies. backtraces
+	// are short, so the control data is built on the stack unless the header is unusually long
+	size_t stack[32];
+	std::vector<size_t> heap;
+	if (header_size > 0) {
+		size_t len = sizeof(size_t) + header_size;
+		size_t words = (NN_CMSG_SPACE(len) + sizeof(size_t) - 1) / sizeof(size_t);
+		size_t* control = stack;
+		if (words > sizeof(stack) / sizeof(stack[0])) {
+			heap.resize(words);
+			control = heap.data();
+		}
+		std::memset(control, 0, words * sizeof(size_t));
+		struct nn_cmsghdr* cmsg = reinterpret_cast<nn_cmsghdr*>(control);
+		cmsg->cmsg_len   = NN_CMSG_LEN(len);
+		cmsg->cmsg_level = PROTO_SP;
+		cmsg->cmsg_type  = SP_HDR;
+		std::memcpy(NN_CMSG_DATA(cmsg), &header_size, sizeof(header_size));
+		std::memcpy(NN_CMSG_DATA(cmsg) + sizeof(header_size), header, header_size);
+		hdr.msg_control = control;
+		hdr.msg_controllen = NN_CMSG_SPACE(len);
+	}
+
+	clock::time_point deadline;
+	bool draining = false;
+	while (true) {
+		if (nn_sendmsg(to, &hdr, NN_DONTWAIT) >= 0) {
+			return (true);
+		}
+		int error = nn_errno();
+		if (error == EAGAIN) {
+			if (!d_running.load(std::memory_order_relaxed)) {
+				if (!draining) {
+					draining = true;
+					deadline = clock::now() + std::chrono::milliseconds(d_drain_timeout);
+				} else if (clock::now() >= deadline) {
+					break;
+				}
+			}
+			struct nn_pollfd pfd = { to, NN_POLLOUT, 0 };
+			if (nn_poll(&pfd, 1, d_poll_interval) >= 0 || !is_fatal(nn_errno())) {
+				continue;
+			}
+		}
+		break;
+	}
+	nn_freemsg(chunk);
+	return (false);
+}
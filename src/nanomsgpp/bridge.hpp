@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_BRIDGE_HPP_INCLUDED
+#define NANOMSGPP_BRIDGE_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#ifndef NANOMSGPP_COMPRESSOR_HPP_INCLUDED
+#	include "compressor.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A bridge forwards messages in one direction over a slow link. In batch mode it coalesces
+	// the messages received from one socket into batch frames, bounded by size and by a maximum
+	// latency, and in split mode it turns batch frames back into the original messages. The
+	// protocol header of every message is carried inside the frame, so a pair of bridges is
+	// transparent to the sockets on either side.
+	class bridge {
+	public:
+		enum class mode {
+			// Coalesce messages into batch frames.
+			batch,
+
+			// Split batch frames into messages.
+			split,
+		};
+
+		// The number of buckets in the batch size distribution.
+		static const size_t n_buckets = 17;
+
+		// A snapshot of the bridge counters.
+		struct statistics {
+			uint64_t messages_in;      // number of messages or frames received
+			uint64_t messages_out;     // number of messages or frames sent
+			uint64_t bytes_in;         // number of bytes received
+			uint64_t bytes_out;        // number of bytes sent
+			uint64_t batches;          // number of batch frames built or split
+			uint64_t flushed_by_size;  // number of batches sent because they were full
+			uint64_t flushed_by_time;  // number of batches sent because of the latency cap
+			uint64_t flushed_by_stop;  // number of batches sent because the bridge stopped
+			uint64_t dropped;          // number of messages which could not be sent
+			uint64_t errors;           // number of malformed frames received
+
+			// batch_sizes[i] counts the batches of at least 2^i and less than 2^(i+1) messages,
+			// and the last bucket counts every larger batch.
+			std::vector<uint64_t> batch_sizes;
+		};
+
+	private:
+		// The reason a batch is sent.
+		enum class flush_reason {
+			size,
+			time,
+			stop,
+		};
+
+		socket&               d_from;
+		socket&               d_to;
+		mode                  d_mode;
+		compressor*           d_compressor;
+		size_t                d_max_batch_size;
+		int                   d_max_latency;
+		int                   d_poll_interval;
+		int                   d_drain_timeout;
+		std::thread           d_thread;
+		std::atomic<bool>     d_running;
+
+		// the batch being built
+		void*                 d_frame;
+		size_t                d_frame_capacity;
+		size_t                d_frame_size;
+		uint32_t              d_frame_count;
+
+		std::atomic<uint64_t> d_messages_in;
+		std::atomic<uint64_t> d_messages_out;
+		std::atomic<uint64_t> d_bytes_in;
+		std::atomic<uint64_t> d_bytes_out;
+		std::atomic<uint64_t> d_batches;
+		std::atomic<uint64_t> d_flushed_by_size;
+		std::atomic<uint64_t> d_flushed_by_time;
+		std::atomic<uint64_t> d_flushed_by_stop;
+		std::atomic<uint64_t> d_dropped;
+		std::atomic<uint64_t> d_errors;
+		std::atomic<uint64_t> d_batch_sizes[n_buckets];
+
+	public:
+		// Construct a bridge forwarding messages from one socket to another.
+		bridge(socket& from, socket& to, mode m);
+
+		// Destructor, stops the bridge.
+		~bridge();
+
+		// MANIPULATORS
+
+		// Set the maximum size of a batch frame in bytes. A larger message is sent in a batch of
+		// its own.
+		void set_max_batch_size(size_t bytes) { d_max_batch_size = bytes; }
+
+		// Set the maximum time, in microseconds, a message waits in a batch before it is sent.
+		// The bridge waits on its socket with millisecond resolution, so a batch may be sent up
+		// to a millisecond after the cap.
+		void set_max_latency(int us) { d_max_latency = us; }
+
+		// Compress batch frames, or decompress them in split mode, with the given compressor.
+		// Both bridges of a link need a compressor, and frames smaller than its threshold are
+		// sent uncompressed.
+		void set_compressor(compressor& c) { d_compressor = &c; }
+
+		// Set how often, in milliseconds, the bridge checks whether it has been stopped.
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// Set how long, in milliseconds, stop() waits for pending messages to be sent.
+		void set_drain_timeout(int ms) { d_drain_timeout = ms; }
+
+		// Start the forwarding thread.
+		void start();
+
+		// Stop receiving messages, send the pending batch and join the forwarding thread.
+		void stop();
+
+		// Check whether the bridge is running.
+		bool running() const { return d_running.load(); }
+
+		// Get a snapshot of the bridge counters.
+		statistics get_statistics() const;
+
+	private:
+		// The loop run in batch mode.
+		void batch_loop();
+
+		// The loop run in split mode.
+		void split_loop();
+
+		// Append a message to the batch, flushing the batch first if the message does not fit.
+		void append(const void* body, size_t size, const unsigned char* header,
+			size_t header_size);
+
+		// Send the batch.
+		void flush(flush_reason reason);
+
+		// Send a message chunk with the given protocol header, retrying until it is sent or the
+		// drain timeout expires.
+		bool send(void* chunk, const unsigned char* header, size_t header_size);
+
+		// NOT IMPLEMENTED
+		bridge() = delete;
+		bridge(const bridge& other) = delete;
+		bridge& operator=(const bridge& other) = delete;
+	};
+
+}
+
+#endif
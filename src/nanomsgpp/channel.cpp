@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/channel.hpp"
+#include "nanomsgpp/poller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// The number of times a blocking call checks the channel before sleeping.
+	const int spin_count = 128;
+
+	size_t body_size(message& msg) {
+		size_t size = 0;
+		for (auto& p : msg) {
+			size += p.size();
+		}
+		return size;
+	}
+
+}
+
+channel::channel(size_t capacity, mode m)
+	: d_mask(0)
+	, d_mode(m)
+	, d_timeout(-1)
+	, d_tail(0)
+	, d_head_seen(0)
+	, d_head(0)
+	, d_tail_seen(0)
+	, d_waiters(0)
+{
+	size_t rounded = 2;
+	while (rounded < capacity) {
+		rounded *= 2;
+	}
+	d_mask = rounded - 1;
+	d_cells.reset(new cell[rounded]);
+	for (size_t i = 0; i < rounded; ++i) {
+		d_cells[i].d_sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void*
+channel::operator new(size_t size) {
+	void* p = nullptr;
+	if (0 != posix_memalign(&p, alignof(channel), size)) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void
+channel::operator delete(void* p) {
+	std::free(p);
+}
+
+channel::~channel() {
+	message msg;
+	while (pop(msg)) {
+	}
+	std::lock_guard<std::mutex> lock(d_lock);
+	for (poller* p : d_pollers) {
+		p->forget(this);
+	}
+}
+
+int
+channel::sendmsg(message&& msg, bool dont_wait) {
+	int size = static_cast<int>(body_size(msg));
+	if (!push(msg)) {
+		if (dont_wait || !wait([this, &msg]() { return push(msg); })) {
+			return -1;
+		}
+	}
+	notify();
+	return size;
+}
+
+std::unique_ptr<message>
+channel::recvmsg(bool dont_wait) {
+	std::unique_ptr<message> msg(new message());
+	if (!recvmsg(*msg, dont_wait)) {
+		msg.reset();
+	}
+	return msg;
+}
+
+bool
+channel::recvmsg(message& msg, bool dont_wait) {
+	if (!pop(msg)) {
+		if (dont_wait || !wait([this, &msg]() { return pop(msg); })) {
+			return (false);
+		}
+	}
+	notify();
+	return (true);
+}
+
+bool
+channel::readable() const {
+	if (mode::spsc == d_mode) {
+		return d_head.load(std::memory_order_acquire) != d_tail.load(std::memory_order_acquire);
+	}
+	uint64_t head = d_head.load(std::memory_order_acquire);
+	return d_cells[head & d_mask].d_sequence.load(std::memory_order_acquire) == head + 1;
+}
+
+bool
+channel::writable() const {
+	if (mode::spsc == d_mode) {
+		return d_tail.load(std::memory_order_acquire) - d_head.load(std::memory_order_acquire)
+			<= d_mask;
+	}
+	uint64_t tail = d_tail.load(std::memory_order_acquire);
+	return d_cells[tail & d_mask].d_sequence.load(std::memory_order_acquire) == tail;
+}
+
+bool
+channel::push(message& msg) {
+	uint64_t tail;
+	if (mode::spsc == d_mode) {
+		tail = d_tail.load(std::memory_order_relaxed);
+		if (tail - d_head_seen > d_mask) {
+			d_head_seen = d_head.load(std::memory_order_acquire);
+			if (tail - d_head_seen > d_mask) {
+				return (false);
+			}
+		}
+		new (&d_cells[tail & d_mask].d_message) message(std::move(msg));
+		d_tail.store(tail + 1, std::memory_order_release);
+		return (true);
+	}
+
+	// each cell's sequence says which lap of the ring may use it next, so producers claim a
+	// cell by advancing the tail only when the consumer of the previous lap is done with it
+	tail = d_tail.load(std::memory_order_relaxed);
+	cell* c;
+	while (true) {
+		c = &d_cells[tail & d_mask];
+		int64_t diff = static_cast<int64_t>(c->d_sequence.load(std::memory_order_acquire) - tail);
+		if (0 == diff) {
+			if (d_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return (false);
+		} else {
+			tail = d_tail.load(std::memory_order_relaxed);
+		}
+	}
+	new (&c->d_message) message(std::move(msg));
+	c->d_sequence.store(tail + 1, std::memory_order_release);
+	return (true);
+}
+
+bool
+channel::pop(message& msg) {
+	uint64_t head;
+	if (mode::spsc == d_mode) {
+		head = d_head.load(std::memory_order_relaxed);
+		if (head == d_tail_seen) {
+			d_tail_seen = d_tail.load(std::memory_order_acquire);
+			if (head == d_tail_seen) {
+				return (false);
+			}
+		}
+		message* stored = reinterpret_cast<message*>(&d_cells[head & d_mask].d_message);
+		msg = std::move(*stored);
+		stored->~message();
+		d_head.store(head + 1, std::memory_order_release);
+		return (true);
+	}
+
+	head = d_head.load(std::memory_order_relaxed);
+	cell* c;
+	while (true) {
+		c = &d_cells[head & d_mask];
+		int64_t diff = static_cast<int64_t>(
+			c->d_sequence.load(std::memory_order_acquire) - (head + 1));
+		if (0 == diff) {
+			if (d_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return (false);
+		} else {
+			head = d_head.load(std::memory_order_relaxed);
+		}
+	}
+	message* stored = reinterpret_cast<message*>(&c->d_message);
+	msg = std::move(*stored);
+	stored->~message();
+	c->d_sequence.store(head + d_mask + 1, std::memory_order_release);
+	return (true);
+}
+
+void
+channel::notify() {
+	// pairs with the increment of d_waiters by a waiter before it checks the channel again,
+	// so either the waiter sees this change or this sees the waiter
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (0 == d_waiters.load(std::memory_order_relaxed)) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(d_lock);
+	d_cond.notify_all();
+	for (poller* p : d_pollers) {
+		p->wake();
+	}
+}
+
+template<typename Ready>
+bool
+channel::wait(Ready ready) {
+	for (int i = 0; i < spin_count; ++i) {
+		std::this_thread::yield();
+		if (ready()) {
+			return (true);
+		}
+	}
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(d_timeout);
+	std::unique_lock<std::mutex> lock(d_lock);
+	d_waiters.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	bool done = ready();
+	while (!done) {
+		if (d_timeout < 0) {
+			d_cond.wait(lock);
+		} else if (std::cv_status::timeout == d_cond.wait_until(lock, deadline)) {
+			done = ready();
+			break;
+		}
+		done = ready();
+	}
+	d_waiters.fetch_sub(1);
+	return done;
+}
+
+void
+channel::attach(poller* p) {
+	std::lock_guard<std::mutex> lock(d_lock);
+	d_pollers.push_back(p);
+}
+
+void
+channel::detach(poller* p) {
+	std::lock_guard<std::mutex> lock(d_lock);
+	d_pollers.erase(std::remove(d_pollers.begin(), d_pollers.end(), p), d_pollers.end());
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_CHANNEL_HPP_INCLUDED
+#define NANOMSGPP_CHANNEL_HPP_INCLUDED
+
+#ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
+#	include "message.hpp"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace nanomsgpp {
+
+	class poller;
+
+	// A channel hands messages between threads of one process through a bounded lock-free
+	// ring, moving the message objects rather than copying their parts. It has the sendmsg()
+	// and recvmsg() of a socket and can be added to a poller, so code can use a channel in
+	// place of an inproc socket pair.
+	//
+	// A single producer, single consumer channel may only be sent on by one thread at a time
+	// and received on by one thread at a time, and is faster than a multi producer, multi
+	// consumer channel, which any threads may use. Unlike a socket, a full or empty channel is
+	// reported by returning -1 or a null message rather than by throwing, and a message which
+	// is not sent is left with the caller. An endpoint wraps a channel or a socket behind the
+	// error handling of a socket.
+	//
+	// A channel may be polled by any number of pollers, but must outlive their polling: it is
+	// removed from its pollers when destroyed, without waiting for a poll in progress.
+	class channel {
+	public:
+		enum class mode {
+			// One sending thread and one receiving thread.
+			spsc,
+
+			// Any number of sending and receiving threads.
+			mpmc,
+		};
+
+	private:
+		typedef std::aligned_storage<sizeof(message), alignof(message)>::type storage;
+
+		struct cell {
+			std::atomic<uint64_t> d_sequence;  // only used by mpmc channels
+			storage               d_message;
+		};
+
+		std::unique_ptr<cell[]> d_cells;
+		size_t                  d_mask;
+		mode                    d_mode;
+		int                     d_timeout;
+
+		// the cursors are kept on their own cache lines, each with the copy of the other
+		// cursor its side of a spsc channel last saw
+		alignas(64) std::atomic<uint64_t> d_tail;
+		uint64_t                          d_head_seen;
+		alignas(64) std::atomic<uint64_t> d_head;
+		uint64_t                          d_tail_seen;
+
+		alignas(64) std::atomic<int>      d_waiters;
+		std::mutex                        d_lock;
+		std::condition_variable           d_cond;
+		std::vector<poller*>              d_pollers;
+
+		friend class poller;
+
+	public:
+		// Construct a channel holding up to capacity messages, rounded up to a power of two.
+		explicit channel(size_t capacity, mode m = mode::mpmc);
+
+		// Destructor, destroys the messages which were not received. A channel must not be
+		// destroyed while a poller it was added to is polling.
+		~channel();
+
+		// Allocate a channel on its cache line alignment, which plain new does not honour
+		// before C++17.
+		static void* operator new(size_t size);
+		static void operator delete(void* p);
+
+		// MANIPULATORS
+
+		// Get the number of messages the channel holds.
+		size_t capacity() const { return d_mask + 1; }
+
+		// Get the mode of the channel.
+		mode get_mode() const { return d_mode; }
+
+		// Set how long, in milliseconds, a blocking call waits for room or for a message. A
+		// negative timeout waits forever, which is the default.
+		void set_timeout(int ms) { d_timeout = ms; }
+
+		// Send a message, setting dont_wait to false will cause the call to block while the
+		// channel is full. Returns the number of body bytes sent, or -1 if the channel was
+		// full, in which case the message is left untouched.
+		int sendmsg(message&& msg, bool dont_wait = true);
+
+		// Receive a message, setting dont_wait to false will cause the call to block while the
+		// channel is empty. Returns a null message if the channel was empty.
+		std::unique_ptr<message> recvmsg(bool dont_wait = true);
+
+		// Receive a message into msg, which avoids allocating the message. Returns false if
+		// the channel was empty.
+		bool recvmsg(message& msg, bool dont_wait = true);
+
+		// Check whether a message can be received without blocking.
+		bool readable() const;
+
+		// Check whether a message can be sent without blocking.
+		bool writable() const;
+
+	private:
+		// Move a message into the ring, returning false if it is full.
+		bool push(message& msg);
+
+		// Move a message out of the ring, returning false if it is empty.
+		bool pop(message& msg);
+
+		// Wake the threads and pollers waiting on the channel, if there are any.
+		void notify();
+
+		// Wait until ready() holds or the timeout expires.
+		template<typename Ready>
+		bool wait(Ready ready);
+
+		// Register a poller to be woken when the channel changes.
+		void attach(poller* p);
+
+		// Unregister a poller.
+		void detach(poller* p);
+
+		// NOT IMPLEMENTED
+		channel(const channel& other) = delete;
+		channel& operator=(const channel& other) = delete;
+	};
+
+}
+
+#endif
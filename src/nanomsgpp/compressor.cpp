@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/compressor.hpp"
+#include "nanomsgpp/lz_codec.hpp"
+#include <nanomsg/nn.h>
+#include <chrono>
+#include <cstring>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	typedef std::chrono::steady_clock clock;
+
+	// A message compressed by a device hook starts with a method byte. Compressed messages
+	// follow it with their raw size as a little endian integer.
+	const unsigned char method_none = 0;
+	const unsigned char method_lz   = 1;
+	const size_t        lz_prefix   = 5;
+
+	// The codec match table is kept per thread, so hooks can run on several workers at once.
+	lz_codec& local_codec() {
+		static thread_local lz_codec codec;
+		return codec;
+	}
+
+	uint64_t elapsed_ns(clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+	}
+
+}
+
+compressor::compressor(size_t threshold)
+	: d_threshold(threshold)
+	, d_messages(0)
+	, d_compressed(0)
+	, d_bytes_in(0)
+	, d_bytes_out(0)
+	, d_compress_bytes(0)
+	, d_compress_ns(0)
+	, d_decompressed(0)
+	, d_decompress_bytes(0)
+	, d_decompress_ns(0)
+	, d_errors(0)
+{}
+
+void*
+compressor::compress(const void* src, size_t n, size_t prefix, size_t& size) {
+	if (n < d_threshold) {
+		return nullptr;
+	}
+	void* chunk = nn_allocmsg(prefix + lz_codec::max_compressed_size(n), 0);
+	if (nullptr == chunk) {
+		return nullptr;
+	}
+	clock::time_point start = clock::now();
+	size_t compressed = local_codec().compress(src, n, static_cast<unsigned char*>(chunk) + prefix);
+	d_compress_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+	d_compress_bytes.fetch_add(n, std::memory_order_relaxed);
+	if (compressed >= n) {
+		nn_freemsg(chunk);
+		return nullptr;
+	}
+	// shrink the chunk to the compressed size, which nanomsg does in place
+	void* shrunk = nn_reallocmsg(chunk, prefix + compressed);
+	if (nullptr == shrunk) {
+		nn_freemsg(chunk);
+		return nullptr;
+	}
+	chunk = shrunk;
+	size = prefix + compressed;
+	d_messages.fetch_add(1, std::memory_order_relaxed);
+	d_compressed.fetch_add(1, std::memory_order_relaxed);
+	d_bytes_in.fetch_add(n, std::memory_order_relaxed);
+	d_bytes_out.fetch_add(compressed, std::memory_order_relaxed);
+	return chunk;
+}
+
+void*
+compressor::decompress(const void* src, size_t n, size_t raw_size, size_t prefix) {
+	// a block cannot expand by more than a factor of 255, so a larger size is a corrupt one
+	// and is refused before allocating for it
+	if (raw_size / 255 > n) {
+		d_errors.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	void* chunk = nn_allocmsg(prefix + raw_size, 0);
+	if (nullptr == chunk) {
+		return nullptr;
+	}
+	clock::time_point start = clock::now();
+	size_t size;
+	bool ok = lz_codec::decompress(src, n, static_cast<unsigned char*>(chunk) + prefix,
+		raw_size, size);
+	d_decompress_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+	if (!ok || size != raw_size) {
+		d_errors.fetch_add(1, std::memory_order_relaxed);
+		nn_freemsg(chunk);
+		return nullptr;
+	}
+	d_decompressed.fetch_add(1, std::memory_order_relaxed);
+	d_decompress_bytes.fetch_add(raw_size, std::memory_order_relaxed);
+	return chunk;
+}
+
+void
+compressor::skipped(size_t n) {
+	d_messages.fetch_add(1, std::memory_order_relaxed);
+	d_bytes_in.fetch_add(n, std::memory_order_relaxed);
+	d_bytes_out.fetch_add(n, std::memory_order_relaxed);
+}
+
+device::hook
+compressor::compress_hook(device::direction d) {
+	return [this, d](device::direction dir, message_view& msg) {
+		if (dir != d) {
+			return (true);
+		}
+		size_t size;
+		unsigned char* chunk = static_cast<unsigned char*>
+			(compress(msg.data(), msg.size(), lz_prefix, size));
+		if (chunk != nullptr) {
+			uint32_t raw_size = static_cast<uint32_t>(msg.size());
+			chunk[0] = method_lz;
+			for (int i = 0; i < 4; ++i) {
+				chunk[1 + i] = static_cast<unsigned char>(raw_size >> (8 * i));
+			}
+			msg.replace(chunk, size);
+			return (true);
+		}
+		// the method byte of a message sent as it is goes in front of the body in its own
+		// chunk, rather than in a copy of the message
+		size = msg.size();
+		if (!msg.resize(size + 1)) {
+			return (false);
+		}
+		std::memmove(msg.data() + 1, msg.data(), size);
+		msg.data()[0] = method_none;
+		skipped(size);
+		return (true);
+	};
+}
+
+device::hook
+compressor::decompress_hook(device::direction d) {
+	return [this, d](device::direction dir, message_view& msg) {
+		if (dir != d) {
+			return (true);
+		}
+		unsigned char* p = msg.data();
+		void* chunk = nullptr;
+		size_t size = 0;
+		if (msg.size() >= 1 && method_none == p[0]) {
+			// strip the method byte in place, which shrinking does not move
+			size = msg.size() - 1;
+			std::memmove(p, p + 1, size);
+			return (msg.resize(size));
+		} else if (msg.size() >= lz_prefix && method_lz == p[0]) {
+			size = uint32_t(p[1]) | (uint32_t(p[2]) << 8) | (uint32_t(p[3]) << 16)
+				| (uint32_t(p[4]) << 24);
+			chunk = decompress(p + lz_prefix, msg.size() - lz_prefix, size, 0);
+		} else {
+			d_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (nullptr == chunk) {
+			return (false);
+		}
+		msg.replace(chunk, size);
+		return (true);
+	};
+}
+
+compressor::statistics
+compressor::get_statistics() const {
+	statistics s;
+	s.messages         = d_messages.load(std::memory_order_relaxed);
+	s.compressed       = d_compressed.load(std::memory_order_relaxed);
+	s.bytes_in         = d_bytes_in.load(std::memory_order_relaxed);
+	s.bytes_out        = d_bytes_out.load(std::memory_order_relaxed);
+	s.compress_bytes   = d_compress_bytes.load(std::memory_order_relaxed);
+	s.compress_ns      = d_compress_ns.load(std::memory_order_relaxed);
+	s.decompressed     = d_decompressed.load(std::memory_order_relaxed);
+	s.decompress_bytes = d_decompress_bytes.load(std::memory_order_relaxed);
+	s.decompress_ns    = d_decompress_ns.load(std::memory_order_relaxed);
+	s.errors           = d_errors.load(std::memory_order_relaxed);
+	return s;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_COMPRESSOR_HPP_INCLUDED
+#define NANOMSGPP_COMPRESSOR_HPP_INCLUDED
+
+#ifndef NANOMSGPP_DEVICE_HPP_INCLUDED
+#	include "device.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+namespace nanomsgpp {
+
+	// A compressor compresses messages on one side of a hop and decompresses them on the other,
+	// using the built in lz_codec. Messages smaller than the threshold are sent as they are. The
+	// compressor records the compression ratio and the time spent in the codec. It may be used
+	// from several threads at once, and must outlive the devices and bridges using it.
+	class compressor {
+	public:
+		// A snapshot of the compressor counters.
+		struct statistics {
+			uint64_t messages;          // number of messages or frames offered for compression
+			uint64_t compressed;        // number of messages or frames compressed
+			uint64_t bytes_in;          // number of bytes offered for compression
+			uint64_t bytes_out;         // number of bytes after compression
+			uint64_t compress_bytes;    // number of bytes passed through the compressor
+			uint64_t compress_ns;       // time spent compressing
+			uint64_t decompressed;      // number of messages or frames decompressed
+			uint64_t decompress_bytes;  // number of bytes produced by decompression
+			uint64_t decompress_ns;     // time spent decompressing
+			uint64_t errors;            // number of malformed messages or frames
+
+			// Get the ratio of the bytes offered to the bytes sent.
+			double ratio() const {
+				return (0 == bytes_out) ? 1.0 : double(bytes_in) / double(bytes_out);
+			}
+
+			// Get the time spent compressing each MB passed through the compressor.
+			double compress_ns_per_mb() const {
+				return (0 == compress_bytes) ? 0.0 : compress_ns * 1048576.0 / compress_bytes;
+			}
+
+			// Get the time spent decompressing each MB produced by decompression.
+			double decompress_ns_per_mb() const {
+				return (0 == decompress_bytes) ? 0.0 : decompress_ns * 1048576.0 / decompress_bytes;
+			}
+		};
+
+	private:
+		size_t                d_threshold;
+		std::atomic<uint64_t> d_messages;
+		std::atomic<uint64_t> d_compressed;
+		std::atomic<uint64_t> d_bytes_in;
+		std::atomic<uint64_t> d_bytes_out;
+		std::atomic<uint64_t> d_compress_bytes;
+		std::atomic<uint64_t> d_compress_ns;
+		std::atomic<uint64_t> d_decompressed;
+		std::atomic<uint64_t> d_decompress_bytes;
+		std::atomic<uint64_t> d_decompress_ns;
+		std::atomic<uint64_t> d_errors;
+
+	public:
+		// Construct a compressor which skips messages smaller than threshold bytes.
+		explicit compressor(size_t threshold = 256);
+
+		// MANIPULATORS
+
+		// Get the size below which messages are not compressed.
+		size_t threshold() const { return d_threshold; }
+
+		// Compress n bytes into a new message chunk, leaving prefix bytes free at its start.
+		// Returns nullptr if the data is below the threshold or does not get smaller, otherwise
+		// stores the size of the chunk.
+		void* compress(const void* src, size_t n, size_t prefix, size_t& size);
+
+		// Decompress n bytes into a new message chunk of prefix + raw_size bytes, leaving prefix
+		// bytes free at its start. Returns nullptr if the data is malformed.
+		void* decompress(const void* src, size_t n, size_t raw_size, size_t prefix);
+
+		// Record data which was offered for compression but sent as it is.
+		void skipped(size_t n);
+
+		// Get a device hook which compresses the messages forwarded in the given direction.
+		// Every message gains a one byte prefix saying whether it was compressed.
+		device::hook compress_hook(device::direction d);
+
+		// Get a device hook which decompresses the messages forwarded in the given direction,
+		// dropping malformed messages.
+		device::hook decompress_hook(device::direction d);
+
+		// Get a snapshot of the compressor counters.
+		statistics get_statistics() const;
+
+	private:
+		// NOT IMPLEMENTED
+		compressor(const compressor& other) = delete;
+		compressor& operator=(const compressor& other) = delete;
+	};
+
+}
+
+#endif
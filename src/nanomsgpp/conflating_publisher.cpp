@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/conflating_publisher.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	typedef std::chrono::steady_clock clock;
+
+	// A snapshot reply holds the number of messages followed by each message and its size.
+	// Integers are little endian.
+	void put_u32(std::vector<unsigned char>& v, uint32_t n) {
+		for (int i = 0; i < 4; ++i) {
+			v.push_back(static_cast<unsigned char>(n >> (8 * i)));
+		}
+	}
+
+	uint32_t get_u32(const unsigned char* p) {
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16)
+			| (uint32_t(p[3]) << 24);
+	}
+
+	// FNV-1a, with zero reserved for empty entries.
+	uint64_t hash_of(const void* topic, size_t size) {
+		const unsigned char* p = static_cast<const unsigned char*>(topic);
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) {
+			h = (h ^ p[i]) * 1099511628211ull;
+		}
+		return (0 == h) ? 1 : h;
+	}
+
+}
+
+conflating_publisher::conflating_publisher(socket& pub)
+	: d_socket(pub)
+	, d_snapshot_socket(nullptr)
+	, d_window(10)
+	, d_entries(64)
+	, d_size(0)
+	, d_running(false)
+	, d_published(0)
+	, d_conflated(0)
+	, d_sent(0)
+	, d_dropped(0)
+	, d_snapshots(0)
+{
+	int protocol;
+	size_t len = sizeof(protocol);
+	pub.get_option_raw(NN_SOL_SOCKET, NN_PROTOCOL, &protocol, &len);
+	if (protocol != static_cast<int>(socket_type::publish)) {
+		throw exception("conflating publisher needs a publish socket");
+	}
+	std::memset(d_entries.data(), 0, d_entries.size() * sizeof(entry));
+}
+
+conflating_publisher::~conflating_publisher() {
+	stop();
+	for (auto& e : d_entries) {
+		std::free(e.d_body);
+	}
+}
+
+void
+conflating_publisher::publish(const void* body, size_t size, size_t topic_size) {
+	if (topic_size > size) {
+		throw exception("topic is longer than the message");
+	}
+	uint64_t hash = hash_of(body, topic_size);
+
+	std::lock_guard<std::mutex> lock(d_mutex);
+	if ((d_size + 1) * 4 > d_entries.size() * 3) {
+		grow();
+	}
+	size_t i = find(body, topic_size, hash);
+	entry& e = d_entries[i];
+	if (size > e.d_capacity || nullptr == e.d_body) {
+		void* p = std::realloc(e.d_body, std::max<size_t>(size, 1));
+		if (nullptr == p) {
+			throw std::bad_alloc();
+		}
+		e.d_body = p;
+		e.d_capacity = static_cast<uint32_t>(size);
+	}
+	if (0 == e.d_hash) {
+		e.d_hash = hash;
+		e.d_topic_size = static_cast<uint32_t>(topic_size);
+		d_size++;
+	}
+	std::memcpy(e.d_body, body, size);
+	e.d_size = static_cast<uint32_t>(size);
+	if (e.d_dirty) {
+		d_conflated.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		e.d_dirty = 1;
+		d_dirty.push_back(static_cast<uint32_t>(i));
+	}
+	d_published.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+conflating_publisher::flush() {
+	int fd = d_socket.get_fd();
+	// flushes are serialised, so an older message of a topic cannot be sent after a newer one
+	std::lock_guard<std::mutex> flushing(d_flush_mutex);
+
+	// copy the pending messages out under the lock, so publishers are not held up while the
+	// messages are sent. nn_send would copy them into chunks anyway
+	std::vector<std::pair<void*, size_t>> pending;
+	uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		pending.reserve(d_dirty.size());
+		for (uint32_t i : d_dirty) {
+			entry& e = d_entries[i];
+			e.d_dirty = 0;
+			void* chunk = nn_allocmsg(e.d_size, 0);
+			if (nullptr == chunk) {
+				dropped++;
+				continue;
+			}
+			std::memcpy(chunk, e.d_body, e.d_size);
+			pending.push_back(std::make_pair(chunk, static_cast<size_t>(e.d_size)));
+		}
+		d_dirty.clear();
+	}
+
+	// topics are sent in the order they were first updated during the window. PUB sockets
+	// never block, they drop messages for subscribers which are not keeping up
+	uint64_t sent = 0;
+	for (auto& m : pending) {
+		if (nn_send(fd, &m.first, NN_MSG, NN_DONTWAIT) >= 0) {
+			sent++;
+		} else {
+			nn_freemsg(m.first);
+			dropped++;
+		}
+	}
+	d_sent.fetch_add(sent, std::memory_order_relaxed);
+	d_dropped.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void
+conflating_publisher::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	if (d_thread.joinable()) {
+		d_thread.join();
+	}
+	d_thread = std::thread(&conflating_publisher::run, this);
+}
+
+void
+conflating_publisher::stop() {
+	d_running.store(false);
+	if (d_thread.joinable()) {
+		d_thread.join();
+	}
+}
+
+conflating_publisher::statistics
+conflating_publisher::get_statistics() {
+	statistics s;
+	s.published = d_published.load(std::memory_order_relaxed);
+	s.conflated = d_conflated.load(std::memory_order_relaxed);
+	s.sent      = d_sent.load(std::memory_order_relaxed);
+	s.dropped   = d_dropped.load(std::memory_order_relaxed);
+	s.snapshots = d_snapshots.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(d_mutex);
+	s.topics    = d_size;
+	return s;
+}
+
+size_t
+conflating_publisher::request_snapshot(socket& req, const std::string& prefix,
+		snapshot_handler handler) {
+	req.send_raw(prefix.data(), prefix.size(), 0);
+	void* reply = nullptr;
+	int nb = nn_recv(req.get_fd(), &reply, NN_MSG, 0);
+	if (-1 == nb) {
+		throw internal_exception();
+	}
+
+	const unsigned char* p = static_cast<const unsigned char*>(reply);
+	const unsigned char* end = p + nb;
+	try {
+		if (nb < 4) {
+			throw exception("malformed snapshot");
+		}
+		uint32_t count = get_u32(p);
+		p += 4;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (end - p < 4 || static_cast<size_t>(end - p - 4) < get_u32(p)) {
+				throw exception("malformed snapshot");
+			}
+			size_t size = get_u32(p);
+			handler(p + 4, size);
+			p += 4 + size;
+		}
+		nn_freemsg(reply);
+		return count;
+	} catch (...) {
+		nn_freemsg(reply);
+		throw;
+	}
+}
+
+void
+conflating_publisher::run() {
+	clock::time_point deadline = clock::now() + std::chrono::milliseconds(d_window);
+	while (d_running.load(std::memory_order_relaxed)) {
+		int timeout = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>
+			(deadline - clock::now()).count());
+		if (d_snapshot_socket != nullptr) {
+			struct nn_pollfd pfd = { d_snapshot_socket->get_fd(), NN_POLLIN, 0 };
+			if (nn_poll(&pfd, 1, timeout) > 0 && (pfd.revents & NN_POLLIN)) {
+				serve_snapshot();
+			}
+		} else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+		}
+
+		clock::time_point now = clock::now();
+		if (now >= deadline) {
+			flush();
+			deadline += std::chrono::milliseconds(d_window);
+			if (deadline < now) {
+				deadline = now + std::chrono::milliseconds(d_window);
+			}
+		}
+	}
+	flush();
+}
+
+void
+conflating_publisher::serve_snapshot() {
+	int fd = d_snapshot_socket->get_fd();
+	void* request = nullptr;
+	int nb = nn_recv(fd, &request, NN_MSG, NN_DONTWAIT);
+	if (-1 == nb) {
+		return;
+	}
+	std::string prefix(static_cast<const char*>(request), nb);
+	nn_freemsg(request);
+
+	std::vector<unsigned char> reply;
+	put_u32(reply, 0);
+	uint32_t count = 0;
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		for (auto& e : d_entries) {
+			if (0 == e.d_hash || e.d_size < prefix.size()
+					|| std::memcmp(e.d_body, prefix.data(), prefix.size()) != 0) {
+				continue;
+			}
+			put_u32(reply, e.d_size);
+			const unsigned char* body = static_cast<const unsigned char*>(e.d_body);
+			reply.insert(reply.end(), body, body + e.d_size);
+			count++;
+		}
+	}
+	for (int i = 0; i < 4; ++i) {
+		reply[i] = static_cast<unsigned char>(count >> (8 * i));
+	}
+	if (nn_send(fd, reply.data(), reply.size(), NN_DONTWAIT) >= 0) {
+		d_snapshots.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+size_t
+conflating_publisher::find(const void* topic, size_t topic_size, uint64_t hash) const {
+	size_t mask = d_entries.size() - 1;
+	size_t i = hash & mask;
+	while (d_entries[i].d_hash != 0) {
+		const entry& e = d_entries[i];
+		if (e.d_hash == hash && e.d_topic_size == topic_size
+				&& 0 == std::memcmp(e.d_body, topic, topic_size)) {
+			return i;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+void
+conflating_publisher::grow() {
+	std::vector<entry> entries(d_entries.size() * 2);
+	std::memset(entries.data(), 0, entries.size() * sizeof(entry));
+	entries.swap(d_entries);
+
+	for (auto& e : entries) {
+		if (e.d_hash != 0) {
+			d_entries[find(e.d_body, e.d_topic_size, e.d_hash)] = e;
+		}
+	}
+	// the pending topics keep their order, at their new places
+	for (auto& i : d_dirty) {
+		const entry& e = entries[i];
+		i = static_cast<uint32_t>(find(e.d_body, e.d_topic_size, e.d_hash));
+	}
+}
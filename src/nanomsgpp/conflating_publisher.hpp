@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_CONFLATING_PUBLISHER_HPP_INCLUDED
+#define NANOMSGPP_CONFLATING_PUBLISHER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A conflating publisher keeps the latest message for every topic and publishes, once per
+	// send window, only the newest message of each topic updated during the window, so slow
+	// subscribers see fewer but current values. The topic of a message is its first bytes, which
+	// are also what SUB sockets filter on. The latest messages are held in an open addressing
+	// table, and a late joiner can request a snapshot of them over a REQ/REP side channel.
+	//
+	// Publishing is thread safe. Messages are sent by the publisher thread once it has been
+	// started, or by calling flush().
+	class conflating_publisher {
+	public:
+		// A snapshot of the publisher counters.
+		struct statistics {
+			uint64_t published;  // number of messages published
+			uint64_t conflated;  // number of messages replaced before they were sent
+			uint64_t sent;       // number of messages sent
+			uint64_t dropped;    // number of messages the socket did not accept
+			uint64_t snapshots;  // number of snapshots served
+			uint64_t topics;     // number of topics in the cache
+		};
+
+		// Called with each message of a snapshot.
+		typedef std::function<void(const void* body, size_t size)> snapshot_handler;
+
+	private:
+		// A cache entry, holding the latest message of a topic. Entries are kept small so a
+		// probe sequence touches few cache lines.
+		struct entry {
+			uint64_t d_hash;      // 0 if the entry is empty
+			void*    d_body;      // malloc'd copy of the latest message
+			uint32_t d_size;
+			uint32_t d_capacity;
+			uint32_t d_topic_size;
+			uint32_t d_dirty;     // non zero if the message has not been sent
+		};
+
+		socket&               d_socket;
+		socket*               d_snapshot_socket;
+		int                   d_window;
+		std::mutex            d_mutex;
+		std::mutex            d_flush_mutex;
+		std::vector<entry>    d_entries;
+		std::vector<uint32_t> d_dirty;
+		size_t                d_size;
+		std::thread           d_thread;
+		std::atomic<bool>     d_running;
+
+		std::atomic<uint64_t> d_published;
+		std::atomic<uint64_t> d_conflated;
+		std::atomic<uint64_t> d_sent;
+		std::atomic<uint64_t> d_dropped;
+		std::atomic<uint64_t> d_snapshots;
+
+	public:
+		// Construct a publisher sending on the given publish socket.
+		explicit conflating_publisher(socket& pub);
+
+		// Destructor, stops the publisher and frees the cache.
+		~conflating_publisher();
+
+		// MANIPULATORS
+
+		// Set the send window in milliseconds.
+		void set_window(int ms) { d_window = ms; }
+
+		// Serve snapshot requests received on the given REP socket from the publisher thread.
+		// A request holds a topic prefix, and the reply holds the latest message of every
+		// topic starting with it.
+		void serve_snapshots(socket& rep) { d_snapshot_socket = &rep; }
+
+		// Publish a message whose topic is its first topic_size bytes.
+		void publish(const void* body, size_t size, size_t topic_size);
+
+		// Send the newest message of every topic updated since the last flush.
+		void flush();
+
+		// Start the publisher thread, which flushes once per window and serves snapshots.
+		void start();
+
+		// Stop the publisher thread, flushing the pending messages.
+		void stop();
+
+		// Check whether the publisher thread is running.
+		bool running() const { return d_running.load(); }
+
+		// Get a snapshot of the publisher counters.
+		statistics get_statistics();
+
+		// Request a snapshot of the topics starting with prefix on the given REQ socket,
+		// calling handler with each message. Subscribe before requesting the snapshot, so no
+		// update falls between the two. Returns the number of messages in the snapshot, and
+		// throws if the request fails or the reply is malformed.
+		static size_t request_snapshot(socket& req, const std::string& prefix,
+			snapshot_handler handler);
+
+	private:
+		// The loop run by the publisher thread.
+		void run();
+
+		// Reply to a snapshot request waiting on the snapshot socket.
+		void serve_snapshot();
+
+		// Find the entry of a topic, or the empty entry where it belongs.
+		size_t find(const void* topic, size_t topic_size, uint64_t hash) const;
+
+		// Double the size of the table.
+		void grow();
+
+		// NOT IMPLEMENTED
+		conflating_publisher(const conflating_publisher& other) = delete;
+		conflating_publisher& operator=(const conflating_publisher& other) = delete;
+	};
+
+}
+
+#endif
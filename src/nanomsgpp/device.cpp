@@ -22,13 +22,287 @@
 
 #include "nanomsgpp/device.hpp"
 #include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/trace.hpp"
 #include <nanomsg/nn.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <vector>
 
 using namespace nanomsgpp;
 
-device::device(socket& a, socket& b) {
-	int result = nn_device(a.get_fd(), b.get_fd());
-	if (-1 == result) {
-		throw internal_exception();
+namespace {
+
+	// The number of messages a worker forwards for each poll of its source socket.
+	const int burst_size = 64;
+
+	// Errors which mean a socket can no longer be used.
+	bool is_fatal(int error) {
+		return error == ETERM || error == EBADF;
+	}
+
+}
+
+void*
+device::worker_counters::operator new(size_t size) {
+	void* p = nullptr;
+	if (0 != posix_memalign(&p, alignof(worker_counters), size)) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void
+device::worker_counters::operator delete(void* p) {
+	std::free(p);
+}
+
+device::device(socket& a, socket& b, size_t n_workers)
+	: d_a(a)
+	, d_b(b)
+	, d_n_workers((0 == n_workers) ? 1 : n_workers)
+	, d_poll_interval(100)
+	, d_drain_timeout(1000)
+	, d_running(false)
+	, d_active(0)
+{}
+
+device::~device() {
+	stop();
+}
+
+void
+device::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	for (auto& t : d_threads) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+	d_threads.clear();
+	d_counters.clear();
+
+	bool loopback = d_b.get_fd() < 0;
+	if (d_a.get_fd() < 0) {
+		d_running.store(false);
+		throw exception("device requires a valid socket");
+	}
+	size_t n_directions = loopback ? 1 : 2;
+	d_active.store(d_n_workers * n_directions);
+	for (size_t d = 0; d < n_directions; ++d) {
+		for (size_t i = 0; i < d_n_workers; ++i) {
+			worker_counters* c = new worker_counters();
+			c->d_messages.store(0);
+			c->d_bytes.store(0);
+			c->d_dropped.store(0);
+			c->d_filtered.store(0);
+			c->d_direction = static_cast<direction>(d);
+			d_counters.emplace_back(c);
+		}
+	}
+	for (auto& c : d_counters) {
+		int from = (c->d_direction == direction::a_to_b) ? d_a.get_fd() : d_b.get_fd();
+		int to   = (c->d_direction == direction::a_to_b) ? d_b.get_fd() : d_a.get_fd();
+		if (loopback) {
+			to = from;
+		}
+		d_threads.emplace_back(&device::forward, this, from, to, std::ref(*c));
+	}
+}
+
+void
+device::stop() {
+	d_running.store(false);
+	for (auto& t : d_threads) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+}
+
+void
+device::wait() {
+	std::unique_lock<std::mutex> lock(d_lock);
+	d_cond.wait(lock, [this]() { return 0 == d_active.load(); });
+}
+
+device::counters
+device::get_counters(direction d) const {
+	counters result = { 0, 0, 0, 0 };
+	for (auto& c : d_counters) {
+		if (c->d_direction == d) {
+			result.messages += c->d_messages.load(std::memory_order_relaxed);
+			result.bytes    += c->d_bytes.load(std::memory_order_relaxed);
+			result.dropped  += c->d_dropped.load(std::memory_order_relaxed);
+			result.filtered += c->d_filtered.load(std::memory_order_relaxed);
+		}
+	}
+	return result;
+}
+
+void
+device::forward(int from, int to, worker_counters& c) {
+	std::vector<size_t> control_data;
+	while (d_running.load(std::memory_order_relaxed)) {
+		struct nn_pollfd pfd = { from, NN_POLLIN, 0 };
+		int rc = nn_poll(&pfd, 1, d_poll_interval);
+		if (-1 == rc) {
+			if (is_fatal(nn_errno())) {
+				break;
+			}
+			continue;
+		}
+		if (0 == rc) {
+			continue;
+		}
+		// drain a burst of messages for each poll, which saves a poll per message when the
+		// device is busy
+		for (int i = 0; i < burst_size; ++i) {
+			void* body = nullptr;
+			void* control = nullptr;
+			struct nn_iovec iov = { &body, NN_MSG };
+			struct nn_msghdr hdr;
+			std::memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_iov = &iov;
+			hdr.msg_iovlen = 1;
+			hdr.msg_control = &control;
+			hdr.msg_controllen = NN_MSG;
+
+			int nb = nn_recvmsg(from, &hdr, NN_DONTWAIT);
+			if (-1 == nb) {
+				break;
+			}
+			int64_t received = NANOMSGPP_TRACE_ENABLED(device_fwd) ? trace_now() : 0;
+			own_control(&hdr, nb, control_data);
+			if (!d_hooks.empty() && !run_hooks(c.d_direction, &hdr, nb)) {
+				discard(&hdr);
+				c.d_filtered.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			int error = 0;
+			if (send(to, &hdr)) {
+				c.d_messages.fetch_add(1, std::memory_order_relaxed);
+				c.d_bytes.fetch_add(nb, std::memory_order_relaxed);
+			} else {
+				error = nn_errno();
+				c.d_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (received != 0) {
+				NANOMSGPP_TRACE(device_fwd, from, nb, error, trace_now() - received);
+			}
+		}
+	}
+	std::lock_guard<std::mutex> lock(d_lock);
+	if (0 == d_active.fetch_sub(1) - 1) {
+		d_running.store(false);
+		d_cond.notify_all();
+	}
+}
+
+bool
+device::run_hooks(direction d, struct nn_msghdr* hdr, int& nb) {
+	message_view view(hdr, nb);
+	try {
+		for (auto& h : d_hooks) {
+			if (!h(d, view)) {
+				return (false);
+			}
+		}
+	} catch (...) {
+		return (false);
+	}
+	nb = static_cast<int>(view.size());
+	return (true);
+}
+
+device::hook
+device::tee(socket& s) {
+	int fd = s.get_fd();
+	return [fd](direction, message_view& msg) {
+		nn_send(fd, msg.data(), msg.size(), NN_DONTWAIT);
+		return (true);
+	};
+}
+
+device::hook
+device::tee(socket& s, direction only) {
+	int fd = s.get_fd();
+	return [fd, only](direction d, message_view& msg) {
+		if (d == only) {
+			nn_send(fd, msg.data(), msg.size(), NN_DONTWAIT);
+		}
+		return (true);
+	};
+}
+
+bool
+device::send(int to, struct nn_msghdr* hdr) {
+	std::chrono::steady_clock::time_point deadline;
+	bool draining = false;
+	while (true) {
+		if (nn_sendmsg(to, hdr, NN_DONTWAIT) >= 0) {
+			return (true);
+		}
+		int error = nn_errno();
+		if (error == EAGAIN) {
+			if (!d_running.load(std::memory_order_relaxed)) {
+				if (!draining) {
+					draining = true;
+					deadline = std::chrono::steady_clock::now()
+						+ std::chrono::milliseconds(d_drain_timeout);
+				} else if (std::chrono::steady_clock::now() >= deadline) {
+					break;
+				}
+			}
+			struct nn_pollfd pfd = { to, NN_POLLOUT, 0 };
+			if (nn_poll(&pfd, 1, d_poll_interval) >= 0 || !is_fatal(nn_errno())) {
+				continue;
+			}
+		}
+		break;
 	}
+	// the message was not sent, so it is still owned by the device
+	discard(hdr);
+	return (false);
+}
+
+void
+device::own_control(struct nn_msghdr* hdr, int nb, std::vector<size_t>& control_data) {
+	void* chunk = *static_cast<void**>(hdr->msg_control);
+	if (chunk == nullptr) {
+		hdr->msg_control = nullptr;
+		hdr->msg_controllen = 0;
+		return;
+	}
+	message_view view(hdr, nb);
+	size_t header_size = view.header_size();
+	if (header_size > 0) {
+		size_t len = sizeof(size_t) + header_size;
+		size_t words = (NN_CMSG_SPACE(len) + sizeof(size_t) - 1) / sizeof(size_t);
+		if (control_data.size() < words) {
+			control_data.resize(words);
+		}
+		std::memset(control_data.data(), 0, words * sizeof(size_t));
+		struct nn_cmsghdr* cmsg = reinterpret_cast<nn_cmsghdr*>(control_data.data());
+		cmsg->cmsg_len   = NN_CMSG_LEN(len);
+		cmsg->cmsg_level = PROTO_SP;
+		cmsg->cmsg_type  = SP_HDR;
+		std::memcpy(NN_CMSG_DATA(cmsg), &header_size, sizeof(header_size));
+		std::memcpy(NN_CMSG_DATA(cmsg) + sizeof(header_size), view.header(), header_size);
+		hdr->msg_control = control_data.data();
+		hdr->msg_controllen = NN_CMSG_SPACE(len);
+	} else {
+		hdr->msg_control = nullptr;
+		hdr->msg_controllen = 0;
+	}
+	nn_freemsg(chunk);
+}
+
+void
+device::discard(struct nn_msghdr* hdr) {
+	nn_freemsg(*static_cast<void**>(hdr->msg_iov[0].iov_base));
 }
@@ -26,21 +26,139 @@
 #ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
 #	include "socket.hpp"
 #endif
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#	include "message_view.hpp"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace nanomsgpp {
 
 	// A device is used to forward messages between two sockets. If only one socket is valid, the
 	// device works in a loopback mode, where any messages received from the socket are sent back
-	// to itself
+	// to itself. Messages are forwarded without copying by worker threads, which are started by
+	// start() and stopped by stop(). With more than one worker per direction, messages from the
+	// same socket may be forwarded out of order. Hooks may be installed to filter, rewrite or
+	// mirror the messages as they pass through the device.
 	class device {
 	public:
-		// construct a device from socket a and socket b
-		device(socket& a, socket& b);
+		enum class direction {
+			// Messages received from socket a and sent to socket b.
+			a_to_b = 0,
+
+			// Messages received from socket b and sent to socket a.
+			b_to_a = 1,
+		};
+
+		// A snapshot of the counters for one direction.
+		struct counters {
+			uint64_t messages;  // number of messages forwarded
+			uint64_t bytes;     // number of body bytes forwarded
+			uint64_t dropped;   // number of messages which could not be sent
+			uint64_t filtered;  // number of messages dropped by a hook
+		};
 
-		// destructor
-		~device() {};
+		// A hook is run on each message before it is forwarded, and returns false to drop the
+		// message. Hooks are run on the worker threads, in the order they were added, and must
+		// not throw.
+		typedef std::function<bool(direction d, message_view& msg)> hook;
 
 	private:
+		// The counters of a single worker, aligned so no two workers share a cache line.
+		struct alignas(64) worker_counters {
+			std::atomic<uint64_t> d_messages;
+			std::atomic<uint64_t> d_bytes;
+			std::atomic<uint64_t> d_dropped;
+			std::atomic<uint64_t> d_filtered;
+			direction             d_direction;
+
+			// plain new does not honour alignas before C++17
+			static void* operator new(size_t size);
+			static void operator delete(void* p);
+		};
+
+		socket&                                       d_a;
+		socket&                                       d_b;
+		size_t                                        d_n_workers;
+		int                                           d_poll_interval;
+		int                                           d_drain_timeout;
+		std::vector<std::thread>                      d_threads;
+		std::vector<std::unique_ptr<worker_counters>> d_counters;
+		std::vector<hook>                             d_hooks;
+		std::atomic<bool>                             d_running;
+		std::atomic<size_t>                           d_active;
+		std::mutex                                    d_lock;
+		std::condition_variable                       d_cond;
+
+	public:
+		// construct a device forwarding between socket a and socket b, using n_workers threads
+		// for each direction
+		device(socket& a, socket& b, size_t n_workers = 1);
+
+		// destructor, stops the device
+		~device();
+
+		// MANIPULATORS
+
+		// set how often, in milliseconds, the workers check whether the device has been stopped
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// set how long, in milliseconds, stop() waits for messages held by the workers to be sent
+		void set_drain_timeout(int ms) { d_drain_timeout = ms; }
+
+		// add a hook to the end of the pipeline, which must be done before the device is started
+		void add_hook(hook h) { d_hooks.push_back(std::move(h)); }
+
+		// start the worker threads
+		void start();
+
+		// stop receiving messages, send the messages held by the workers and join the workers.
+		// Only the messages already received by a worker are drained; messages still queued in
+		// the receiving socket stay there, and are forwarded if the device is started again.
+		void stop();
+
+		// block until every worker has exited, either by stop() or a socket error
+		void wait();
+
+		// check whether the device is running
+		bool running() const { return d_running.load(); }
+
+		// get a snapshot of the counters for the given direction
+		counters get_counters(direction d) const;
+
+		// get a hook which sends a copy of each message body to the given socket, without
+		// waiting. The copy is dropped if the socket cannot accept it
+		static hook tee(socket& s);
+
+		// get a hook which sends a copy of each message body travelling in the given direction
+		// to the given socket, as tee(s) does for both directions
+		static hook tee(socket& s, direction only);
+
+	private:
+		// the loop run by each worker thread
+		void forward(int from, int to, worker_counters& c);
+
+		// run the hooks on a received message, returning false if it should be dropped
+		bool run_hooks(direction d, struct nn_msghdr* hdr, int& nb);
+
+		// send a received message, retrying until it is sent or the drain timeout expires
+		bool send(int to, struct nn_msghdr* hdr);
+
+		// replace the control chunk of a received message with a copy of its protocol header
+		// in control_data, and free the chunk. nanomsg frees the control chunk of a message it
+		// fails to send, so the chunk itself could not be passed to a retry
+		static void own_control(struct nn_msghdr* hdr, int nb, std::vector<size_t>& control_data);
+
+		// free the body of a received message which was not sent
+		static void discard(struct nn_msghdr* hdr);
+
 		// NOT IMPLEMENTED
 		device() = delete;
 		device(device&& other) = delete;
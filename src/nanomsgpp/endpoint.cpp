@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/endpoint.hpp"
+#include "nanomsgpp/channel.hpp"
+#include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/socket.hpp"
+#include <cerrno>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	class socket_endpoint : public endpoint {
+		socket& d_socket;
+
+	public:
+		explicit socket_endpoint(socket& s)
+			: d_socket(s) {}
+
+		int sendmsg(message&& msg, bool dont_wait) override {
+			return d_socket.sendmsg(std::move(msg), dont_wait);
+		}
+
+		std::unique_ptr<message> recvmsg(bool dont_wait) override {
+			return d_socket.recvmsg(1, dont_wait);
+		}
+
+		void recvmsg(message& msg, bool dont_wait) override {
+			d_socket.recvmsg(msg, dont_wait);
+		}
+	};
+
+	class channel_endpoint : public endpoint {
+		channel& d_channel;
+
+		// a channel reports a full or empty ring by its result, which becomes the error
+		// a socket would have thrown
+		void fail(bool dont_wait) {
+			errno = dont_wait ? EAGAIN : ETIMEDOUT;
+			throw internal_exception();
+		}
+
+	public:
+		explicit channel_endpoint(channel& c)
+			: d_channel(c) {}
+
+		int sendmsg(message&& msg, bool dont_wait) override {
+			int nb = d_channel.sendmsg(std::move(msg), dont_wait);
+			if (-1 == nb) {
+				fail(dont_wait);
+			}
+			return nb;
+		}
+
+		std::unique_ptr<message> recvmsg(bool dont_wait) override {
+			std::unique_ptr<message> msg = d_channel.recvmsg(dont_wait);
+			if (!msg) {
+				fail(dont_wait);
+			}
+			return msg;
+		}
+
+		void recvmsg(message& msg, bool dont_wait) override {
+			if (!d_channel.recvmsg(msg, dont_wait)) {
+				fail(dont_wait);
+			}
+		}
+	};
+
+}
+
+std::unique_ptr<endpoint>
+endpoint::wrap(socket& s) {
+	return std::unique_ptr<endpoint>(new socket_endpoint(s));
+}
+
+std::unique_ptr<endpoint>
+endpoint::wrap(channel& c) {
+	return std::unique_ptr<endpoint>(new channel_endpoint(c));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_ENDPOINT_HPP_INCLUDED
+#define NANOMSGPP_ENDPOINT_HPP_INCLUDED
+
+#ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
+#	include "message.hpp"
+#endif
+
+#include <memory>
+
+namespace nanomsgpp {
+
+	class channel;
+	class socket;
+
+	// An endpoint sends and receives messages on either a socket or a channel, so that code
+	// written against it can switch between an inproc socket pair and a channel by
+	// configuration. Both follow the convention of a socket: a call which would block throws
+	// an internal_exception carrying EAGAIN, one which times out throws ETIMEDOUT, and a
+	// message which is not sent is left with the caller.
+	//
+	// An endpoint does not own what it wraps, which must outlive it.
+	class endpoint {
+	public:
+		// Destructor.
+		virtual ~endpoint() {}
+
+		// Wrap a socket.
+		static std::unique_ptr<endpoint> wrap(socket& s);
+
+		// Wrap a channel.
+		static std::unique_ptr<endpoint> wrap(channel& c);
+
+		// MANIPULATORS
+
+		// Send a message, setting dont_wait to false will cause the call to block. Returns
+		// the number of body bytes sent.
+		virtual int sendmsg(message&& msg, bool dont_wait = true) = 0;
+
+		// Receive a message, setting dont_wait to false will cause the call to block. A
+		// message received from a socket has a single part holding the whole body.
+		virtual std::unique_ptr<message> recvmsg(bool dont_wait = true) = 0;
+
+		// Receive a message into msg, replacing its parts, which avoids allocating the
+		// message.
+		virtual void recvmsg(message& msg, bool dont_wait = true) = 0;
+	};
+
+}
+
+#endif
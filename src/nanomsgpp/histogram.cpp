@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/histogram.hpp"
+
+#include <algorithm>
+
+using namespace nanomsgpp;
+
+histogram::snapshot::snapshot()
+	: d_counts(n_buckets, 0)
+	, d_count(0)
+	, d_sum(0)
+	, d_max(0)
+{}
+
+histogram::snapshot::snapshot(std::vector<uint64_t>&& counts, uint64_t sum, uint64_t max)
+	: d_counts(std::move(counts))
+	, d_count(0)
+	, d_sum(sum)
+	, d_max(0)
+{
+	size_t highest = 0;
+	for (size_t i = 0; i < d_counts.size(); ++i) {
+		if (d_counts[i] != 0) {
+			d_count += d_counts[i];
+			highest = i;
+		}
+	}
+	// the maximum may not have been raised yet for a value whose count was read, or may
+	// belong to a value counted by the previous snapshot
+	d_max = std::max(max, (d_count != 0) ? lowest_of(highest) : 0);
+}
+
+uint64_t
+histogram::snapshot::min() const {
+	for (size_t i = 0; i < d_counts.size(); ++i) {
+		if (d_counts[i] != 0) {
+			return lowest_of(i);
+		}
+	}
+	return 0;
+}
+
+double
+histogram::snapshot::mean() const {
+	return (d_count != 0) ? static_cast<double>(d_sum) / d_count : 0.0;
+}
+
+uint64_t
+histogram::snapshot::percentile(double p) const {
+	if (0 == d_count) {
+		return 0;
+	}
+	uint64_t rank = static_cast<uint64_t>(p / 100.0 * d_count + 0.5);
+	rank = std::min(std::max<uint64_t>(rank, 1), d_count);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < d_counts.size(); ++i) {
+		seen += d_counts[i];
+		if (seen >= rank) {
+			return std::min(highest_of(i), d_max);
+		}
+	}
+	return d_max;
+}
+
+void
+histogram::snapshot::merge(const snapshot& other) {
+	for (size_t i = 0; i < d_counts.size(); ++i) {
+		d_counts[i] += other.d_counts[i];
+	}
+	d_count += other.d_count;
+	d_sum += other.d_sum;
+	d_max = std::max(d_max, other.d_max);
+}
+
+histogram::histogram()
+	: d_sum(0)
+	, d_max(0)
+{
+	for (size_t i = 0; i < n_buckets; ++i) {
+		d_counts[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+histogram::snapshot
+histogram::get_snapshot() const {
+	std::vector<uint64_t> counts(n_buckets);
+	for (size_t i = 0; i < n_buckets; ++i) {
+		counts[i] = d_counts[i].load(std::memory_order_relaxed);
+	}
+	return snapshot(std::move(counts),
+		d_sum.load(std::memory_order_relaxed), d_max.load(std::memory_order_relaxed));
+}
+
+histogram::snapshot
+histogram::reset() {
+	std::vector<uint64_t> counts(n_buckets);
+	for (size_t i = 0; i < n_buckets; ++i) {
+		counts[i] = d_counts[i].exchange(0, std::memory_order_relaxed);
+	}
+	return snapshot(std::move(counts),
+		d_sum.exchange(0, std::memory_order_relaxed), d_max.exchange(0, std::memory_order_relaxed));
+}
+
+uint64_t
+histogram::lowest_of(size_t bucket) {
+	if (bucket < 64) {
+		return bucket;
+	}
+	unsigned msb = 6 + static_cast<unsigned>((bucket - 64) / 32);
+	return static_cast<uint64_t>(32 + (bucket - 64) % 32) << (msb - 5);
+}
+
+uint64_t
+histogram::highest_of(size_t bucket) {
+	if (bucket < 64) {
+		return bucket;
+	}
+	unsigned msb = 6 + static_cast<unsigned>((bucket - 64) / 32);
+	return lowest_of(bucket) + ((static_cast<uint64_t>(1) << (msb - 5)) - 1);
+}
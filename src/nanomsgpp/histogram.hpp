@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_HISTOGRAM_HPP_INCLUDED
+#define NANOMSGPP_HISTOGRAM_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A histogram counts recorded values in log-linear buckets, in the manner of an HDR
+	// histogram: values below 64 have a bucket each, and every power of two above that is
+	// split into 32 buckets, so any value from 0 to 2^64 is kept to within about 3% using a
+	// fixed 15kB of counters. Recording is a few relaxed atomic increments, so any number of
+	// threads may record while another takes snapshots or resets the histogram.
+	class histogram {
+	public:
+		// The number of buckets a histogram is split into.
+		static const size_t n_buckets = 1920;
+
+		// A snapshot of the counts of a histogram.
+		class snapshot {
+			std::vector<uint64_t> d_counts;
+			uint64_t              d_count;
+			uint64_t              d_sum;
+			uint64_t              d_max;
+
+		public:
+			// Construct an empty snapshot.
+			snapshot();
+
+			// Construct a snapshot of the given bucket counts, sum and maximum.
+			snapshot(std::vector<uint64_t>&& counts, uint64_t sum, uint64_t max);
+
+			// MANIPULATORS
+
+			// Get the number of values recorded.
+			uint64_t count() const { return d_count; }
+
+			// Get the sum of the values recorded.
+			uint64_t sum() const { return d_sum; }
+
+			// Get the largest value recorded.
+			uint64_t max() const { return d_max; }
+
+			// Get the smallest value recorded, to within the precision of the histogram.
+			uint64_t min() const;
+
+			// Get the mean of the values recorded.
+			double mean() const;
+
+			// Get the value below which the given percentage of the values recorded fall, to
+			// within the precision of the histogram. Zero when nothing was recorded.
+			uint64_t percentile(double p) const;
+
+			// Get the count of each bucket.
+			const std::vector<uint64_t>& counts() const { return d_counts; }
+
+			// Add the counts of another snapshot to this one.
+			void merge(const snapshot& other);
+		};
+
+	private:
+		std::atomic<uint64_t> d_counts[n_buckets];
+		std::atomic<uint64_t> d_sum;
+		std::atomic<uint64_t> d_max;
+
+	public:
+		// Construct an empty histogram.
+		histogram();
+
+		// MANIPULATORS
+
+		// Record a value.
+		void record(uint64_t value) {
+			d_counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+			d_sum.fetch_add(value, std::memory_order_relaxed);
+			uint64_t max = d_max.load(std::memory_order_relaxed);
+			while (value > max && !d_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+			}
+		}
+
+		// Get a snapshot of the counts. A snapshot taken while values are being recorded may
+		// miss the sum or maximum of a value whose count it holds.
+		snapshot get_snapshot() const;
+
+		// Get a snapshot of the counts and reset them to zero. Every value recorded is counted
+		// by exactly one snapshot, even while other threads are recording.
+		snapshot reset();
+
+		// Get the bucket a value is counted in.
+		static size_t bucket_of(uint64_t value) {
+			if (value < 64) {
+				return static_cast<size_t>(value);
+			}
+			unsigned msb = 63 - __builtin_clzll(value);
+			return 64 + (msb - 6) * 32 + static_cast<size_t>((value >> (msb - 5)) - 32);
+		}
+
+		// Get the smallest value counted in a bucket.
+		static uint64_t lowest_of(size_t bucket);
+
+		// Get the largest value counted in a bucket.
+		static uint64_t highest_of(size_t bucket);
+
+	private:
+		// NOT IMPLEMENTED
+		histogram(const histogram& other) = delete;
+		histogram& operator=(const histogram& other) = delete;
+	};
+
+}
+
+#endif
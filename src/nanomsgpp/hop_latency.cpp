@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/hop_latency.hpp"
+#include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/trace.hpp"
+
+#include <cstring>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// The magic ending every stamp. It is four bytes wide, so that a body which is not
+	// stamped is very unlikely to end like one.
+	const unsigned char stamp_magic[4] = { 0x4e, 0x48, 0x4c, 0xa7 };
+
+	// A stamp is laid out as the clock (8 bytes), the hop id (2 bytes), the position of the
+	// stamp counting from one (2 bytes) and the magic, in host byte order.
+	void put_stamp(unsigned char* out, int64_t now, uint16_t id, size_t position) {
+		uint16_t p = static_cast<uint16_t>(position);
+		std::memcpy(out, &now, sizeof(now));
+		std::memcpy(out + 8, &id, sizeof(id));
+		std::memcpy(out + 10, &p, sizeof(p));
+		std::memcpy(out + 12, stamp_magic, sizeof(stamp_magic));
+	}
+
+	// Get the position of a stamp, or zero if it does not end with the magic.
+	size_t stamp_position(const unsigned char* in) {
+		if (std::memcmp(in + 12, stamp_magic, sizeof(stamp_magic)) != 0) {
+			return 0;
+		}
+		uint16_t p;
+		std::memcpy(&p, in + 10, sizeof(p));
+		return p;
+	}
+
+	int64_t stamp_time(const unsigned char* in) {
+		int64_t t;
+		std::memcpy(&t, in, sizeof(t));
+		return t;
+	}
+
+	uint16_t stamp_id(const unsigned char* in) {
+		uint16_t id;
+		std::memcpy(&id, in + 8, sizeof(id));
+		return id;
+	}
+
+	// Get the latency between two clock readings, which is zero if the clock went backwards.
+	uint64_t elapsed(int64_t from, int64_t to) {
+		return (to > from) ? static_cast<uint64_t>(to - from) : 0;
+	}
+
+}
+
+hop_latency::hop_latency(uint16_t id)
+	: d_id(id)
+	, d_n_hops(0)
+{}
+
+bool
+hop_latency::stamp(message& msg, uint16_t id) {
+	size_t n = 0;
+	if (msg.size() != 0) {
+		part& last = msg.at(msg.size() - 1);
+		if (last.size() != NN_MSG) {
+			n = count(last.as<void>(), last.size());
+		}
+		// a part added by an earlier stamp holds only the last of the stamps
+		if (0 == n && stamp_size == last.size()) {
+			n = stamp_position(last.as<unsigned char>());
+		}
+	}
+	if (n >= max_stamps) {
+		return (false);
+	}
+	part p(stamp_size);
+	put_stamp(p.as<unsigned char>(), trace_now(), id, n + 1);
+	msg.add_part(std::move(p));
+	return (true);
+}
+
+bool
+hop_latency::stamp(message_view& msg, uint16_t id) {
+	size_t size = msg.size();
+	size_t n = count(msg.data(), size);
+	if (n >= max_stamps || !msg.resize(size + stamp_size)) {
+		return (false);
+	}
+	put_stamp(msg.data() + size, trace_now(), id, n + 1);
+	return (true);
+}
+
+device::hook
+hop_latency::stamper(uint16_t id) {
+	return [id](device::direction, message_view& msg) {
+		stamp(msg, id);
+		return (true);
+	};
+}
+
+size_t
+hop_latency::count(const void* body, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(body);
+	if (size < stamp_size) {
+		return 0;
+	}
+	size_t n = stamp_position(bytes + size - stamp_size);
+	if (0 == n || n > max_stamps || size < n * stamp_size) {
+		return 0;
+	}
+	// every stamp must be in place, or the trailer is a coincidence of the body
+	for (size_t i = 1; i < n; ++i) {
+		if (stamp_position(bytes + size - (i + 1) * stamp_size) != n - i) {
+			return 0;
+		}
+	}
+	return n;
+}
+
+size_t
+hop_latency::record(const void* body, size_t size) {
+	size_t n = count(body, size);
+	if (0 == n) {
+		return size;
+	}
+	int64_t now = trace_now();
+	const unsigned char* first = static_cast<const unsigned char*>(body) + size - n * stamp_size;
+	int64_t previous = stamp_time(first);
+	for (size_t i = 1; i < n; ++i) {
+		const unsigned char* s = first + i * stamp_size;
+		histogram* h = find_hop(stamp_id(s));
+		if (h != nullptr) {
+			h->record(elapsed(previous, stamp_time(s)));
+		}
+		previous = stamp_time(s);
+	}
+	histogram* h = find_hop(d_id);
+	if (h != nullptr) {
+		h->record(elapsed(previous, now));
+	}
+	d_end_to_end.record(elapsed(stamp_time(first), now));
+	return size - n * stamp_size;
+}
+
+size_t
+hop_latency::record(message& msg) {
+	if (0 == msg.size()) {
+		return 0;
+	}
+	part& last = msg.at(msg.size() - 1);
+	if (NN_MSG == last.size()) {
+		// the size of a chunk being sent is not known, so its stamps cannot be found
+		throw exception("cannot record a part allocated by nn_allocmsg");
+	}
+	size_t size = record(last.as<void>(), last.size());
+	last.shrink(size);
+	return size;
+}
+
+size_t
+hop_latency::record(message_view& msg) {
+	size_t size = record(msg.data(), msg.size());
+	if (size != msg.size()) {
+		// shrinking a chunk is done in place
+		msg.resize(size);
+	}
+	return size;
+}
+
+hop_latency::snapshot
+hop_latency::get_snapshot() const {
+	snapshot result;
+	result.end_to_end_ns = d_end_to_end.get_snapshot();
+	size_t n = d_n_hops.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		hop h = { d_hop_ids[i], d_hops[i]->get_snapshot() };
+		result.hops.push_back(std::move(h));
+	}
+	return result;
+}
+
+hop_latency::snapshot
+hop_latency::reset() {
+	snapshot result;
+	result.end_to_end_ns = d_end_to_end.reset();
+	size_t n = d_n_hops.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		hop h = { d_hop_ids[i], d_hops[i]->reset() };
+		result.hops.push_back(std::move(h));
+	}
+	return result;
+}
+
+histogram*
+hop_latency::find_hop(uint16_t id) {
+	// only the recording thread adds hops, so it can read the count without ordering
+	size_t n = d_n_hops.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < n; ++i) {
+		if (d_hop_ids[i] == id) {
+			return d_hops[i].get();
+		}
+	}
+	if (n == max_hops) {
+		return nullptr;
+	}
+	d_hop_ids[n] = id;
+	d_hops[n].reset(new histogram());
+	d_n_hops.store(n + 1, std::memory_order_release);
+	return d_hops[n].get();
+}
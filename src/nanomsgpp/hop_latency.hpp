@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_HOP_LATENCY_HPP_INCLUDED
+#define NANOMSGPP_HOP_LATENCY_HPP_INCLUDED
+
+#ifndef NANOMSGPP_DEVICE_HPP_INCLUDED
+#	include "device.hpp"
+#endif
+#ifndef NANOMSGPP_HISTOGRAM_HPP_INCLUDED
+#	include "histogram.hpp"
+#endif
+#ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
+#	include "message.hpp"
+#endif
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#	include "message_view.hpp"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// Hop latency measures one-way latency along chains of sockets and devices on one host.
+	// Each sender and device hop appends a 16 byte stamp to the body, holding the monotonic
+	// clock and the id of the hop; the receiver strips the stamps and records the time each
+	// hop took into histograms, along with the time from the first stamp to the receiver.
+	//
+	// Stamps are only appended, so a hop never rewrites the body, and each stamp carries its
+	// position and a 4 byte magic so a receiver can tell a stamped body from an unstamped one;
+	// an unstamped body is only mistaken for a stamped one if its last 6 bytes match. The
+	// monotonic clock is shared by all processes on a host, but not between hosts, so stamps
+	// must be stripped before a message leaves the host. Both ends of a chain must opt in.
+	class hop_latency {
+	public:
+		// The number of bytes each stamp adds to a body.
+		static const size_t stamp_size = 16;
+
+		// The most hops a body may be stamped by.
+		static const size_t max_stamps = 255;
+
+		// The most distinct hops a recorder keeps a histogram for.
+		static const size_t max_hops = 64;
+
+		// The latency of the hop with the given id, measured from the previous stamp.
+		struct hop {
+			uint16_t            id;
+			histogram::snapshot latency_ns;
+		};
+
+		// A snapshot of the histograms of a recorder.
+		struct snapshot {
+			histogram::snapshot end_to_end_ns;  // time from the first stamp to the receiver
+			std::vector<hop>    hops;           // time taken by each hop, in order seen
+		};
+
+	private:
+		uint16_t                   d_id;
+		histogram                  d_end_to_end;
+		uint16_t                   d_hop_ids[max_hops];
+		std::unique_ptr<histogram> d_hops[max_hops];
+		std::atomic<size_t>        d_n_hops;
+
+	public:
+		// Construct a recorder for the receiver with the given hop id, which the time from
+		// the last stamp to the receiver is recorded against.
+		explicit hop_latency(uint16_t id);
+
+		// MANIPULATORS
+
+		// Stamp a message before it is sent, adding a part. Returns false if the body already
+		// carries max_stamps stamps.
+		static bool stamp(message& msg, uint16_t id);
+
+		// Stamp a received message in place, growing its body chunk. Returns false if the
+		// body carries max_stamps stamps or cannot be grown.
+		static bool stamp(message_view& msg, uint16_t id);
+
+		// Get a device hook stamping every message the device forwards.
+		static device::hook stamper(uint16_t id);
+
+		// Get the number of stamps at the end of a body.
+		static size_t count(const void* body, size_t size);
+
+		// Record the latencies of a received body. Returns the size of the body without its
+		// stamps, which is the size unchanged if it carries none.
+		size_t record(const void* body, size_t size);
+
+		// Record the latencies of a received message and strip its stamps from its last part.
+		// Returns the new size of that part. Received messages hold parts of known size;
+		// throws if the last part was allocated by nn_allocmsg, whose size is not known.
+		size_t record(message& msg);
+
+		// Record the latencies of a received message and strip its stamps in place.
+		size_t record(message_view& msg);
+
+		// Get a snapshot of the histograms. Only one thread may record at a time, but any
+		// thread may take snapshots.
+		snapshot get_snapshot() const;
+
+		// Get a snapshot of the histograms and reset them, without stopping the recording.
+		snapshot reset();
+
+	private:
+		// Get the histogram of the hop with the given id, adding it if there is room.
+		histogram* find_hop(uint16_t id);
+
+		// NOT IMPLEMENTED
+		hop_latency(const hop_latency& other) = delete;
+		hop_latency& operator=(const hop_latency& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/key_router.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <algorithm>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// FNV-1a followed by a 64 bit finalizer, so keys differing only in their last bytes are
+	// still spread over the whole ring.
+	uint64_t hash_of(const void* data, size_t size) {
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) {
+			h = (h ^ p[i]) * 1099511628211ull;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+}
+
+key_router::key_router(socket_type type, size_t n_vnodes)
+	: d_type(type)
+	, d_n_vnodes(std::max<size_t>(n_vnodes, 1))
+{
+	if (type != socket_type::push && type != socket_type::pair) {
+		throw exception("key router targets must be push or pair sockets");
+	}
+}
+
+void
+key_router::add_target(const std::string& endpoint) {
+	if (d_targets.count(endpoint) > 0) {
+		throw exception("key router already has a target for " + endpoint);
+	}
+	std::unique_ptr<target> t(new target(endpoint, d_type));
+	t->d_socket.connect(endpoint);
+
+	for (size_t i = 0; i < d_n_vnodes; ++i) {
+		std::string name = endpoint + "#" + std::to_string(i);
+		d_ring.push_back(vnode(hash_of(name.data(), name.size()), t.get()));
+	}
+	std::sort(d_ring.begin(), d_ring.end());
+	d_targets[endpoint] = std::move(t);
+}
+
+bool
+key_router::remove_target(const std::string& endpoint) {
+	auto found = d_targets.find(endpoint);
+	if (found == d_targets.end()) {
+		return (false);
+	}
+	target* t = found->second.get();
+	d_ring.erase(std::remove_if(d_ring.begin(), d_ring.end(),
+		[t](const vnode& v) { return v.second == t; }), d_ring.end());
+	d_targets.erase(found);
+	return (true);
+}
+
+std::vector<std::string>
+key_router::targets() const {
+	std::vector<std::string> endpoints;
+	for (auto& t : d_targets) {
+		endpoints.push_back(t.first);
+	}
+	return endpoints;
+}
+
+socket&
+key_router::get_socket(const std::string& endpoint) {
+	auto found = d_targets.find(endpoint);
+	if (found == d_targets.end()) {
+		throw exception("key router has no target for " + endpoint);
+	}
+	return found->second->d_socket;
+}
+
+const std::string&
+key_router::target_of(const void* key, size_t key_size) const {
+	return find(key, key_size).d_endpoint;
+}
+
+int
+key_router::sendmsg(const void* key, size_t key_size, message&& msg, bool dont_wait) {
+	target& t = find(key, key_size);
+	try {
+		int nb = t.d_socket.sendmsg(std::move(msg), dont_wait);
+		t.d_messages.fetch_add(1, std::memory_order_relaxed);
+		t.d_bytes.fetch_add(nb, std::memory_order_relaxed);
+		return nb;
+	} catch (...) {
+		t.d_errors.fetch_add(1, std::memory_order_relaxed);
+		throw;
+	}
+}
+
+key_router::counters
+key_router::get_counters(const std::string& endpoint) const {
+	auto found = d_targets.find(endpoint);
+	if (found == d_targets.end()) {
+		throw exception("key router has no target for " + endpoint);
+	}
+	const target& t = *found->second;
+	counters c;
+	c.messages = t.d_messages.load(std::memory_order_relaxed);
+	c.bytes    = t.d_bytes.load(std::memory_order_relaxed);
+	c.errors   = t.d_errors.load(std::memory_order_relaxed);
+	return c;
+}
+
+key_router::target&
+key_router::find(const void* key, size_t key_size) const {
+	if (d_ring.empty()) {
+		throw exception("key router has no targets");
+	}
+	// the key belongs to the first virtual node at or after its hash, wrapping around
+	vnode v(hash_of(key, key_size), nullptr);
+	auto it = std::lower_bound(d_ring.begin(), d_ring.end(), v,
+		[](const vnode& a, const vnode& b) { return a.first < b.first; });
+	if (it == d_ring.end()) {
+		it = d_ring.begin();
+	}
+	return *it->second;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_KEY_ROUTER_HPP_INCLUDED
+#define NANOMSGPP_KEY_ROUTER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A key router sends each message to one of several targets chosen by consistent hashing
+	// on a key, so messages with the same key reach the same worker. Each target owns a PUSH or
+	// PAIR socket connected to its endpoint and is placed on a hash ring at many virtual nodes.
+	// Adding or removing a target only moves the keys between it and its ring neighbours.
+	//
+	// Sending may be done from several threads, but targets must not be added or removed while
+	// messages are being sent.
+	class key_router {
+	public:
+		// A snapshot of the counters of a target.
+		struct counters {
+			uint64_t messages;  // number of messages sent
+			uint64_t bytes;     // number of bytes sent
+			uint64_t errors;    // number of messages the socket did not accept
+		};
+
+	private:
+		struct target {
+			std::string           d_endpoint;
+			socket                d_socket;
+			std::atomic<uint64_t> d_messages;
+			std::atomic<uint64_t> d_bytes;
+			std::atomic<uint64_t> d_errors;
+
+			target(const std::string& endpoint, socket_type type)
+				: d_endpoint(endpoint)
+				, d_socket(socket_domain::sp, type)
+				, d_messages(0)
+				, d_bytes(0)
+				, d_errors(0) {}
+		};
+
+		typedef std::pair<uint64_t, target*> vnode;
+
+		socket_type                                    d_type;
+		size_t                                         d_n_vnodes;
+		std::map<std::string, std::unique_ptr<target>> d_targets;
+		std::vector<vnode>                             d_ring;
+
+	public:
+		// Construct a router whose targets use sockets of the given type, each placed on the
+		// ring at n_vnodes virtual nodes.
+		explicit key_router(socket_type type = socket_type::push, size_t n_vnodes = 160);
+
+		// MANIPULATORS
+
+		// Add a target connected to the given endpoint.
+		void add_target(const std::string& endpoint);
+
+		// Remove the target connected to the given endpoint. Returns false if there is none.
+		bool remove_target(const std::string& endpoint);
+
+		// Get the number of targets.
+		size_t size() const { return d_targets.size(); }
+
+		// Get the endpoints of the targets.
+		std::vector<std::string> targets() const;
+
+		// Get the socket of a target, for setting options.
+		socket& get_socket(const std::string& endpoint);
+
+		// Get the endpoint of the target for a key. Throws if there are no targets.
+		const std::string& target_of(const void* key, size_t key_size) const;
+
+		// Send a message to the target for a key, returning the number of bytes sent.
+		int sendmsg(const void* key, size_t key_size, message&& msg, bool dont_wait = true);
+
+		// Get a snapshot of the counters of a target.
+		counters get_counters(const std::string& endpoint) const;
+
+	private:
+		// Get the target for a key.
+		target& find(const void* key, size_t key_size) const;
+
+		// NOT IMPLEMENTED
+		key_router(const key_router& other) = delete;
+		key_router& operator=(const key_router& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/lz_codec.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	const int      hash_bits     = 14;
+	const size_t   min_match     = 4;
+	const size_t   last_literals = 5;   // the last bytes of a block are always literals
+	const size_t   match_limit   = 12;  // no match may start in the last bytes of a block
+	const uint32_t max_offset    = 65535;
+
+	inline uint32_t read32(const unsigned char* p) {
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t hash(uint32_t v) {
+		return (v * 2654435761U) >> (32 - hash_bits);
+	}
+
+	// Write a length which did not fit in its token nibble.
+	inline unsigned char* write_length(unsigned char* op, size_t len) {
+		while (len >= 255) {
+			*op++ = 255;
+			len -= 255;
+		}
+		*op++ = static_cast<unsigned char>(len);
+		return op;
+	}
+
+	// Write a sequence of literals followed by a match, or only literals if match_len is 0.
+	inline unsigned char* write_sequence(unsigned char* op, const unsigned char* literals,
+			size_t literal_len, uint32_t offset, size_t match_len) {
+		unsigned char* token = op++;
+		*token = static_cast<unsigned char>(((literal_len >= 15) ? 15 : literal_len) << 4);
+		if (literal_len >= 15) {
+			op = write_length(op, literal_len - 15);
+		}
+		std::memcpy(op, literals, literal_len);
+		op += literal_len;
+		if (0 == match_len) {
+			return op;
+		}
+		*op++ = static_cast<unsigned char>(offset);
+		*op++ = static_cast<unsigned char>(offset >> 8);
+		size_t len = match_len - min_match;
+		*token |= static_cast<unsigned char>((len >= 15) ? 15 : len);
+		if (len >= 15) {
+			op = write_length(op, len - 15);
+		}
+		return op;
+	}
+
+}
+
+lz_codec::lz_codec()
+	: d_table(size_t(1) << hash_bits, 0)
+	, d_base(1)
+{}
+
+size_t
+lz_codec::compress(const void* src, size_t n, void* dst) {
+	const unsigned char* in = static_cast<const unsigned char*>(src);
+	unsigned char* op = static_cast<unsigned char*>(dst);
+
+	// positions are stored relative to a base which moves on for every block, so entries left
+	// by earlier blocks are recognised as stale without clearing the table
+	if (n >= 0x7fffffff || d_base > 0xffffffff - n - max_offset - 1) {
+		std::fill(d_table.begin(), d_table.end(), 0);
+		d_base = 1;
+	}
+	uint32_t base = d_base;
+	d_base += static_cast<uint32_t>(n) + max_offset + 1;
+
+	size_t anchor = 0;
+	if (n > match_limit) {
+		size_t limit = n - match_limit;
+		size_t ip = 0;
+		size_t misses = 0;
+		while (ip < limit) {
+			uint32_t seq = read32(in + ip);
+			uint32_t& slot = d_table[hash(seq)];
+			uint32_t candidate = slot;
+			slot = base + static_cast<uint32_t>(ip);
+			if (candidate >= base && base + ip - candidate <= max_offset
+					&& read32(in + candidate - base) == seq) {
+				size_t ref = candidate - base;
+				size_t len = min_match;
+				size_t end = n - last_literals;
+				while (ip + len < end && in[ref + len] == in[ip + len]) {
+					len++;
+				}
+				// extend the match backwards over literals which also match
+				while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1]) {
+					ip--;
+					ref--;
+					len++;
+				}
+				op = write_sequence(op, in + anchor, ip - anchor,
+					static_cast<uint32_t>(ip - ref), len);
+				ip += len;
+				anchor = ip;
+				misses = 0;
+			} else {
+				// skip faster through data which does not compress
+				ip += 1 + (misses++ >> 6);
+			}
+		}
+	}
+	op = write_sequence(op, in + anchor, n - anchor, 0, 0);
+	return op - static_cast<unsigned char*>(dst);
+}
+
+bool
+lz_codec::decompress(const void* src, size_t n, void* dst, size_t capacity, size_t& size) {
+	const unsigned char* ip = static_cast<const unsigned char*>(src);
+	const unsigned char* end = ip + n;
+	unsigned char* out = static_cast<unsigned char*>(dst);
+	unsigned char* op = out;
+	unsigned char* op_end = out + capacity;
+
+	while (ip < end) {
+		unsigned char token = *ip++;
+		size_t literal_len = token >> 4;
+		if (15 == literal_len) {
+			unsigned char b;
+			do {
+				if (ip >= end) {
+					return (false);
+				}
+				b = *ip++;
+				literal_len += b;
+			} while (255 == b);
+		}
+		if (literal_len > static_cast<size_t>(end - ip)
+				|| literal_len > static_cast<size_t>(op_end - op)) {
+			return (false);
+		}
+		std::memcpy(op, ip, literal_len);
+		ip += literal_len;
+		op += literal_len;
+		if (ip == end) {
+			break;
+		}
+
+		if (end - ip < 2) {
+			return (false);
+		}
+		size_t offset = ip[0] | (size_t(ip[1]) << 8);
+		ip += 2;
+		if (0 == offset || offset > static_cast<size_t>(op - out)) {
+			return (false);
+		}
+		size_t match_len = token & 15;
+		if (15 == match_len) {
+			unsigned char b;
+			do {
+				if (ip >= end) {
+					return (false);
+				}
+				b = *ip++;
+				match_len += b;
+			} while (255 == b);
+		}
+		match_len += min_match;
+		if (match_len > static_cast<size_t>(op_end - op)) {
+			return (false);
+		}
+		// matches may overlap their own output, so they are copied forwards byte by byte
+		// unless the offset is at least the length of the match
+		const unsigned char* ref = op - offset;
+		if (offset >= match_len) {
+			std::memcpy(op, ref, match_len);
+			op += match_len;
+		} else {
+			for (size_t i = 0; i < match_len; ++i) {
+				*op++ = *ref++;
+			}
+		}
+		// a block always ends with literals, so one ending with a match was cut short
+		if (ip == end) {
+			return (false);
+		}
+	}
+	size = op - out;
+	return (true);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_LZ_CODEC_HPP_INCLUDED
+#define NANOMSGPP_LZ_CODEC_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// An lz_codec is a fast LZ77 compressor producing blocks in the LZ4 block format. The
+	// codec keeps its match table between calls, so one codec should be reused by a thread
+	// rather than created for each block. Decompression is stateless.
+	class lz_codec {
+		std::vector<uint32_t> d_table;
+		uint32_t              d_base;
+
+	public:
+		// Default constructor.
+		lz_codec();
+
+		// MANIPULATORS
+
+		// Get the largest compressed size of a block of n bytes.
+		static size_t max_compressed_size(size_t n) { return n + n / 255 + 16; }
+
+		// Compress n bytes from src into dst, which must hold max_compressed_size(n) bytes.
+		// Returns the compressed size.
+		size_t compress(const void* src, size_t n, void* dst);
+
+		// Decompress a block of n bytes from src into dst, which holds capacity bytes. Returns
+		// false if the block is malformed or does not fit, otherwise stores the decompressed
+		// size.
+		static bool decompress(const void* src, size_t n, void* dst, size_t capacity,
+			size_t& size);
+
+	private:
+		// NOT IMPLEMENTED
+		lz_codec(const lz_codec& other) = delete;
+		lz_codec& operator=(const lz_codec& other) = delete;
+	};
+
+}
+
+#endif
@@ -22,11 +22,30 @@
 
 #include "nanomsgpp/message.hpp"
 #include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/trace.hpp"
 #include <nanomsg/nn.h>
+#include <cerrno>
 #include <cstring>
 
 using namespace nanomsgpp;
 
+namespace {
+
+	// Allocate the buffer of a part with malloc, or with nn_allocmsg if chunk is set, firing
+	// the part_alloc tracepoint.
+	void* allocate(size_t size, bool chunk, int type = 0) {
+		if (!NANOMSGPP_TRACE_ENABLED(part_alloc)) {
+			return chunk ? nn_allocmsg(size, type) : std::malloc(size);
+		}
+		int64_t start = trace_now();
+		void* p = chunk ? nn_allocmsg(size, type) : std::malloc(size);
+		NANOMSGPP_TRACE(part_alloc, chunk ? 1 : 0, size, (nullptr == p) ? ENOMEM : 0,
+			trace_now() - start);
+		return p;
+	}
+
+}
+
 part::part(part&& other)
 	: d_msg(other.release())
 	, d_size(other.d_size)
@@ -39,20 +58,20 @@ part::part(const void* ptr, size_t size, bool deep_copy)
 	, d_malloc(deep_copy)
 {
 	if (deep_copy) {
-		d_msg  = std::malloc(size);
+		d_msg  = allocate(size, false);
 		d_size = size;
 		std::memcpy(d_msg, ptr, size);
 	}
 }
 
 part::part(size_t size, int type)
-	: d_msg(nn_allocmsg(size, type))
+	: d_msg(allocate(size, true, type))
 	, d_size(NN_MSG)
 	, d_malloc(false)
 {}
 
 part::part(size_t size)
-	: d_msg(std::malloc(sizeof(char) * size))
+	: d_msg(allocate(sizeof(char) * size, false))
 	, d_size(size)
 	, d_malloc(true)
 {}
@@ -123,14 +142,30 @@ message::gen_nn_msghdr() {
 		(std::malloc(sizeof(nn_iovec) * d_parts.size()));
 	int i = 0;
 	for (auto& p : d_parts) {
-		void* ptr = p.as<void>();
-		iov[i].iov_base = ptr;
+		// a part allocated by nn_allocmsg is passed by the address of its pointer, so that
+		// nanomsg takes the chunk rather than copying it
+		iov[i].iov_base = (NN_MSG == p.size()) ? static_cast<void*>(p) : p.as<void>();
 		iov[i].iov_len = p.size();
 		i++;
 	}
 	std::memset(hdr, 0, sizeof(nn_msghdr));
 	hdr->msg_iov = iov;
 	hdr->msg_iovlen = i;
+	if (!d_header.empty()) {
+		// the protocol header is passed as a single SP_HDR control message, which holds
+		// the length of the header followed by the header itself
+		size_t len = sizeof(size_t) + d_header.size();
+		struct nn_cmsghdr *cmsg = static_cast<nn_cmsghdr*>
+			(std::calloc(1, NN_CMSG_SPACE(len)));
+		cmsg->cmsg_len   = NN_CMSG_LEN(len);
+		cmsg->cmsg_level = PROTO_SP;
+		cmsg->cmsg_type  = SP_HDR;
+		size_t size = d_header.size();
+		std::memcpy(NN_CMSG_DATA(cmsg), &size, sizeof(size));
+		std::memcpy(NN_CMSG_DATA(cmsg) + sizeof(size), d_header.data(), size);
+		hdr->msg_control = cmsg;
+		hdr->msg_controllen = NN_CMSG_SPACE(len);
+	}
 	return msghdr_unique_ptr(hdr);
 }
 
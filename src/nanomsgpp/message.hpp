@@ -26,6 +26,7 @@
 #include <nanomsg/nn.h>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace nanomsgpp {
@@ -34,6 +35,7 @@ namespace nanomsgpp {
 	struct msghdr_free {
 		void operator()(void* x) {
 			std::free(static_cast<nn_msghdr*>(x)->msg_iov);
+			std::free(static_cast<nn_msghdr*>(x)->msg_control);
 			std::free(x);
 		}
 	};
@@ -80,6 +82,9 @@ namespace nanomsgpp {
 		// get size of memory pointed to d_msg
 		size_t size() const { return d_size; }
 
+		// shrink the part to its first size bytes, keeping its buffer
+		void shrink(size_t size) { if (size < d_size) { d_size = size; } }
+
 		// transfer ownership of d_msg
 		void* release();
 
@@ -94,7 +99,8 @@ namespace nanomsgpp {
 	// Messages are used to transfer data and events via sockets. Messages are comprised of one or
 	// more parts.
 	class message {
-		parts d_parts;
+		parts       d_parts;
+		std::string d_header;
 
 	public:
 		// default constructor
@@ -155,8 +161,18 @@ namespace nanomsgpp {
 		// get a message part by index
 		part& at(size_t index) { return d_parts.at(index); }
 
+		// get the protocol header of the message. raw sockets use the header to carry the
+		// backtrace which routes a reply to the peer that sent the request
+		const std::string& header() const { return d_header; }
+
+		// set the protocol header of the message
+		void set_header(const std::string& header) { d_header = header; }
+
 		// transfer ownership of message
 		void release();
+
+		// free the parts, keeping the storage of the part list for reuse
+		void clear() { d_parts.clear(); }
 	};
 
 	// INLINE FUNCTION DEFINITIONS
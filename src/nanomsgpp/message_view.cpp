@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/message_view.hpp"
+#include <cstring>
+
+using namespace nanomsgpp;
+
+message_view::message_view(struct nn_msghdr* hdr, size_t size)
+	: d_body(static_cast<void**>(hdr->msg_iov[0].iov_base))
+	, d_size(size)
+	, d_header(nullptr)
+	, d_header_size(0)
+{
+	if (hdr->msg_control == nullptr) {
+		return;
+	}
+	struct nn_cmsghdr* cmsg = NN_CMSG_FIRSTHDR(hdr);
+	while (cmsg != nullptr) {
+		if (cmsg->cmsg_level == PROTO_SP && cmsg->cmsg_type == SP_HDR) {
+			std::memcpy(&d_header_size, NN_CMSG_DATA(cmsg), sizeof(d_header_size));
+			d_header = NN_CMSG_DATA(cmsg) + sizeof(d_header_size);
+			return;
+		}
+		cmsg = NN_CMSG_NXTHDR(hdr, cmsg);
+	}
+}
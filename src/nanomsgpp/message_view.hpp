@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#define NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+
+#include <nanomsg/nn.h>
+#include <cstddef>
+
+namespace nanomsgpp {
+
+	// A message view gives in place access to a message received with nn_recvmsg, whose body
+	// and header are still held in the chunks allocated by nanomsg. The view does not own the
+	// chunks and is only valid while the message is being handled.
+	class message_view {
+		void**         d_body;
+		size_t         d_size;
+		unsigned char* d_header;
+		size_t         d_header_size;
+
+	public:
+		// Construct a view of the body chunk stored in the given slot and of the header bytes.
+		message_view(void** body, size_t size, unsigned char* header, size_t header_size)
+			: d_body(body)
+			, d_size(size)
+			, d_header(header)
+			, d_header_size(header_size) {}
+
+		// Construct a view of a message received into a single NN_MSG body chunk, finding the
+		// protocol header in the control data if there is any.
+		message_view(struct nn_msghdr* hdr, size_t size);
+
+		// MANIPULATORS
+
+		// Get a pointer to the body.
+		unsigned char* data() { return static_cast<unsigned char*>(*d_body); }
+
+		// Convenience method to return the body as a pointer to the given type.
+		template<typename T>
+		T* as() { return static_cast<T*>(*d_body); }
+
+		// Get the size of the body.
+		size_t size() const { return d_size; }
+
+		// Get a pointer to the protocol header, which may be modified in place.
+		unsigned char* header() { return d_header; }
+
+		// Get the size of the protocol header.
+		size_t header_size() const { return d_header_size; }
+
+		// Replace the body with a chunk allocated by nn_allocmsg. The view takes ownership of
+		// the chunk and frees the previous body.
+		void replace(void* chunk, size_t size) {
+			nn_freemsg(*d_body);
+			*d_body = chunk;
+			d_size = size;
+		}
+
+		// Resize the body chunk with nn_reallocmsg, which may move it. Returns false, leaving
+		// the body unchanged, if the chunk cannot be resized.
+		bool resize(size_t size) {
+			void* chunk = nn_reallocmsg(*d_body, size);
+			if (nullptr == chunk) {
+				return (false);
+			}
+			*d_body = chunk;
+			d_size = size;
+			return (true);
+		}
+	};
+
+}
+
+#endif
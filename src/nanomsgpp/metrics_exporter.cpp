@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/metrics_exporter.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// The largest HTTP request head read from a scraper.
+	const size_t max_request_size = 8192;
+
+	// How long a scraper may take to send its request or read the reply, in seconds.
+	const int http_timeout = 2;
+
+	// Build an exception from errno for a failed call.
+	exception system_error(const std::string& what) {
+		return exception(what + ": " + std::strerror(errno));
+	}
+
+	// Write all of buf to a connection.
+	bool write_all(int fd, const char* buf, size_t len) {
+		while (len > 0) {
+			ssize_t n = ::send(fd, buf, len, MSG_NOSIGNAL);
+			if (n < 0) {
+				if (EINTR == errno) {
+					continue;
+				}
+				return (false);
+			}
+			buf += n;
+			len -= n;
+		}
+		return (true);
+	}
+
+	// Send an HTTP response with the given status and plain text body.
+	void respond(int fd, const char* status, const std::string& body, bool head = false) {
+		std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+			"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n"
+			"Connection: close\r\n\r\n";
+		if (!head) {
+			response += body;
+		}
+		write_all(fd, response.data(), response.size());
+	}
+
+}
+
+metrics_exporter::metrics_exporter(metrics_registry& registry)
+	: d_registry(registry)
+	, d_interval(1000)
+	, d_poll_interval(100)
+	, d_listener(-1)
+	, d_http_port(0)
+	, d_running(false)
+{}
+
+metrics_exporter::~metrics_exporter() {
+	stop();
+	if (d_listener >= 0) {
+		::close(d_listener);
+	}
+}
+
+void
+metrics_exporter::serve_http(uint16_t port, const std::string& host) {
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+		throw exception("metrics exporter cannot listen on " + host);
+	}
+
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		throw system_error("metrics exporter cannot create a socket");
+	}
+	int on = 1;
+	::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	socklen_t len = sizeof(addr);
+	if (::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0
+		|| ::listen(fd, 16) != 0
+		|| ::getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+		exception e = system_error("metrics exporter cannot listen on " + host + ":"
+			+ std::to_string(port));
+		::close(fd);
+		throw e;
+	}
+	if (d_listener >= 0) {
+		::close(d_listener);
+	}
+	d_listener = fd;
+	d_http_port = ntohs(addr.sin_port);
+}
+
+void
+metrics_exporter::serve_rep(const std::string& addr) {
+	std::unique_ptr<socket> s(new socket(socket_domain::sp, socket_type::reply));
+	s->bind(addr);
+	d_reply = std::move(s);
+}
+
+void
+metrics_exporter::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	d_registry.collect();
+	d_collector = std::thread(&metrics_exporter::collect_loop, this);
+	if (d_listener >= 0) {
+		d_http = std::thread(&metrics_exporter::http_loop, this);
+	}
+	if (d_reply) {
+		d_reply->set_option(NN_SOL_SOCKET, socket_option::receive_timeout, d_poll_interval);
+		d_rep = std::thread(&metrics_exporter::rep_loop, this);
+	}
+}
+
+void
+metrics_exporter::stop() {
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		if (!d_running.exchange(false)) {
+			return;
+		}
+	}
+	d_cond.notify_all();
+	for (std::thread* t : { &d_collector, &d_http, &d_rep }) {
+		if (t->joinable()) {
+			t->join();
+		}
+	}
+}
+
+void
+metrics_exporter::collect_loop() {
+	std::unique_lock<std::mutex> lock(d_lock);
+	while (d_running.load()) {
+		d_cond.wait_for(lock, std::chrono::milliseconds(d_interval));
+		if (!d_running.load()) {
+			break;
+		}
+		lock.unlock();
+		try {
+			d_registry.collect();
+		} catch (...) {
+			// keep publishing the previous text
+		}
+		lock.lock();
+	}
+}
+
+void
+metrics_exporter::http_loop() {
+	while (d_running.load(std::memory_order_relaxed)) {
+		struct pollfd pfd = { d_listener, POLLIN, 0 };
+		int rc = ::poll(&pfd, 1, d_poll_interval);
+		if (rc <= 0) {
+			continue;
+		}
+		int connection = ::accept(d_listener, nullptr, nullptr);
+		if (connection < 0) {
+			continue;
+		}
+		answer(connection);
+		::close(connection);
+	}
+}
+
+void
+metrics_exporter::answer(int connection) {
+	struct timeval timeout = { http_timeout, 0 };
+	::setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	// reads wake up once per poll interval, so a slow scraper does not hold up stop()
+	struct timeval poll_timeout = { d_poll_interval / 1000, (d_poll_interval % 1000) * 1000 };
+	::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &poll_timeout, sizeof(poll_timeout));
+
+	// read the request head, ignoring any body
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+		+ std::chrono::seconds(http_timeout);
+	std::string request;
+	char buf[1024];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < max_request_size) {
+		ssize_t n = ::recv(connection, buf, sizeof(buf), 0);
+		if (n < 0 && (EINTR == errno || EAGAIN == errno || EWOULDBLOCK == errno)) {
+			if (!d_running.load(std::memory_order_relaxed)) {
+				return;
+			}
+			if (std::chrono::steady_clock::now() >= deadline) {
+				break;
+			}
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		request.append(buf, n);
+	}
+
+	size_t method_end = request.find(' ');
+	size_t path_end = request.find(' ', method_end + 1);
+	if (std::string::npos == method_end || std::string::npos == path_end) {
+		respond(connection, "400 Bad Request", "bad request\n");
+		return;
+	}
+	std::string method = request.substr(0, method_end);
+	std::string path = request.substr(method_end + 1, path_end - method_end - 1);
+	path = path.substr(0, path.find('?'));
+	if (method != "GET" && method != "HEAD") {
+		respond(connection, "405 Method Not Allowed", "method not allowed\n");
+	} else if (path != "/metrics" && path != "/") {
+		respond(connection, "404 Not Found", "not found\n");
+	} else {
+		respond(connection, "200 OK", *d_registry.published(), "HEAD" == method);
+	}
+}
+
+void
+metrics_exporter::rep_loop() {
+	while (d_running.load(std::memory_order_relaxed)) {
+		void* request = nullptr;
+		try {
+			d_reply->recv_raw(&request, NN_MSG, 0);
+		} catch (const internal_exception& e) {
+			if (ETERM == e.error() || EBADF == e.error()) {
+				break;
+			}
+			continue;
+		}
+		nn_freemsg(request);
+		std::shared_ptr<const std::string> text = d_registry.published();
+		try {
+			d_reply->send_raw(text->data(), text->size(), 0);
+		} catch (const internal_exception& e) {
+			if (ETERM == e.error() || EBADF == e.error()) {
+				break;
+			}
+		}
+	}
+}
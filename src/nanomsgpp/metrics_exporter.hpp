@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_METRICS_EXPORTER_HPP_INCLUDED
+#define NANOMSGPP_METRICS_EXPORTER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_METRICS_REGISTRY_HPP_INCLUDED
+#	include "metrics_registry.hpp"
+#endif
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace nanomsgpp {
+
+	// A metrics exporter serves the text published by a metrics registry to Prometheus. A
+	// collector thread refreshes the registry on a fixed interval, and the text is served over
+	// a small built-in HTTP responder, a nanomsg reply socket, or both. Requests are answered
+	// from the last published text, so a scrape costs the data path nothing and many scrapers
+	// cost no more than one.
+	class metrics_exporter {
+		metrics_registry&       d_registry;
+		int                     d_interval;
+		int                     d_poll_interval;
+		int                     d_listener;
+		uint16_t                d_http_port;
+		std::unique_ptr<socket> d_reply;
+		std::thread             d_collector;
+		std::thread             d_http;
+		std::thread             d_rep;
+		std::atomic<bool>       d_running;
+		std::mutex              d_lock;
+		std::condition_variable d_cond;
+
+	public:
+		// Construct an exporter for the given registry.
+		explicit metrics_exporter(metrics_registry& registry);
+
+		// Destructor, stops the exporter.
+		~metrics_exporter();
+
+		// MANIPULATORS
+
+		// Set how often, in milliseconds, the registry is collected.
+		void set_interval(int ms) { d_interval = ms; }
+
+		// Set how often, in milliseconds, the serving threads check whether they have been
+		// stopped.
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// Serve GET /metrics over HTTP on the given port of the given local address. Port 0
+		// picks a free port, which http_port() returns. Must be called before start().
+		void serve_http(uint16_t port, const std::string& host = "127.0.0.1");
+
+		// Serve the text to any request on a reply socket bound to the given address. Must be
+		// called before start().
+		void serve_rep(const std::string& addr);
+
+		// Get the port the HTTP responder listens on.
+		uint16_t http_port() const { return d_http_port; }
+
+		// Collect the registry once and start the threads.
+		void start();
+
+		// Stop the threads.
+		void stop();
+
+		// Check whether the exporter is running.
+		bool running() const { return d_running.load(); }
+
+	private:
+		// The loop collecting the registry.
+		void collect_loop();
+
+		// The loop answering HTTP requests.
+		void http_loop();
+
+		// The loop answering requests on the reply socket.
+		void rep_loop();
+
+		// Answer one HTTP connection.
+		void answer(int connection);
+
+		// NOT IMPLEMENTED
+		metrics_exporter() = delete;
+		metrics_exporter(const metrics_exporter& other) = delete;
+		metrics_exporter& operator=(const metrics_exporter& other) = delete;
+	};
+
+}
+
+#endif
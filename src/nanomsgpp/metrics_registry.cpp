@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/metrics_registry.hpp"
+
+#include <cstdio>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// The quantiles reported by a summary.
+	const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+	// Format a sample value, which Prometheus reads as a float.
+	std::string format(double value) {
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%.9g", value);
+		return buf;
+	}
+
+	// Append a sample line to the samples of a family.
+	void append(std::string& samples, const std::string& name, const std::string& labels,
+		const std::string& value) {
+		samples += name;
+		if (!labels.empty()) {
+			samples += '{';
+			samples += labels;
+			samples += '}';
+		}
+		samples += ' ';
+		samples += value;
+		samples += '\n';
+	}
+
+	// Join two label lists.
+	std::string join(const std::string& a, const std::string& b) {
+		return (a.empty() || b.empty()) ? a + b : a + "," + b;
+	}
+
+	const double ns = 1e-9;
+
+}
+
+void
+metrics_registry::writer::counter(const std::string& name, const std::string& help,
+	const std::string& labels, uint64_t value) {
+	append(get_family(name, help, "counter").d_samples, name, labels, std::to_string(value));
+}
+
+void
+metrics_registry::writer::counter(const std::string& name, const std::string& help,
+	const std::string& labels, double value) {
+	append(get_family(name, help, "counter").d_samples, name, labels, format(value));
+}
+
+void
+metrics_registry::writer::gauge(const std::string& name, const std::string& help,
+	const std::string& labels, double value) {
+	append(get_family(name, help, "gauge").d_samples, name, labels, format(value));
+}
+
+void
+metrics_registry::writer::summary(const std::string& name, const std::string& help,
+	const std::string& labels, const histogram::snapshot& s, double scale) {
+	std::string& samples = get_family(name, help, "summary").d_samples;
+	for (double q : quantiles) {
+		append(samples, name, join(labels, label("quantile", format(q))),
+			format(s.percentile(q * 100) * scale));
+	}
+	append(samples, name + "_sum", labels, format(s.sum() * scale));
+	append(samples, name + "_count", labels, std::to_string(s.count()));
+}
+
+std::string
+metrics_registry::writer::str() const {
+	std::string text;
+	for (auto& f : d_families) {
+		text += "# HELP " + f.first + " " + f.second.d_help + "\n";
+		text += "# TYPE " + f.first + " " + f.second.d_type + "\n";
+		text += f.second.d_samples;
+	}
+	return text;
+}
+
+std::string
+metrics_registry::writer::label(const std::string& key, const std::string& value) {
+	std::string text = key + "=\"";
+	for (char c : value) {
+		if ('\\' == c || '"' == c) {
+			text += '\\';
+			text += c;
+		} else if ('\n' == c) {
+			text += "\\n";
+		} else {
+			text += c;
+		}
+	}
+	text += '"';
+	return text;
+}
+
+metrics_registry::writer::family&
+metrics_registry::writer::get_family(const std::string& name, const std::string& help,
+	const char* type) {
+	family& f = d_families[name];
+	if (f.d_type.empty()) {
+		f.d_help = help;
+		f.d_type = type;
+	}
+	return f;
+}
+
+metrics_registry::metrics_registry()
+	: d_published(std::make_shared<const std::string>())
+{}
+
+void
+metrics_registry::add(const std::string& name, collector c) {
+	std::lock_guard<std::mutex> lock(d_lock);
+	for (auto& entry : d_collectors) {
+		if (entry.first == name) {
+			entry.second = std::move(c);
+			return;
+		}
+	}
+	d_collectors.emplace_back(name, std::move(c));
+}
+
+void
+metrics_registry::add_socket(const std::string& name, socket& s) {
+	std::string labels = writer::label("socket", name);
+	add(name, [&s, labels](writer& w) {
+		socket::statistics st = s.stats();
+		w.counter("nanomsgpp_socket_connections_established_total",
+			"Connections established.", labels, st.established_connections);
+		w.counter("nanomsgpp_socket_connections_accepted_total",
+			"Connections accepted.", labels, st.accepted_connections);
+		w.counter("nanomsgpp_socket_connections_dropped_total",
+			"Connections dropped.", labels, st.dropped_connections);
+		w.counter("nanomsgpp_socket_connections_broken_total",
+			"Connections broken.", labels, st.broken_connections);
+		w.gauge("nanomsgpp_socket_connections",
+			"Connections currently open.", labels, st.current_connections);
+		w.counter("nanomsgpp_socket_messages_sent_total",
+			"Messages sent.", labels, st.messages_sent);
+		w.counter("nanomsgpp_socket_messages_received_total",
+			"Messages received.", labels, st.messages_received);
+		w.counter("nanomsgpp_socket_bytes_sent_total",
+			"Bytes sent.", labels, st.bytes_sent);
+		w.counter("nanomsgpp_socket_bytes_received_total",
+			"Bytes received.", labels, st.bytes_received);
+		w.counter("nanomsgpp_socket_would_block_total",
+			"Sends and receives failing with EAGAIN.", labels, st.would_block);
+		w.counter("nanomsgpp_socket_errors_total",
+			"Exceptions thrown by the socket.", labels, st.errors);
+		w.counter("nanomsgpp_socket_bytes_copied_total",
+			"Bytes copied to or from user buffers.", labels, st.bytes_copied);
+		w.counter("nanomsgpp_socket_bytes_zero_copy_total",
+			"Bytes handed over in nanomsg chunks.", labels, st.bytes_zero_copy);
+		if (socket::histograms_enabled()) {
+			socket::histograms h = s.get_histograms();
+			w.summary("nanomsgpp_socket_send_seconds",
+				"Time taken by sends.", labels, h.send_ns, ns);
+			w.summary("nanomsgpp_socket_receive_seconds",
+				"Time taken by receives.", labels, h.recv_ns, ns);
+			w.summary("nanomsgpp_socket_send_message_bytes",
+				"Sizes of the messages sent.", labels, h.send_bytes);
+			w.summary("nanomsgpp_socket_receive_message_bytes",
+				"Sizes of the messages received.", labels, h.recv_bytes);
+			w.summary("nanomsgpp_socket_round_trip_seconds",
+				"Time from a request to its reply.", labels, h.round_trip_ns, ns);
+		}
+	});
+}
+
+void
+metrics_registry::add_pool(const std::string& name, socket_pool& p) {
+	std::string labels = writer::label("pool", name);
+	add(name, [&p, labels](writer& w) {
+		socket_pool::metrics m = p.get_metrics();
+		w.counter("nanomsgpp_pool_checkouts_total",
+			"Sockets checked out.", labels, m.checkouts);
+		w.counter("nanomsgpp_pool_waits_total",
+			"Checkouts which waited for a free socket.", labels, m.waits);
+		w.counter("nanomsgpp_pool_timeouts_total",
+			"Checkouts which timed out.", labels, m.timeouts);
+		w.counter("nanomsgpp_pool_wait_seconds_total",
+			"Time spent waiting for a free socket.", labels, m.wait_ns * ns);
+		w.gauge("nanomsgpp_pool_max_wait_seconds",
+			"Longest time spent waiting for a free socket.", labels, m.max_wait_ns * ns);
+		w.counter("nanomsgpp_pool_sockets_created_total",
+			"Sockets created.", labels, m.created);
+		w.counter("nanomsgpp_pool_sockets_evicted_total",
+			"Sockets closed after a failure.", labels, m.evicted);
+		w.gauge("nanomsgpp_pool_sockets",
+			"Sockets owned by the pool.", labels, m.size);
+		w.gauge("nanomsgpp_pool_idle_sockets",
+			"Sockets waiting to be checked out.", labels, m.idle);
+	});
+}
+
+void
+metrics_registry::add_histogram(const std::string& name, const std::string& help,
+	histogram& h, double scale) {
+	add(name, [name, help, &h, scale](writer& w) {
+		w.summary(name, help, std::string(), h.get_snapshot(), scale);
+	});
+}
+
+void
+metrics_registry::add_hop_latency(const std::string& name, hop_latency& h) {
+	std::string labels = writer::label("recorder", name);
+	add(name, [&h, labels](writer& w) {
+		hop_latency::snapshot s = h.get_snapshot();
+		w.summary("nanomsgpp_hop_end_to_end_seconds",
+			"Time from the first stamp to the receiver.", labels, s.end_to_end_ns, ns);
+		for (auto& hop : s.hops) {
+			w.summary("nanomsgpp_hop_latency_seconds", "Time taken by each hop.",
+				join(labels, writer::label("hop", std::to_string(hop.id))), hop.latency_ns, ns);
+		}
+	});
+}
+
+void
+metrics_registry::remove(const std::string& name) {
+	std::lock_guard<std::mutex> lock(d_lock);
+	for (auto it = d_collectors.begin(); it != d_collectors.end(); ++it) {
+		if (it->first == name) {
+			d_collectors.erase(it);
+			return;
+		}
+	}
+}
+
+void
+metrics_registry::collect() {
+	writer w;
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		for (auto& entry : d_collectors) {
+			entry.second(w);
+		}
+	}
+	std::atomic_store(&d_published, std::make_shared<const std::string>(w.str()));
+}
+
+std::shared_ptr<const std::string>
+metrics_registry::published() const {
+	return std::atomic_load(&d_published);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_METRICS_REGISTRY_HPP_INCLUDED
+#define NANOMSGPP_METRICS_REGISTRY_HPP_INCLUDED
+
+#ifndef NANOMSGPP_HISTOGRAM_HPP_INCLUDED
+#	include "histogram.hpp"
+#endif
+#ifndef NANOMSGPP_HOP_LATENCY_HPP_INCLUDED
+#	include "hop_latency.hpp"
+#endif
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+#ifndef NANOMSGPP_SOCKET_POOL_HPP_INCLUDED
+#	include "socket_pool.hpp"
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A metrics registry gathers the statistics of sockets, socket pools and histograms into
+	// the Prometheus text format. Collecting reads every source and publishes the text as an
+	// immutable snapshot; readers such as a metrics_exporter only ever take the published
+	// snapshot, so scrapes never touch the sources and cost the data path nothing however
+	// often they come. Sources are labelled with the name they were added under, and must
+	// outlive the registry or be removed first.
+	class metrics_registry {
+	public:
+		// A writer formats samples, grouping them into metric families.
+		class writer {
+			struct family {
+				std::string d_help;
+				std::string d_type;
+				std::string d_samples;
+			};
+
+			std::map<std::string, family> d_families;
+
+		public:
+			// MANIPULATORS
+
+			// Add a sample of a counter.
+			void counter(const std::string& name, const std::string& help,
+				const std::string& labels, uint64_t value);
+
+			// Add a sample of a counter.
+			void counter(const std::string& name, const std::string& help,
+				const std::string& labels, double value);
+
+			// Add a sample of a gauge.
+			void gauge(const std::string& name, const std::string& help,
+				const std::string& labels, double value);
+
+			// Add a summary of a histogram, with its values multiplied by scale, such as 1e-9
+			// to report nanoseconds in seconds.
+			void summary(const std::string& name, const std::string& help,
+				const std::string& labels, const histogram::snapshot& s, double scale = 1.0);
+
+			// Get the text of the samples added.
+			std::string str() const;
+
+			// Format a label, escaping its value.
+			static std::string label(const std::string& key, const std::string& value);
+
+		private:
+			// Get the family of the given name, setting its help and type.
+			family& get_family(const std::string& name, const std::string& help,
+				const char* type);
+		};
+
+		// A collector adds the samples of a source to a writer.
+		typedef std::function<void(writer& w)> collector;
+
+	private:
+		std::mutex                                      d_lock;
+		std::vector<std::pair<std::string, collector>>  d_collectors;
+		std::shared_ptr<const std::string>              d_published;
+
+	public:
+		// Construct an empty registry.
+		metrics_registry();
+
+		// MANIPULATORS
+
+		// Add a collector under the given name, replacing any source of that name.
+		void add(const std::string& name, collector c);
+
+		// Add the statistics of a socket, and its histograms if they are compiled in.
+		void add_socket(const std::string& name, socket& s);
+
+		// Add the counters of a socket pool.
+		void add_pool(const std::string& name, socket_pool& p);
+
+		// Add a histogram as a summary, with its values multiplied by scale.
+		void add_histogram(const std::string& name, const std::string& help, histogram& h,
+			double scale = 1.0);
+
+		// Add the histograms of a hop latency recorder.
+		void add_hop_latency(const std::string& name, hop_latency& h);
+
+		// Remove the source of the given name.
+		void remove(const std::string& name);
+
+		// Read every source and publish the text.
+		void collect();
+
+		// Get the text last published, which is empty until the first collection.
+		std::shared_ptr<const std::string> published() const;
+
+	private:
+		// NOT IMPLEMENTED
+		metrics_registry(const metrics_registry& other) = delete;
+		metrics_registry& operator=(const metrics_registry& other) = delete;
+	};
+
+}
+
+#endif
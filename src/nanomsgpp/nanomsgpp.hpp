@@ -23,12 +23,35 @@
 #ifndef NANOMSGPP_HPP_INCLUDED
 #define NANOMSGPP_HPP_INCLUDED
 
+#include "nanomsgpp/bridge.hpp"
+#include "nanomsgpp/channel.hpp"
+#include "nanomsgpp/compressor.hpp"
+#include "nanomsgpp/conflating_publisher.hpp"
 #include "nanomsgpp/device.hpp"
+#include "nanomsgpp/endpoint.hpp"
 #include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/histogram.hpp"
+#include "nanomsgpp/hop_latency.hpp"
+#include "nanomsgpp/key_router.hpp"
+#include "nanomsgpp/lz_codec.hpp"
 #include "nanomsgpp/message.hpp"
+#include "nanomsgpp/message_view.hpp"
+#include "nanomsgpp/metrics_exporter.hpp"
+#include "nanomsgpp/metrics_registry.hpp"
+#include "nanomsgpp/ordered_stage.hpp"
 #include "nanomsgpp/poller.hpp"
+#include "nanomsgpp/prefix_matcher.hpp"
+#include "nanomsgpp/rpc_client.hpp"
+#include "nanomsgpp/server.hpp"
+#include "nanomsgpp/shared_payload.hpp"
+#include "nanomsgpp/sharded_publisher.hpp"
+#include "nanomsgpp/shm_ring.hpp"
 #include "nanomsgpp/socket.hpp"
 #include "nanomsgpp/socket_option.hpp"
+#include "nanomsgpp/socket_pool.hpp"
 #include "nanomsgpp/socket_type.hpp"
+#include "nanomsgpp/subscription_router.hpp"
+#include "nanomsgpp/survey.hpp"
+#include "nanomsgpp/worker_pool.hpp"
 
 #endif
@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/ordered_stage.hpp"
+#include <nanomsg/nn.h>
+#include <cstring>
+#include <functional>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// The size of the sequence number carried at the end of each body.
+	const size_t trailer_size = sizeof(uint64_t);
+
+	// Set in the sequence number of a message dropped by the processor, which the sink only
+	// uses to advance past it.
+	const uint64_t skip_bit = uint64_t(1) << 63;
+
+	// Used to give each stage its own inproc endpoints.
+	std::atomic<unsigned> next_stage_id(0);
+
+	// Errors which mean a socket can no longer be used.
+	bool is_fatal(int error) {
+		return error == ETERM || error == EBADF;
+	}
+
+	void put_trailer(void* chunk, size_t offset, uint64_t seq) {
+		std::memcpy(static_cast<char*>(chunk) + offset, &seq, trailer_size);
+	}
+
+	uint64_t get_trailer(const void* chunk, size_t offset) {
+		uint64_t seq;
+		std::memcpy(&seq, static_cast<const char*>(chunk) + offset, trailer_size);
+		return seq;
+	}
+
+	// Turn a dropped message, whose body chunk holds chunk_size bytes, into a message which only
+	// tells the sink to skip the sequence number. The trailer is written over the end of the body
+	// chunk when no new chunk can be allocated, since the sink frees skipped messages unread.
+	// Returns null, having freed the body, if neither chunk can hold the trailer.
+	void* make_skip(void* body, size_t chunk_size, uint64_t seq) {
+		void* skip = nn_allocmsg(trailer_size, 0);
+		if (nullptr != skip) {
+			nn_freemsg(body);
+		} else if (chunk_size >= trailer_size) {
+			skip = body;
+		} else {
+			skip = nn_reallocmsg(body, trailer_size);
+			if (nullptr == skip) {
+				nn_freemsg(body);
+				return nullptr;
+			}
+			chunk_size = trailer_size;
+		}
+		put_trailer(skip, (skip == body) ? chunk_size - trailer_size : 0, seq | skip_bit);
+		return skip;
+	}
+
+	void update_max(std::atomic<size_t>& max, size_t value) {
+		if (value > max.load(std::memory_order_relaxed)) {
+			max.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	// Receive a message without waiting, polling the socket if none is ready. Returns the size
+	// of the message, -1 if there was none, or -2 if the socket can no longer be used.
+	int receive(int fd, void** chunk, int poll_interval) {
+		int nb = nn_recv(fd, chunk, NN_MSG, NN_DONTWAIT);
+		if (nb >= 0) {
+			return nb;
+		}
+		if (is_fatal(nn_errno())) {
+			return -2;
+		}
+		struct nn_pollfd pfd = { fd, NN_POLLIN, 0 };
+		if (-1 == nn_poll(&pfd, 1, poll_interval) && is_fatal(nn_errno())) {
+			return -2;
+		}
+		return -1;
+	}
+
+}
+
+ordered_stage::ordered_stage(socket& input, socket& output, size_t n_workers, processor p)
+	: d_input(input)
+	, d_output(output)
+	, d_processor(std::move(p))
+	, d_work(socket_domain::sp, socket_type::push)
+	, d_sink(socket_domain::sp, socket_type::pull)
+	, d_window(1024)
+	, d_poll_interval(100)
+	, d_drain_timeout(1000)
+	, d_running(false)
+	, d_done(false)
+	, d_delivered(0)
+	, d_stamped(0)
+	, d_received(0)
+	, d_sent(0)
+	, d_filtered(0)
+	, d_dropped(0)
+	, d_reordered(0)
+	, d_stalls(0)
+	, d_buffered(0)
+	, d_max_buffered(0)
+	, d_buffered_bytes(0)
+	, d_max_buffered_bytes(0)
+	, d_total_wait_ns(0)
+	, d_max_wait_ns(0)
+{
+	std::string prefix = "inproc://nanomsgpp.ordered_stage." + std::to_string(next_stage_id++);
+	d_work.bind(prefix + ".work");
+	d_sink.bind(prefix + ".sink");
+	if (0 == n_workers) {
+		n_workers = 1;
+	}
+	for (size_t i = 0; i < n_workers; ++i) {
+		worker* w = new worker();
+		d_workers.emplace_back(w);
+		w->d_pull.connect(prefix + ".work");
+		w->d_push.connect(prefix + ".sink");
+	}
+}
+
+ordered_stage::~ordered_stage() {
+	stop();
+}
+
+void
+ordered_stage::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	d_done.store(false);
+	d_delivered = 0;
+	d_stamped.store(0);
+	slot empty = { nullptr, 0, false, false, clock::time_point() };
+	d_buffer.assign(d_window, empty);
+
+	for (auto& w : d_workers) {
+		w->d_thread = std::thread(&ordered_stage::process, this, std::ref(*w));
+	}
+	d_collector = std::thread(&ordered_stage::collect, this);
+	d_distributor = std::thread(&ordered_stage::distribute, this);
+}
+
+void
+ordered_stage::stop() {
+	if (!d_running.exchange(false)) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		d_cond.notify_all();
+	}
+	d_distributor.join();
+
+	// the input is no longer read, so wait for the messages already stamped to be sent
+	{
+		std::unique_lock<std::mutex> lock(d_lock);
+		d_cond.wait_for(lock, std::chrono::milliseconds(d_drain_timeout),
+			[this]() { return d_delivered == d_stamped.load(); });
+	}
+	d_done.store(true);
+	d_collector.join();
+	for (auto& w : d_workers) {
+		w->d_thread.join();
+	}
+	clear_buffer();
+}
+
+ordered_stage::statistics
+ordered_stage::get_statistics() const {
+	statistics s;
+	s.received           = d_received.load(std::memory_order_relaxed);
+	s.sent               = d_sent.load(std::memory_order_relaxed);
+	s.filtered           = d_filtered.load(std::memory_order_relaxed);
+	s.dropped            = d_dropped.load(std::memory_order_relaxed);
+	s.reordered          = d_reordered.load(std::memory_order_relaxed);
+	s.stalls             = d_stalls.load(std::memory_order_relaxed);
+	s.buffered           = d_buffered.load(std::memory_order_relaxed);
+	s.max_buffered       = d_max_buffered.load(std::memory_order_relaxed);
+	s.buffered_bytes     = d_buffered_bytes.load(std::memory_order_relaxed);
+	s.max_buffered_bytes = d_max_buffered_bytes.load(std::memory_order_relaxed);
+	s.total_wait_ns      = d_total_wait_ns.load(std::memory_order_relaxed);
+	s.max_wait_ns        = d_max_wait_ns.load(std::memory_order_relaxed);
+	return s;
+}
+
+void
+ordered_stage::distribute() {
+	int from = d_input.get_fd();
+	int to = d_work.get_fd();
+	uint64_t seq = 0;
+	while (d_running.load(std::memory_order_relaxed)) {
+		{
+			std::unique_lock<std::mutex> lock(d_lock);
+			if (seq - d_delivered >= d_window) {
+				d_stalls.fetch_add(1, std::memory_order_relaxed);
+				d_cond.wait(lock, [this, seq]() {
+					return seq - d_delivered < d_window || !d_running.load();
+				});
+				continue;
+			}
+		}
+
+		void* chunk = nullptr;
+		int nb = receive(from, &chunk, d_poll_interval);
+		if (-2 == nb) {
+			break;
+		}
+		if (-1 == nb) {
+			continue;
+		}
+		d_received.fetch_add(1, std::memory_order_relaxed);
+		void* stamped = nn_reallocmsg(chunk, nb + trailer_size);
+		if (nullptr == stamped) {
+			nn_freemsg(chunk);
+			d_dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		put_trailer(stamped, nb, seq);
+
+		// the sequence number is only used once the message is with the workers, so a message
+		// which could not be pushed leaves no gap in the stream
+		if (!send(to, stamped, true)) {
+			d_dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		d_stamped.store(++seq);
+	}
+}
+
+void
+ordered_stage::process(worker& w) {
+	int from = w.d_pull.get_fd();
+	int to = w.d_push.get_fd();
+	while (!d_done.load(std::memory_order_relaxed)) {
+		void* chunk = nullptr;
+		int nb = receive(from, &chunk, d_poll_interval);
+		if (-2 == nb) {
+			break;
+		}
+		if (-1 == nb) {
+			continue;
+		}
+		size_t size = nb - trailer_size;
+		uint64_t seq = get_trailer(chunk, size);
+
+		void* body = chunk;
+		message_view view(&body, size, nullptr, 0);
+		bool keep;
+		try {
+			keep = d_processor(view);
+		} catch (...) {
+			keep = false;
+		}
+
+		// the body chunk still ends with the trailer unless the processor replaced or resized it
+		bool stamped = (body == chunk && view.size() == size);
+		if (keep && !stamped) {
+			void* grown = nn_reallocmsg(body, view.size() + trailer_size);
+			if (nullptr != grown) {
+				body = grown;
+				put_trailer(body, view.size(), seq);
+			} else {
+				keep = false;
+				d_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		} else if (!keep) {
+			d_filtered.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (!keep) {
+			// the sink still needs the sequence number to move past the message
+			body = make_skip(body, stamped ? nb : view.size(), seq);
+			if (nullptr == body) {
+				continue;
+			}
+		}
+		send(to, body, false);
+	}
+}
+
+void
+ordered_stage::collect() {
+	int from = d_sink.get_fd();
+	size_t n_slots = d_buffer.size();
+	uint64_t next = 0;
+	while (!d_done.load(std::memory_order_relaxed)) {
+		void* chunk = nullptr;
+		int nb = receive(from, &chunk, d_poll_interval);
+		if (-2 == nb) {
+			break;
+		}
+		if (-1 == nb) {
+			continue;
+		}
+		size_t size = nb - trailer_size;
+		uint64_t seq = get_trailer(chunk, size);
+		bool skip = 0 != (seq & skip_bit);
+		seq &= ~skip_bit;
+
+		if (seq != next) {
+			// the window keeps every message in flight within n_slots of the next one
+			slot& s = d_buffer[seq % n_slots];
+			s.d_chunk = chunk;
+			s.d_size = size;
+			s.d_filled = true;
+			s.d_skip = skip;
+			s.d_arrived = clock::now();
+			d_reordered.fetch_add(1, std::memory_order_relaxed);
+			update_max(d_max_buffered, d_buffered.fetch_add(1, std::memory_order_relaxed) + 1);
+			update_max(d_max_buffered_bytes,
+				d_buffered_bytes.fetch_add(size, std::memory_order_relaxed) + size);
+			continue;
+		}
+
+		deliver(chunk, size, skip);
+		++next;
+		if (d_buffered.load(std::memory_order_relaxed) > 0) {
+			clock::time_point now = clock::now();
+			for (slot* s = &d_buffer[next % n_slots]; s->d_filled; s = &d_buffer[next % n_slots]) {
+				uint64_t wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					now - s->d_arrived).count();
+				d_total_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+				if (wait > d_max_wait_ns.load(std::memory_order_relaxed)) {
+					d_max_wait_ns.store(wait, std::memory_order_relaxed);
+				}
+				d_buffered.fetch_sub(1, std::memory_order_relaxed);
+				d_buffered_bytes.fetch_sub(s->d_size, std::memory_order_relaxed);
+				s->d_filled = false;
+				deliver(s->d_chunk, s->d_size, s->d_skip);
+				++next;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(d_lock);
+		d_delivered = next;
+		d_cond.notify_all();
+	}
+}
+
+void
+ordered_stage::deliver(void* chunk, size_t size, bool skip) {
+	if (skip) {
+		nn_freemsg(chunk);
+		return;
+	}
+	// shrinking a chunk to drop the trailer is usually done in place
+	void* body = nn_reallocmsg(chunk, size);
+	if (nullptr == body) {
+		nn_freemsg(chunk);
+		d_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	chunk = body;
+	if (send(d_output.get_fd(), chunk, false)) {
+		d_sent.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		d_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+bool
+ordered_stage::send(int fd, void* chunk, bool until_stopped) {
+	while (true) {
+		if (nn_send(fd, &chunk, NN_MSG, NN_DONTWAIT) >= 0) {
+			return (true);
+		}
+		int error = nn_errno();
+		if (error != EAGAIN || d_done.load(std::memory_order_relaxed)
+				|| (until_stopped && !d_running.load(std::memory_order_relaxed))) {
+			break;
+		}
+		struct nn_pollfd pfd = { fd, NN_POLLOUT, 0 };
+		if (-1 == nn_poll(&pfd, 1, d_poll_interval) && is_fatal(nn_errno())) {
+			break;
+		}
+	}
+	// the message was not sent, so it is still owned by the stage
+	nn_freemsg(chunk);
+	return (false);
+}
+
+void
+ordered_stage::clear_buffer() {
+	for (auto& s : d_buffer) {
+		if (s.d_filled) {
+			nn_freemsg(s.d_chunk);
+			s.d_filled = false;
+		}
+	}
+	d_buffered.store(0);
+	d_buffered_bytes.store(0);
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_ORDERED_STAGE_HPP_INCLUDED
+#define NANOMSGPP_ORDERED_STAGE_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#	include "message_view.hpp"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// An ordered stage runs a pipeline step on several threads without reordering the stream.
+	// Messages received from the input socket are stamped with a sequence number and pushed
+	// over inproc PUSH/PULL sockets to the worker threads, whose results are pulled by a sink
+	// thread. The sink holds results which arrive early in a bounded reorder buffer and sends
+	// them on the output socket in the order they were received.
+	//
+	// The reorder buffer holds at most window messages: the input is not read while the oldest
+	// message in flight is window messages behind, so one slow message bounds the memory used
+	// rather than letting the buffer grow. The sequence number travels as an 8 byte trailer
+	// of the body, appended with nn_reallocmsg, which moves the body when its chunk cannot
+	// grow in place. A processor which replaces or resizes the body costs another reallocation.
+	class ordered_stage {
+	public:
+		// A snapshot of the counters of the stage.
+		struct statistics {
+			uint64_t received;            // number of messages read from the input
+			uint64_t sent;                // number of messages sent on the output
+			uint64_t filtered;            // number of messages dropped by the processor
+			uint64_t dropped;             // number of messages the output did not accept
+			uint64_t reordered;           // number of messages held in the reorder buffer
+			uint64_t stalls;              // number of times the input waited for the window
+			size_t   buffered;            // number of messages in the reorder buffer now
+			size_t   max_buffered;        // most messages held in the reorder buffer
+			size_t   buffered_bytes;      // number of body bytes in the reorder buffer now
+			size_t   max_buffered_bytes;  // most body bytes held in the reorder buffer
+			uint64_t total_wait_ns;       // time spent by messages in the reorder buffer
+			uint64_t max_wait_ns;         // longest time a message spent in the buffer
+		};
+
+		// A processor is run on each message by a worker thread, and returns false to drop the
+		// message. The body may be rewritten in place or replaced. A processor which throws
+		// drops the message.
+		typedef std::function<bool(message_view& msg)> processor;
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		// A message which arrived at the sink before its predecessors.
+		struct slot {
+			void*             d_chunk;
+			size_t            d_size;
+			bool              d_filled;
+			bool              d_skip;
+			clock::time_point d_arrived;
+		};
+
+		struct worker {
+			socket      d_pull;
+			socket      d_push;
+			std::thread d_thread;
+
+			worker()
+				: d_pull(socket_domain::sp, socket_type::pull)
+				, d_push(socket_domain::sp, socket_type::push) {}
+		};
+
+		socket&                              d_input;
+		socket&                              d_output;
+		processor                            d_processor;
+		socket                               d_work;
+		socket                               d_sink;
+		std::vector<std::unique_ptr<worker>> d_workers;
+		std::vector<slot>                    d_buffer;
+		size_t                               d_window;
+		int                                  d_poll_interval;
+		int                                  d_drain_timeout;
+		std::thread                          d_distributor;
+		std::thread                          d_collector;
+		std::atomic<bool>                    d_running;
+		std::atomic<bool>                    d_done;
+		std::mutex                           d_lock;
+		std::condition_variable              d_cond;
+		uint64_t                             d_delivered;  // guarded by d_lock
+		std::atomic<uint64_t>                d_stamped;
+		std::atomic<uint64_t>                d_received;
+		std::atomic<uint64_t>                d_sent;
+		std::atomic<uint64_t>                d_filtered;
+		std::atomic<uint64_t>                d_dropped;
+		std::atomic<uint64_t>                d_reordered;
+		std::atomic<uint64_t>                d_stalls;
+		std::atomic<size_t>                  d_buffered;
+		std::atomic<size_t>                  d_max_buffered;
+		std::atomic<size_t>                  d_buffered_bytes;
+		std::atomic<size_t>                  d_max_buffered_bytes;
+		std::atomic<uint64_t>                d_total_wait_ns;
+		std::atomic<uint64_t>                d_max_wait_ns;
+
+	public:
+		// Construct a stage reading from input and writing to output, running the processor on
+		// n_workers threads.
+		ordered_stage(socket& input, socket& output, size_t n_workers, processor p);
+
+		// Destructor, stops the stage.
+		~ordered_stage();
+
+		// MANIPULATORS
+
+		// Set the number of messages the reorder buffer holds, which must be done before the
+		// stage is started.
+		void set_window(size_t n) { d_window = (0 == n) ? 1 : n; }
+
+		// Set how often, in milliseconds, the threads check whether the stage has been stopped.
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// Set how long, in milliseconds, stop() waits for the messages in flight to be sent.
+		void set_drain_timeout(int ms) { d_drain_timeout = ms; }
+
+		// Get the number of worker threads.
+		size_t size() const { return d_workers.size(); }
+
+		// Start the threads.
+		void start();
+
+		// Stop reading the input, send the messages in flight in order and join the threads.
+		void stop();
+
+		// Check whether the stage is running.
+		bool running() const { return d_running.load(); }
+
+		// Get a snapshot of the counters.
+		statistics get_statistics() const;
+
+	private:
+		// The loop stamping messages from the input and pushing them to the workers.
+		void distribute();
+
+		// The loop run by each worker thread.
+		void process(worker& w);
+
+		// The loop putting the results back in order and sending them on the output.
+		void collect();
+
+		// Send a result on the output, or free it if it is a dropped message.
+		void deliver(void* chunk, size_t size, bool skip);
+
+		// Send a chunk, retrying until it is sent or the stage is done, or if until_stopped is
+		// set, until the stage is stopped. A chunk which is not sent is freed.
+		bool send(int fd, void* chunk, bool until_stopped);
+
+		// Free the messages left in the reorder buffer.
+		void clear_buffer();
+
+		// NOT IMPLEMENTED
+		ordered_stage(const ordered_stage& other) = delete;
+		ordered_stage& operator=(const ordered_stage& other) = delete;
+	};
+
+}
+
+#endif
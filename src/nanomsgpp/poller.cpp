@@ -22,11 +22,64 @@
 
 #include "nanomsgpp/poller.hpp"
 #include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/trace.hpp"
 #include <nanomsg/nn.h>
+#include <algorithm>
+#include <string>
 
 using namespace nanomsgpp;
 
-poller::poller() {}
+namespace {
+
+	// Used to give each poller its own inproc endpoint for waking it.
+	std::atomic<unsigned> next_poller_id(0);
+
+	// Poll the sockets, firing the poll tracepoint.
+	int traced_poll(nn_pollfd* fds, size_t n, int timeout) {
+		if (!NANOMSGPP_TRACE_ENABLED(poll)) {
+			return nn_poll(fds, static_cast<int>(n), timeout);
+		}
+		int64_t start = trace_now();
+		int rc = nn_poll(fds, static_cast<int>(n), timeout);
+		NANOMSGPP_TRACE(poll, n, (rc < 0) ? 0 : rc, (-1 == rc) ? nn_errno() : 0, trace_now() - start);
+		return rc;
+	}
+
+}
+
+poller::poller()
+	: d_woken(false)
+{}
+
+poller::poller(const poller& other)
+	: d_pollfds(other.d_pollfds)
+	, d_woken(false)
+{
+	for (auto& w : other.d_channels) {
+		add_channel(*w.d_channel, static_cast<poll_event>(w.d_events));
+	}
+}
+
+poller::~poller() {
+	for (auto& w : d_channels) {
+		w.d_channel->detach(this);
+	}
+}
+
+poller&
+poller::operator=(const poller& other) {
+	if (this != &other) {
+		for (auto& w : d_channels) {
+			w.d_channel->detach(this);
+		}
+		d_channels.clear();
+		d_pollfds = other.d_pollfds;
+		for (auto& w : other.d_channels) {
+			add_channel(*w.d_channel, static_cast<poll_event>(w.d_events));
+		}
+	}
+	return (*this);
+}
 
 void
 poller::add_socket(socket& s, poll_event e) {
@@ -46,7 +99,10 @@ poller::remove_socket(socket& s) {
 }
 
 bool poller::poll(int timeout) {
-	int rc = nn_poll(d_pollfds.data(), d_pollfds.size(), timeout);
+	if (!d_channels.empty()) {
+		return poll_channels(timeout);
+	}
+	int rc = traced_poll(d_pollfds.data(), d_pollfds.size(), timeout);
 	if (-1 == rc) {
 		throw internal_exception();
 	} else if (rc > 0) {
@@ -64,3 +120,104 @@ poller::has_event(socket& s, poll_event e) {
 	}
 	return (false);
 }
+
+void
+poller::add_channel(channel& c, poll_event e) {
+	if (!d_wake_in) {
+		std::string addr = "inproc://nanomsgpp.poller." + std::to_string(next_poller_id++);
+		d_wake_in.reset(new socket(socket_domain::sp, socket_type::pair));
+		d_wake_out.reset(new socket(socket_domain::sp, socket_type::pair));
+		d_wake_in->bind(addr);
+		d_wake_out->connect(addr);
+	}
+	watched_channel w = { &c, (short)e, 0 };
+	d_channels.push_back(w);
+	c.attach(this);
+}
+
+void
+poller::remove_channel(channel& c) {
+	auto it = d_channels.begin();
+	for (; it != d_channels.end(); it++) {
+		if (it->d_channel == &c) {
+			break;
+		}
+	}
+	if (it != d_channels.end()) {
+		d_channels.erase(it);
+		c.detach(this);
+	}
+}
+
+bool
+poller::has_event(channel& c, poll_event e) {
+	for (auto& w : d_channels) {
+		if (w.d_channel == &c) {
+			return ((w.d_revents & (short)e) != 0);
+		}
+	}
+	return (false);
+}
+
+bool
+poller::poll_channels(int timeout) {
+	// count the poller as a waiter on each channel before checking them, so a channel which
+	// changes after the check wakes the poller
+	for (auto& w : d_channels) {
+		w.d_channel->d_waiters.fetch_add(1);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	bool ready = check_channels();
+
+	nn_pollfd wake = { d_wake_in->get_fd(), NN_POLLIN, 0 };
+	d_pollfds.push_back(wake);
+	int rc = traced_poll(d_pollfds.data(), d_pollfds.size(), ready ? 0 : timeout);
+	d_pollfds.pop_back();
+	for (auto& w : d_channels) {
+		w.d_channel->d_waiters.fetch_sub(1);
+	}
+	if (-1 == rc) {
+		throw internal_exception();
+	}
+
+	d_woken.store(false);
+	char buf[1];
+	while (nn_recv(d_wake_in->get_fd(), buf, sizeof(buf), NN_DONTWAIT) >= 0) {
+	}
+	if (!ready) {
+		ready = check_channels();
+	}
+	for (auto& pfd : d_pollfds) {
+		ready = ready || 0 != pfd.revents;
+	}
+	return ready;
+}
+
+bool
+poller::check_channels() {
+	bool ready = false;
+	for (auto& w : d_channels) {
+		w.d_revents = 0;
+		if ((w.d_events & NN_POLLIN) && w.d_channel->readable()) {
+			w.d_revents |= NN_POLLIN;
+		}
+		if ((w.d_events & NN_POLLOUT) && w.d_channel->writable()) {
+			w.d_revents |= NN_POLLOUT;
+		}
+		ready = ready || 0 != w.d_revents;
+	}
+	return ready;
+}
+
+void
+poller::wake() {
+	if (!d_woken.exchange(true)) {
+		nn_send(d_wake_out->get_fd(), "", 0, NN_DONTWAIT);
+	}
+}
+
+void
+poller::forget(channel* c) {
+	d_channels.erase(std::remove_if(d_channels.begin(), d_channels.end(),
+		[c](const watched_channel& w) { return w.d_channel == c; }), d_channels.end());
+}
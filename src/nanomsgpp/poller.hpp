@@ -26,6 +26,13 @@
 #ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
 #	include "socket.hpp"
 #endif
+#ifndef NANOMSGPP_CHANNEL_HPP_INCLUDED
+#	include "channel.hpp"
+#endif
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace nanomsgpp {
 
@@ -41,16 +48,37 @@ namespace nanomsgpp {
 	};
 
 	// The poller checks a set of SP sockets and reports whether it's possible to send a message to
-	// the socket and / or receive a message from each socket.
+	// the socket and / or receive a message from each socket. Channels may be polled along with
+	// the sockets; a channel wakes a waiting poller through an inproc socket pair owned by the
+	// poller, so a poll may return early without events when another thread took the message.
 	class poller {
-		std::vector<nn_pollfd> d_pollfds;
+		struct watched_channel {
+			channel* d_channel;
+			short    d_events;
+			short    d_revents;
+		};
+
+		std::vector<nn_pollfd>       d_pollfds;
+		std::vector<watched_channel> d_channels;
+		std::unique_ptr<socket>      d_wake_in;
+		std::unique_ptr<socket>      d_wake_out;
+		std::atomic<bool>            d_woken;
+
+		friend class channel;
 
 	public:
 		// Default constructor.
 		poller();
 
+		// Copy constructor, the copy polls the same sockets and channels with its own wake
+		// sockets.
+		poller(const poller& other);
+
 		// Destructor.
-		~poller() {};
+		~poller();
+
+		// Copy assignment operator.
+		poller& operator=(const poller& other);
 
 		// MANIPULATORS
 
@@ -65,6 +93,30 @@ namespace nanomsgpp {
 
 		// Check whether a given event exists.
 		bool has_event(socket& s, poll_event e);
+
+		// Add a channel with the given event to poll for. A channel must not be destroyed
+		// while the poller is polling it; remove it first, or destroy it only while the poller
+		// is idle.
+		void add_channel(channel& c, poll_event e);
+
+		// Remove a channel.
+		void remove_channel(channel& c);
+
+		// Check whether a given event exists for a channel.
+		bool has_event(channel& c, poll_event e);
+
+	private:
+		// Poll the sockets and the channels.
+		bool poll_channels(int timeout);
+
+		// Set the events of the channels, returning true if there are any.
+		bool check_channels();
+
+		// Wake the poller from a channel which has changed.
+		void wake();
+
+		// Drop a channel which is being destroyed.
+		void forget(channel* c);
 	};
 
 }
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/prefix_matcher.hpp"
+#include "nanomsgpp/exception.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#	define NANOMSGPP_PREFIX_MATCHER_X86 1
+#	include <immintrin.h>
+#endif
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// Tags of empty and deleted slots. Full slots have the top bit set and seven bits of the
+	// hash in the rest.
+	const unsigned char tag_empty   = 0;
+	const unsigned char tag_deleted = 1;
+
+	unsigned char tag_of(uint32_t hash) {
+		return 0x80 | (hash & 0x7f);
+	}
+
+	size_t group_of(uint32_t hash, size_t mask) {
+		return (hash >> 7) & mask;
+	}
+
+	size_t lowest_bit(uint32_t mask) {
+		return __builtin_ctz(mask);
+	}
+
+	// The keys are hashed with CRC-32C, which SSE4.2 computes in hardware. The portable code
+	// computes the same sum a byte at a time, so the table does not depend on the instruction
+	// set.
+	struct crc_table {
+		uint32_t d_entries[256];
+
+		crc_table() {
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int j = 0; j < 8; ++j) {
+					c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+				}
+				d_entries[i] = c;
+			}
+		}
+	};
+
+	uint32_t hash_scalar(const unsigned char* key) {
+		static const crc_table table;
+		uint32_t crc = 0;
+		for (size_t i = 0; i < prefix_matcher::max_width; ++i) {
+			crc = table.d_entries[(crc ^ key[i]) & 0xff] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	size_t find_scalar(const unsigned char* tags, const unsigned char* keys, size_t mask,
+			const unsigned char* key, uint32_t hash) {
+		const size_t n = prefix_matcher::group_size;
+		unsigned char tag = tag_of(hash);
+		size_t g = group_of(hash, mask);
+		for (size_t probe = 0; probe <= mask; ++probe) {
+			const unsigned char* t = tags + g * n;
+			bool empty = false;
+			for (size_t i = 0; i < n; ++i) {
+				if (t[i] == tag
+						&& 0 == std::memcmp(keys + (g * n + i) * prefix_matcher::max_width, key,
+							prefix_matcher::max_width)) {
+					return g * n + i;
+				}
+				empty |= (t[i] == tag_empty);
+			}
+			if (empty) {
+				break;
+			}
+			g = (g + 1) & mask;
+		}
+		return prefix_matcher::npos;
+	}
+
+#ifdef NANOMSGPP_PREFIX_MATCHER_X86
+
+	__attribute__((target("sse4.2")))
+	uint32_t hash_sse42(const unsigned char* key) {
+		uint64_t lo, hi;
+		std::memcpy(&lo, key, sizeof(lo));
+		std::memcpy(&hi, key + sizeof(lo), sizeof(hi));
+		return static_cast<uint32_t>(_mm_crc32_u64(_mm_crc32_u64(0, lo), hi));
+	}
+
+	__attribute__((target("sse4.2")))
+	size_t find_sse42(const unsigned char* tags, const unsigned char* keys, size_t mask,
+			const unsigned char* key, uint32_t hash) {
+		const size_t n = prefix_matcher::group_size;
+		const __m128i want  = _mm_set1_epi8(static_cast<char>(tag_of(hash)));
+		const __m128i empty = _mm_setzero_si128();
+		const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+		size_t g = group_of(hash, mask);
+		for (size_t probe = 0; probe <= mask; ++probe) {
+			const __m128i* t = reinterpret_cast<const __m128i*>(tags + g * n);
+			__m128i lo = _mm_loadu_si128(t);
+			__m128i hi = _mm_loadu_si128(t + 1);
+			uint32_t hits = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, want)))
+				| (uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, want))) << 16);
+			while (hits != 0) {
+				size_t slot = g * n + lowest_bit(hits);
+				__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>
+					(keys + slot * prefix_matcher::max_width));
+				if (0xffff == _mm_movemask_epi8(_mm_cmpeq_epi8(s, k))) {
+					return slot;
+				}
+				hits &= hits - 1;
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(lo, empty))
+					| _mm_movemask_epi8(_mm_cmpeq_epi8(hi, empty))) {
+				break;
+			}
+			g = (g + 1) & mask;
+		}
+		return prefix_matcher::npos;
+	}
+
+	__attribute__((target("avx2,sse4.2")))
+	size_t find_avx2(const unsigned char* tags, const unsigned char* keys, size_t mask,
+			const unsigned char* key, uint32_t hash) {
+		const size_t n = prefix_matcher::group_size;
+		const __m256i want  = _mm256_set1_epi8(static_cast<char>(tag_of(hash)));
+		const __m256i empty = _mm256_setzero_si256();
+		const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+		size_t g = group_of(hash, mask);
+		for (size_t probe = 0; probe <= mask; ++probe) {
+			__m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + g * n));
+			uint32_t hits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(t, want));
+			while (hits != 0) {
+				size_t slot = g * n + lowest_bit(hits);
+				__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>
+					(keys + slot * prefix_matcher::max_width));
+				if (0xffff == _mm_movemask_epi8(_mm_cmpeq_epi8(s, k))) {
+					return slot;
+				}
+				hits &= hits - 1;
+			}
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(t, empty))) {
+				break;
+			}
+			g = (g + 1) & mask;
+		}
+		return prefix_matcher::npos;
+	}
+
+#endif
+
+}
+
+const uint32_t prefix_matcher::npos;
+const size_t prefix_matcher::max_width;
+const size_t prefix_matcher::group_size;
+
+prefix_matcher::prefix_matcher(size_t width, isa i)
+	: d_width(width)
+	, d_isa(i)
+	, d_hash(hash_scalar)
+	, d_find(find_scalar)
+	, d_size(0)
+	, d_used(0)
+{
+	if (0 == width || width > max_width) {
+		throw exception("prefix width must be between 1 and 16 bytes");
+	}
+	if (!supported(i)) {
+		throw exception("instruction set not supported by this CPU");
+	}
+#ifdef NANOMSGPP_PREFIX_MATCHER_X86
+	if (isa::sse42 == i) {
+		d_hash = hash_sse42;
+		d_find = find_sse42;
+	} else if (isa::avx2 == i) {
+		d_hash = hash_sse42;
+		d_find = find_avx2;
+	}
+#endif
+	clear();
+}
+
+prefix_matcher::isa
+prefix_matcher::best_isa() {
+	if (supported(isa::avx2)) {
+		return isa::avx2;
+	}
+	if (supported(isa::sse42)) {
+		return isa::sse42;
+	}
+	return isa::scalar;
+}
+
+bool
+prefix_matcher::supported(isa i) {
+#ifdef NANOMSGPP_PREFIX_MATCHER_X86
+	__builtin_cpu_init();
+#endif
+	switch (i) {
+#ifdef NANOMSGPP_PREFIX_MATCHER_X86
+	case isa::avx2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2");
+	case isa::sse42:
+		return __builtin_cpu_supports("sse4.2");
+#endif
+	case isa::scalar:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+bool
+prefix_matcher::insert(const void* prefix, uint32_t value) {
+	unsigned char key[max_width] = {};
+	std::memcpy(key, prefix, d_width);
+	uint32_t hash = d_hash(key);
+	size_t mask = d_tags.size() / group_size - 1;
+	size_t slot = d_find(d_tags.data(), d_keys.data(), mask, key, hash);
+	if (slot != npos) {
+		d_values[slot] = value;
+		return (false);
+	}
+
+	// keep at least one slot in eight empty, so lookups of missing prefixes stop early
+	if ((d_used + 1) * 8 > d_tags.size() * 7) {
+		size_t n_groups = d_tags.size() / group_size;
+		rehash((d_size + 1) * 8 > d_tags.size() * 4 ? n_groups * 2 : n_groups);
+		mask = d_tags.size() / group_size - 1;
+	}
+
+	// take the first empty or deleted slot along the probe sequence
+	size_t g = group_of(hash, mask);
+	while (true) {
+		for (size_t i = 0; i < group_size; ++i) {
+			size_t s = g * group_size + i;
+			if (d_tags[s] == tag_empty || d_tags[s] == tag_deleted) {
+				if (d_tags[s] == tag_empty) {
+					d_used++;
+				}
+				d_tags[s] = tag_of(hash);
+				std::memcpy(&d_keys[s * max_width], key, max_width);
+				d_values[s] = value;
+				d_size++;
+				return (true);
+			}
+		}
+		g = (g + 1) & mask;
+	}
+}
+
+bool
+prefix_matcher::erase(const void* prefix) {
+	unsigned char key[max_width] = {};
+	std::memcpy(key, prefix, d_width);
+	size_t slot = d_find(d_tags.data(), d_keys.data(), d_tags.size() / group_size - 1, key,
+		d_hash(key));
+	if (npos == slot) {
+		return (false);
+	}
+	// the slot may be part of another prefix's probe sequence, so it is only marked deleted
+	d_tags[slot] = tag_deleted;
+	d_size--;
+	return (true);
+}
+
+void
+prefix_matcher::clear() {
+	d_tags.assign(group_size, tag_empty);
+	d_keys.assign(group_size * max_width, 0);
+	d_values.assign(group_size, 0);
+	d_size = 0;
+	d_used = 0;
+}
+
+void
+prefix_matcher::rehash(size_t n_groups) {
+	std::vector<unsigned char> tags(n_groups * group_size, tag_empty);
+	std::vector<unsigned char> keys(n_groups * group_size * max_width);
+	std::vector<uint32_t> values(n_groups * group_size);
+	tags.swap(d_tags);
+	keys.swap(d_keys);
+	values.swap(d_values);
+	d_size = 0;
+	d_used = 0;
+
+	for (size_t s = 0; s < tags.size(); ++s) {
+		if (tags[s] & 0x80) {
+			insert(&keys[s * max_width], values[s]);
+		}
+	}
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_PREFIX_MATCHER_HPP_INCLUDED
+#define NANOMSGPP_PREFIX_MATCHER_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A prefix matcher maps fixed width topic prefixes to values, and finds the value of the
+	// prefix a message starts with in constant time. Prefixes are held in a hash table whose
+	// slots are grouped 32 at a time, with a one byte tag per slot, so a lookup compares a whole
+	// group of tags with a couple of vector instructions. The instruction set is chosen when the
+	// matcher is constructed, using AVX2 or SSE4.2 where the CPU supports them and portable code
+	// otherwise; every choice builds the same table.
+	class prefix_matcher {
+	public:
+		enum class isa {
+			// Portable code.
+			scalar,
+
+			// SSE4.2, hashing with the crc32 instruction and comparing 16 tags at a time.
+			sse42,
+
+			// AVX2, comparing 32 tags at a time.
+			avx2,
+		};
+
+		// The value returned when no prefix matches.
+		static const uint32_t npos = 0xffffffff;
+
+		// The widest prefix supported.
+		static const size_t max_width = 16;
+
+		// The number of slots in a group.
+		static const size_t group_size = 32;
+
+	private:
+		typedef uint32_t (*hash_function)(const unsigned char* key);
+		typedef size_t (*find_function)(const unsigned char* tags, const unsigned char* keys,
+			size_t mask, const unsigned char* key, uint32_t hash);
+
+		size_t                     d_width;
+		isa                        d_isa;
+		hash_function              d_hash;
+		find_function              d_find;
+		size_t                     d_size;
+		size_t                     d_used;  // slots which are full or deleted
+		std::vector<unsigned char> d_tags;
+		std::vector<unsigned char> d_keys;
+		std::vector<uint32_t>      d_values;
+
+	public:
+		// Construct a matcher for prefixes of the given width, using the given instruction set.
+		// Throws if the width is out of range or the CPU does not support the instruction set.
+		explicit prefix_matcher(size_t width, isa i = best_isa());
+
+		// Get the fastest instruction set supported by the CPU.
+		static isa best_isa();
+
+		// Check whether the CPU supports the given instruction set.
+		static bool supported(isa i);
+
+		// MANIPULATORS
+
+		// Get the prefix width.
+		size_t width() const { return d_width; }
+
+		// Get the instruction set used.
+		isa get_isa() const { return d_isa; }
+
+		// Get the number of prefixes.
+		size_t size() const { return d_size; }
+
+		// Map a prefix of width bytes to a value, replacing the value of an existing prefix.
+		// Returns true if the prefix was added.
+		bool insert(const void* prefix, uint32_t value);
+
+		// Remove a prefix of width bytes. Returns false if it was not present.
+		bool erase(const void* prefix);
+
+		// Find the value of the prefix the data starts with, or npos if there is none.
+		uint32_t find(const void* data, size_t size) const {
+			if (size < d_width || 0 == d_size) {
+				return npos;
+			}
+			unsigned char key[max_width] = {};
+			std::memcpy(key, data, d_width);
+			size_t slot = d_find(d_tags.data(), d_keys.data(), d_tags.size() / group_size - 1,
+				key, d_hash(key));
+			return (npos == slot) ? npos : d_values[slot];
+		}
+
+		// Remove every prefix.
+		void clear();
+
+	private:
+		// Rebuild the table with the given number of groups.
+		void rehash(size_t n_groups);
+
+		// NOT IMPLEMENTED
+		prefix_matcher(const prefix_matcher& other) = delete;
+		prefix_matcher& operator=(const prefix_matcher& other) = delete;
+	};
+
+}
+
+#endif
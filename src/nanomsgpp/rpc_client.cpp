@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/rpc_client.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	// Request ids have the top bit set, which marks the bottom of the backtrace.
+	const uint32_t request_id_flag = 0x80000000;
+
+	std::string encode_id(uint32_t id) {
+		char buf[4] = {
+			static_cast<char>(id >> 24), static_cast<char>(id >> 16),
+			static_cast<char>(id >> 8),  static_cast<char>(id)
+		};
+		return std::string(buf, sizeof(buf));
+	}
+
+	bool decode_id(const std::string& header, uint32_t& id) {
+		if (header.size() != 4) {
+			return (false);
+		}
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(header.data());
+		id = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+		return (true);
+	}
+
+}
+
+rpc_client::rpc_client(size_t max_in_flight)
+	: d_socket(socket_domain::sp_raw, socket_type::request)
+	, d_next_id(0)
+	, d_max_in_flight(max_in_flight)
+	, d_poll_interval(10)
+	, d_running(false)
+	, d_sent(0)
+	, d_completed(0)
+	, d_timeouts(0)
+{
+	if (d_socket.get_fd() < 0) {
+		throw internal_exception();
+	}
+}
+
+rpc_client::~rpc_client() {
+	stop();
+}
+
+void
+rpc_client::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	d_socket.set_option(NN_SOL_SOCKET, socket_option::receive_timeout, d_poll_interval);
+	d_io = std::thread(&rpc_client::io_loop, this);
+}
+
+void
+rpc_client::stop() {
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		d_running.store(false);
+	}
+	d_cond.notify_all();
+	if (d_io.joinable()) {
+		d_io.join();
+	}
+	fail_pending(ECANCELED);
+}
+
+void
+rpc_client::call(message&& request, callback cb, int timeout) {
+	uint32_t id;
+	{
+		std::unique_lock<std::mutex> lock(d_lock);
+		d_cond.wait(lock, [this]() {
+			return d_pending.size() < d_max_in_flight || !d_running.load();
+		});
+		if (!d_running.load()) {
+			throw exception("rpc client is not running");
+		}
+		do {
+			id = (d_next_id++) | request_id_flag;
+		} while (d_pending.count(id) != 0);
+		clock::time_point deadline = clock::now() + std::chrono::milliseconds(timeout);
+		pending p = { std::move(cb), deadline };
+		d_pending.emplace(id, std::move(p));
+		d_deadlines.push(std::make_pair(deadline, id));
+	}
+	request.set_header(encode_id(id));
+	try {
+		d_socket.sendmsg(std::move(request), false);
+	} catch (...) {
+		take(id);
+		throw;
+	}
+	d_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::future<std::unique_ptr<message>>
+rpc_client::call(message&& request, int timeout) {
+	std::shared_ptr<std::promise<std::unique_ptr<message>>> promise
+		(new std::promise<std::unique_ptr<message>>());
+	std::future<std::unique_ptr<message>> result = promise->get_future();
+	call(std::move(request), [promise](std::unique_ptr<message> reply, int error) {
+		if (0 == error) {
+			promise->set_value(std::move(reply));
+		} else {
+			promise->set_exception(std::make_exception_ptr(exception(nn_strerror(error))));
+		}
+	}, timeout);
+	return result;
+}
+
+size_t
+rpc_client::in_flight() {
+	std::lock_guard<std::mutex> lock(d_lock);
+	return d_pending.size();
+}
+
+void
+rpc_client::io_loop() {
+	while (d_running.load()) {
+		try {
+			std::unique_ptr<message> reply = d_socket.recvmsg(1, false);
+			uint32_t id;
+			if (decode_id(reply->header(), id)) {
+				callback cb = take(id);
+				if (cb) {
+					d_completed.fetch_add(1, std::memory_order_relaxed);
+					cb(std::move(reply), 0);
+				}
+			}
+		} catch (internal_exception &e) {
+			if (e.error() != EAGAIN && e.error() != ETIMEDOUT && e.error() != EINTR) {
+				// the socket can no longer be used, so nothing in flight will be answered
+				fail_pending(e.error());
+				return;
+			}
+		}
+		expire(clock::now());
+	}
+}
+
+void
+rpc_client::expire(clock::time_point now) {
+	std::vector<callback> expired;
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		while (!d_deadlines.empty() && d_deadlines.top().first <= now) {
+			auto found = d_pending.find(d_deadlines.top().second);
+			if (found != d_pending.end() && found->second.d_deadline <= now) {
+				expired.push_back(std::move(found->second.d_callback));
+				d_pending.erase(found);
+			}
+			d_deadlines.pop();
+		}
+	}
+	if (!expired.empty()) {
+		d_cond.notify_all();
+	}
+	for (auto& cb : expired) {
+		d_timeouts.fetch_add(1, std::memory_order_relaxed);
+		cb(std::unique_ptr<message>(), ETIMEDOUT);
+	}
+}
+
+void
+rpc_client::fail_pending(int error) {
+	std::unordered_map<uint32_t, pending> failed;
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		d_running.store(false);
+		failed.swap(d_pending);
+		d_deadlines = deadline_queue();
+	}
+	d_cond.notify_all();
+	for (auto& p : failed) {
+		p.second.d_callback(std::unique_ptr<message>(), error);
+	}
+}
+
+rpc_client::callback
+rpc_client::take(uint32_t id) {
+	callback cb;
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		auto found = d_pending.find(id);
+		if (found == d_pending.end()) {
+			return cb;
+		}
+		cb = std::move(found->second.d_callback);
+		d_pending.erase(found);
+	}
+	d_cond.notify_one();
+	return cb;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_RPC_CLIENT_HPP_INCLUDED
+#define NANOMSGPP_RPC_CLIENT_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// An rpc_client sends requests on a raw request socket without waiting for the previous
+	// reply, so many requests can be in flight at once. Each request is stamped with a request
+	// id, and replies are matched to their callers through a correlation table. Requests which
+	// are not answered before their deadline complete with ETIMEDOUT.
+	class rpc_client {
+	public:
+		// A callback receives either the reply, or a null reply and the error code which
+		// completed the request. Callbacks are run on the I/O thread and should be short.
+		typedef std::function<void(std::unique_ptr<message> reply, int error)> callback;
+
+	private:
+		typedef std::chrono::steady_clock clock;
+		typedef std::pair<clock::time_point, uint32_t> deadline;
+		typedef std::priority_queue<deadline, std::vector<deadline>, std::greater<deadline>>
+			deadline_queue;
+
+		struct pending {
+			callback          d_callback;
+			clock::time_point d_deadline;
+		};
+
+		socket                                d_socket;
+		std::mutex                            d_lock;
+		std::condition_variable               d_cond;
+		std::unordered_map<uint32_t, pending> d_pending;
+		deadline_queue                        d_deadlines;
+		uint32_t                              d_next_id;
+		size_t                                d_max_in_flight;
+		int                                   d_poll_interval;
+		std::thread                           d_io;
+		std::atomic<bool>                     d_running;
+		std::atomic<uint64_t>                 d_sent;
+		std::atomic<uint64_t>                 d_completed;
+		std::atomic<uint64_t>                 d_timeouts;
+
+	public:
+		// Construct a client which allows at most max_in_flight outstanding requests.
+		explicit rpc_client(size_t max_in_flight = 4096);
+
+		// Destructor, stops the client.
+		~rpc_client();
+
+		// MANIPULATORS
+
+		// Get the underlying raw socket.
+		socket& get_socket() { return d_socket; }
+
+		// Bind to the given address.
+		void bind(const std::string &addr) { d_socket.bind(addr); }
+
+		// Connect to the given address.
+		void connect(const std::string &addr) { d_socket.connect(addr); }
+
+		// Set how often, in milliseconds, the I/O thread checks for expired deadlines.
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// Start the I/O thread.
+		void start();
+
+		// Stop the I/O thread. Requests still in flight complete with ECANCELED.
+		void stop();
+
+		// Check whether the client is running. A client stops by itself when its socket
+		// fails, completing the requests in flight with the socket error.
+		bool running() const { return d_running.load(); }
+
+		// Send a request and run the callback with its reply. The call blocks while the
+		// maximum number of requests are in flight. The timeout is in milliseconds.
+		void call(message&& request, callback cb, int timeout = 1000);
+
+		// Send a request and return a future for its reply. The future throws an exception
+		// if the request times out or is cancelled.
+		std::future<std::unique_ptr<message>> call(message&& request, int timeout = 1000);
+
+		// Get the number of requests in flight.
+		size_t in_flight();
+
+		// Get the number of requests sent.
+		uint64_t sent() const { return d_sent.load(std::memory_order_relaxed); }
+
+		// Get the number of requests completed with a reply.
+		uint64_t completed() const { return d_completed.load(std::memory_order_relaxed); }
+
+		// Get the number of requests which timed out.
+		uint64_t timeouts() const { return d_timeouts.load(std::memory_order_relaxed); }
+
+	private:
+		// The loop run by the I/O thread.
+		void io_loop();
+
+		// Complete the requests whose deadline has passed.
+		void expire(clock::time_point now);
+
+		// Stop accepting calls and complete every request in flight with the given error.
+		void fail_pending(int error);
+
+		// Remove a request from the correlation table, returning its callback.
+		callback take(uint32_t id);
+
+		// NOT IMPLEMENTED
+		rpc_client(const rpc_client& other) = delete;
+		rpc_client& operator=(const rpc_client& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/server.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+
+using namespace nanomsgpp;
+
+server::server(socket_type type, handler h, size_t n_workers)
+	: d_socket(socket_domain::sp_raw, type)
+	, d_handler(std::move(h))
+	, d_n_workers(n_workers)
+	, d_poll_interval(100)
+	, d_send_timeout(1000)
+	, d_running(false)
+	, d_requests(0)
+	, d_replies(0)
+	, d_errors(0)
+{
+	if (type != socket_type::reply && type != socket_type::respondent) {
+		throw exception("server requires a reply or respondent socket");
+	}
+	if (d_socket.get_fd() < 0) {
+		throw internal_exception();
+	}
+}
+
+server::~server() {
+	stop();
+}
+
+void
+server::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	// reap the threads of a run which stopped on a socket error
+	if (d_io.joinable()) {
+		d_io.join();
+	}
+	if (d_pool) {
+		d_pool->stop();
+		d_pool.reset();
+	}
+	d_socket.set_option(NN_SOL_SOCKET, socket_option::receive_timeout, d_poll_interval);
+	d_socket.set_option(NN_SOL_SOCKET, socket_option::send_timeout, d_send_timeout);
+	d_pool.reset(new pool(d_n_workers,
+		[this](std::unique_ptr<message>& request) { dispatch(request); }));
+	d_io = std::thread(&server::io_loop, this);
+}
+
+void
+server::stop() {
+	d_running.store(false);
+	if (d_io.joinable()) {
+		d_io.join();
+	}
+	if (d_pool) {
+		d_pool->stop();
+		d_pool.reset();
+	}
+}
+
+void
+server::io_loop() {
+	while (d_running.load()) {
+		try {
+			std::unique_ptr<message> request = d_socket.recvmsg(1, false);
+			d_requests.fetch_add(1, std::memory_order_relaxed);
+			d_pool->submit(std::move(request));
+		} catch (internal_exception &e) {
+			if (e.error() == EAGAIN || e.error() == ETIMEDOUT || e.error() == EINTR) {
+				continue;
+			}
+			// the socket can no longer be used
+			d_running.store(false);
+			return;
+		}
+	}
+}
+
+void
+server::dispatch(std::unique_ptr<message>& request) {
+	try {
+		message reply = d_handler(*request);
+		reply.set_header(request->header());
+		// wait up to the send timeout for room, rather than dropping the reply
+		d_socket.sendmsg(std::move(reply), false);
+		d_replies.fetch_add(1, std::memory_order_relaxed);
+	} catch (std::exception &e) {
+		d_errors.fetch_add(1, std::memory_order_relaxed);
+	}
+	request.reset();
+}
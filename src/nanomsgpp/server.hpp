@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SERVER_HPP_INCLUDED
+#define NANOMSGPP_SERVER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+#ifndef NANOMSGPP_WORKER_POOL_HPP_INCLUDED
+#	include "worker_pool.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace nanomsgpp {
+
+	// A server answers requests received on a raw reply or respondent socket. Requests are
+	// received on an I/O thread and handed to a pool of worker threads, and each reply is
+	// routed back to its requester by the backtrace header saved from the request. Replies may
+	// therefore be sent in any order while every requester still receives its own answer.
+	class server {
+	public:
+		// A handler computes the reply for a request.
+		typedef std::function<message(message& request)> handler;
+
+	private:
+		typedef worker_pool<std::unique_ptr<message>> pool;
+
+		socket                d_socket;
+		handler               d_handler;
+		size_t                d_n_workers;
+		int                   d_poll_interval;
+		int                   d_send_timeout;
+		std::unique_ptr<pool> d_pool;
+		std::thread           d_io;
+		std::atomic<bool>     d_running;
+		std::atomic<uint64_t> d_requests;
+		std::atomic<uint64_t> d_replies;
+		std::atomic<uint64_t> d_errors;
+
+	public:
+		// Construct a server for the given protocol, which must be either reply or respondent,
+		// running the handler on n_workers threads.
+		server(socket_type type, handler h,
+			size_t n_workers = std::thread::hardware_concurrency());
+
+		// Destructor, stops the server.
+		~server();
+
+		// MANIPULATORS
+
+		// Get the underlying raw socket.
+		socket& get_socket() { return d_socket; }
+
+		// Bind to the given address.
+		void bind(const std::string &addr) { d_socket.bind(addr); }
+
+		// Connect to the given address.
+		void connect(const std::string &addr) { d_socket.connect(addr); }
+
+		// Set how often, in milliseconds, the I/O thread checks whether it has been stopped.
+		void set_poll_interval(int ms) { d_poll_interval = ms; }
+
+		// Set how long, in milliseconds, a worker waits for room to send a reply before the
+		// reply is dropped and counted as an error.
+		void set_send_timeout(int ms) { d_send_timeout = ms; }
+
+		// Start the I/O thread and the workers.
+		void start();
+
+		// Stop receiving requests, wait for the requests already received to be answered and
+		// join all threads.
+		void stop();
+
+		// Check whether the server is running. A server whose socket fails stops by itself.
+		bool running() const { return d_running.load(); }
+
+		// Get the number of requests received.
+		uint64_t requests() const { return d_requests.load(std::memory_order_relaxed); }
+
+		// Get the number of replies sent.
+		uint64_t replies() const { return d_replies.load(std::memory_order_relaxed); }
+
+		// Get the number of requests for which no reply could be sent.
+		uint64_t errors() const { return d_errors.load(std::memory_order_relaxed); }
+
+	private:
+		// The loop run by the I/O thread.
+		void io_loop();
+
+		// Run the handler for a request and send the reply, run by the workers.
+		void dispatch(std::unique_ptr<message>& request);
+
+		// NOT IMPLEMENTED
+		server() = delete;
+		server(const server& other) = delete;
+		server& operator=(const server& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/sharded_publisher.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <nanomsg/pubsub.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace nanomsgpp;
+
+sharded_publisher::sharded_publisher(const std::vector<std::string>& endpoints)
+	: d_queue_capacity(65536)
+	, d_running(false)
+{
+	if (endpoints.empty()) {
+		throw exception("sharded publisher needs at least one endpoint");
+	}
+	for (auto& e : endpoints) {
+		d_shards.emplace_back(new shard());
+		d_shards.back()->d_socket.bind(e);
+	}
+}
+
+sharded_publisher::~sharded_publisher() {
+	stop();
+	for (auto& s : d_shards) {
+		for (auto& i : s->d_queue) {
+			nn_freemsg(i.d_chunk);
+		}
+	}
+}
+
+size_t
+sharded_publisher::shard_of(const void* topic, size_t topic_size, size_t n_shards) {
+	// FNV-1a, which subscribers compute the same way on their topics
+	const unsigned char* p = static_cast<const unsigned char*>(topic);
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < topic_size; ++i) {
+		h = (h ^ p[i]) * 1099511628211ull;
+	}
+	return h % n_shards;
+}
+
+std::vector<size_t>
+sharded_publisher::subscribe(socket& sub, const std::vector<std::string>& endpoints,
+		const std::vector<std::string>& topics) {
+	std::vector<size_t> shards;
+	for (auto& t : topics) {
+		shards.push_back(shard_of(t.data(), t.size(), endpoints.size()));
+		sub.set_option(NN_SUB, socket_option::sub_subscribe, t);
+	}
+	std::sort(shards.begin(), shards.end());
+	shards.erase(std::unique(shards.begin(), shards.end()), shards.end());
+	for (size_t s : shards) {
+		sub.connect(endpoints[s]);
+	}
+	return shards;
+}
+
+bool
+sharded_publisher::publish(const void* body, size_t size, size_t topic_size) {
+	if (topic_size > size) {
+		throw exception("topic is longer than the message");
+	}
+	shard& s = *d_shards[shard_of(body, topic_size, d_shards.size())];
+
+	// the message is copied into a chunk before taking the lock, so the shard thread can
+	// hand it to nanomsg without another copy
+	void* chunk = nn_allocmsg(size, 0);
+	if (nullptr == chunk) {
+		throw internal_exception();
+	}
+	std::memcpy(chunk, body, size);
+	{
+		std::lock_guard<std::mutex> lock(s.d_lock);
+		if (s.d_queue.size() < d_queue_capacity) {
+			bool wake = s.d_queue.empty();
+			s.d_queue.push_back(item{ chunk, size });
+			s.d_published.fetch_add(1, std::memory_order_relaxed);
+			if (wake) {
+				s.d_cond.notify_one();
+			}
+			return (true);
+		}
+	}
+	nn_freemsg(chunk);
+	s.d_dropped.fetch_add(1, std::memory_order_relaxed);
+	return (false);
+}
+
+void
+sharded_publisher::start() {
+	if (d_running.exchange(true)) {
+		return;
+	}
+	for (auto& s : d_shards) {
+		if (s->d_thread.joinable()) {
+			s->d_thread.join();
+		}
+		s->d_thread = std::thread(&sharded_publisher::run, this, std::ref(*s));
+	}
+}
+
+void
+sharded_publisher::stop() {
+	d_running.store(false);
+	for (auto& s : d_shards) {
+		{
+			std::lock_guard<std::mutex> lock(s->d_lock);
+			s->d_cond.notify_one();
+		}
+		if (s->d_thread.joinable()) {
+			s->d_thread.join();
+		}
+	}
+}
+
+sharded_publisher::statistics
+sharded_publisher::get_statistics(size_t index) const {
+	const shard& s = *d_shards[index];
+	statistics st;
+	st.published = s.d_published.load(std::memory_order_relaxed);
+	st.sent      = s.d_sent.load(std::memory_order_relaxed);
+	st.dropped   = s.d_dropped.load(std::memory_order_relaxed);
+	return st;
+}
+
+void
+sharded_publisher::run(shard& s) {
+	int fd = s.d_socket.get_fd();
+	std::vector<item> batch;
+	while (true) {
+		{
+			// take the whole queue at once, so publishers contend for the lock once per batch
+			// rather than once per message
+			std::unique_lock<std::mutex> lock(s.d_lock);
+			s.d_cond.wait(lock, [&]() {
+				return !s.d_queue.empty() || !d_running.load(std::memory_order_relaxed);
+			});
+			if (s.d_queue.empty()) {
+				break;
+			}
+			batch.swap(s.d_queue);
+		}
+		for (auto& i : batch) {
+			void* chunk = i.d_chunk;
+			if (nn_send(fd, &chunk, NN_MSG, 0) >= 0) {
+				s.d_sent.fetch_add(1, std::memory_order_relaxed);
+			} else {
+				nn_freemsg(chunk);
+				s.d_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		batch.clear();
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SHARDED_PUBLISHER_HPP_INCLUDED
+#define NANOMSGPP_SHARDED_PUBLISHER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A sharded publisher spreads topics over several PUB sockets, each bound to its own
+	// endpoint and sending from its own thread, so publishing scales with cores. The topic of a
+	// message is its first bytes, and every message of a topic goes to the same shard, which
+	// keeps the messages of a topic in order. Messages of different topics may be reordered.
+	//
+	// Publishing is thread safe. Subscribers use subscribe() to connect only to the shards
+	// carrying their topics.
+	class sharded_publisher {
+	public:
+		// A snapshot of the counters of a shard.
+		struct statistics {
+			uint64_t published;  // number of messages queued on the shard
+			uint64_t sent;       // number of messages sent
+			uint64_t dropped;    // number of messages dropped because the queue was full or
+			                     // the socket did not accept them
+		};
+
+	private:
+		// A queued message, held in a chunk allocated by nn_allocmsg.
+		struct item {
+			void*  d_chunk;
+			size_t d_size;
+		};
+
+		struct shard {
+			socket                  d_socket;
+			std::thread             d_thread;
+			std::mutex              d_lock;
+			std::condition_variable d_cond;
+			std::vector<item>       d_queue;
+			std::atomic<uint64_t>   d_published;
+			std::atomic<uint64_t>   d_sent;
+			std::atomic<uint64_t>   d_dropped;
+
+			shard()
+				: d_socket(socket_domain::sp, socket_type::publish)
+				, d_published(0)
+				, d_sent(0)
+				, d_dropped(0) {}
+		};
+
+		std::vector<std::unique_ptr<shard>> d_shards;
+		size_t                              d_queue_capacity;
+		std::atomic<bool>                   d_running;
+
+	public:
+		// Construct a publisher with a shard bound to each of the given endpoints.
+		explicit sharded_publisher(const std::vector<std::string>& endpoints);
+
+		// Destructor, stops the publisher.
+		~sharded_publisher();
+
+		// Get the shard of a topic among n_shards.
+		static size_t shard_of(const void* topic, size_t topic_size, size_t n_shards);
+
+		// Connect a SUB socket to the shards carrying the given topics and subscribe to them.
+		// The endpoints must be in the order the publisher was constructed with. Topics are
+		// whole topics; a prefix of several topics may be spread over every shard, so prefix
+		// subscribers connect to every endpoint instead. Returns the shards connected to.
+		static std::vector<size_t> subscribe(socket& sub,
+			const std::vector<std::string>& endpoints, const std::vector<std::string>& topics);
+
+		// MANIPULATORS
+
+		// Set the number of messages each shard queues before dropping messages.
+		void set_queue_capacity(size_t n) { d_queue_capacity = n; }
+
+		// Get the number of shards.
+		size_t size() const { return d_shards.size(); }
+
+		// Get the socket of a shard, for setting options.
+		socket& get_socket(size_t index) { return d_shards[index]->d_socket; }
+
+		// Queue a message whose topic is its first topic_size bytes on the shard of its topic.
+		// Returns false if the shard's queue is full and the message was dropped.
+		bool publish(const void* body, size_t size, size_t topic_size);
+
+		// Start the shard threads.
+		void start();
+
+		// Stop the shard threads once they have sent the queued messages.
+		void stop();
+
+		// Check whether the shard threads are running.
+		bool running() const { return d_running.load(); }
+
+		// Get a snapshot of the counters of a shard.
+		statistics get_statistics(size_t index) const;
+
+	private:
+		// The loop run by each shard thread.
+		void run(shard& s);
+
+		// NOT IMPLEMENTED
+		sharded_publisher(const sharded_publisher& other) = delete;
+		sharded_publisher& operator=(const sharded_publisher& other) = delete;
+	};
+
+}
+
+#endif
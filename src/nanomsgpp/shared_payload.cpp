@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/shared_payload.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <cstring>
+#include <memory>
+
+using namespace nanomsgpp;
+
+shared_payload::shared_payload()
+	: d_block(nullptr)
+{}
+
+shared_payload::shared_payload(const void* data, size_t size)
+	: d_block(nullptr)
+{
+	allocate(size);
+	std::memcpy(d_block->d_chunk, data, size);
+}
+
+shared_payload::shared_payload(message& msg)
+	: d_block(nullptr)
+{
+	size_t size = 0;
+	for (auto& p : msg) {
+		size += p.size();
+	}
+	allocate(size);
+	unsigned char* out = static_cast<unsigned char*>(d_block->d_chunk);
+	for (auto& p : msg) {
+		std::memcpy(out, p.as<void>(), p.size());
+		out += p.size();
+	}
+}
+
+shared_payload::shared_payload(const shared_payload& other)
+	: d_block(other.d_block)
+{
+	if (d_block != nullptr) {
+		d_block->d_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+shared_payload::shared_payload(shared_payload&& other)
+	: d_block(other.d_block)
+{
+	other.d_block = nullptr;
+}
+
+shared_payload::~shared_payload() {
+	reset();
+}
+
+shared_payload&
+shared_payload::operator=(const shared_payload& other) {
+	if (other.d_block != nullptr) {
+		other.d_block->d_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	reset();
+	d_block = other.d_block;
+	return (*this);
+}
+
+shared_payload&
+shared_payload::operator=(shared_payload&& other) {
+	if (this != &other) {
+		reset();
+		d_block = other.d_block;
+		other.d_block = nullptr;
+	}
+	return (*this);
+}
+
+void*
+shared_payload::release() {
+	// a payload which is not shared cannot become shared while this thread holds it, so the
+	// count cannot change between the check and the release
+	if (nullptr == d_block || d_block->d_refs.load(std::memory_order_acquire) != 1) {
+		return nullptr;
+	}
+	void* chunk = d_block->d_chunk;
+	delete d_block;
+	d_block = nullptr;
+	return chunk;
+}
+
+void
+shared_payload::allocate(size_t size) {
+	// allocate the block before the chunk, so that a throwing new cannot leak the chunk
+	std::unique_ptr<block> b(new block);
+	b->d_chunk = nn_allocmsg(size, 0);
+	if (nullptr == b->d_chunk) {
+		throw internal_exception();
+	}
+	b->d_refs.store(1, std::memory_order_relaxed);
+	b->d_size = size;
+	d_block = b.release();
+}
+
+void
+shared_payload::reset() {
+	if (d_block != nullptr && 1 == d_block->d_refs.fetch_sub(1, std::memory_order_acq_rel)) {
+		nn_freemsg(d_block->d_chunk);
+		delete d_block;
+	}
+	d_block = nullptr;
+}
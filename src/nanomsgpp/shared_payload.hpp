@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SHARED_PAYLOAD_HPP_INCLUDED
+#define NANOMSGPP_SHARED_PAYLOAD_HPP_INCLUDED
+
+#ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
+#	include "message.hpp"
+#endif
+
+#include <atomic>
+#include <cstddef>
+
+namespace nanomsgpp {
+
+	// A shared payload is an immutable, reference counted message body which can be sent on
+	// any number of sockets. It is serialized once, into a chunk allocated by nn_allocmsg, and
+	// copies of the payload share that chunk. Copies may be used from several threads.
+	//
+	// Sending a shared payload lets nanomsg copy the body into its own chunk, except when the
+	// payload sent is the last reference to its chunk, which is then handed to nanomsg without
+	// a copy. Fanning out to N sockets therefore costs N - 1 copies made by nanomsg and no
+	// serialization, when the payload is moved into the last send.
+	class shared_payload {
+		// The shared state, kept apart from the chunk so the chunk can be handed to nanomsg.
+		struct block {
+			std::atomic<long> d_refs;
+			void*             d_chunk;
+			size_t            d_size;
+		};
+
+		block* d_block;
+
+	public:
+		// Construct an empty payload.
+		shared_payload();
+
+		// Construct a payload holding a copy of the given data.
+		shared_payload(const void* data, size_t size);
+
+		// Construct a payload holding the parts of a message, one after another.
+		explicit shared_payload(message& msg);
+
+		// Copy constructor, shares the chunk.
+		shared_payload(const shared_payload& other);
+
+		// Move constructor.
+		shared_payload(shared_payload&& other);
+
+		// Destructor, frees the chunk with the last reference.
+		~shared_payload();
+
+		// Copy assignment operator, shares the chunk.
+		shared_payload& operator=(const shared_payload& other);
+
+		// Move assignment operator.
+		shared_payload& operator=(shared_payload&& other);
+
+		// MANIPULATORS
+
+		// Get a pointer to the body.
+		const void* data() const { return (d_block != nullptr) ? d_block->d_chunk : nullptr; }
+
+		// Convenience method to return the body as a pointer to the given type.
+		template<typename T>
+		const T* as() const { return static_cast<const T*>(data()); }
+
+		// Get the size of the body.
+		size_t size() const { return (d_block != nullptr) ? d_block->d_size : 0; }
+
+		// Get the number of payloads sharing the chunk.
+		long use_count() const {
+			return (d_block != nullptr) ? d_block->d_refs.load(std::memory_order_relaxed) : 0;
+		}
+
+		// Take the chunk, if this is the last reference to it, leaving the payload empty.
+		// Returns nullptr if the chunk is shared, and the caller must free the chunk with
+		// nn_freemsg or send it with NN_MSG otherwise.
+		void* release();
+
+	private:
+		// Allocate a block for a chunk of the given size.
+		void allocate(size_t size);
+
+		// Drop this reference to the block.
+		void reset();
+	};
+
+}
+
+#endif
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/shm_ring.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#endif
+
+using namespace nanomsgpp;
+
+struct shm_ring::control {
+	uint64_t                           d_magic;
+	uint64_t                           d_capacity;
+
+	// the end of the last reservation, advanced by the senders
+	alignas(64) std::atomic<uint64_t>  d_reserved;
+
+	// the end of the last committed message, advanced by the senders in reservation order
+	alignas(64) std::atomic<uint64_t>  d_committed;
+	std::atomic<uint32_t>              d_message_seq;
+	std::atomic<uint32_t>              d_receivers_waiting;
+
+	// the end of the last released message, advanced by the receiver
+	alignas(64) std::atomic<uint64_t>  d_released;
+	std::atomic<uint32_t>              d_room_seq;
+	std::atomic<uint32_t>              d_senders_waiting;
+};
+
+namespace {
+
+	const uint64_t ring_magic = 0x676e69726d68736eULL;  // "nshmring"
+
+	// The ring's data starts on the page after the control block.
+	const size_t control_size = 4096;
+
+	// Each message starts with a record header, and messages are aligned to its size.
+	struct record {
+		uint32_t d_size;
+		uint32_t d_flags;
+	};
+	const size_t record_size = sizeof(record);
+
+	// Set on the record filling the end of the ring when a message does not fit before it.
+	const uint32_t padding_flag = 1;
+
+	// The number of times a blocking call checks the ring before sleeping on the futex. On a
+	// single core the peer cannot make progress while we spin, so sleep at once.
+	const int spin_count = 256;
+	const bool spin = std::thread::hardware_concurrency() > 1;
+
+	size_t record_bytes(size_t size) {
+		return (record_size + size + record_size - 1) & ~(record_size - 1);
+	}
+
+	void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	std::string system_error(const std::string& what) {
+		return what + ": " + std::strerror(errno);
+	}
+
+#if defined(__linux__)
+	int make_memfd() {
+		return static_cast<int>(::syscall(SYS_memfd_create, "nanomsgpp.shm_ring", 1u /* MFD_CLOEXEC */));
+	}
+
+	void futex_wait(std::atomic<uint32_t>& word, uint32_t value, int ms) {
+		struct timespec ts;
+		struct timespec* timeout = nullptr;
+		if (ms >= 0) {
+			ts.tv_sec = ms / 1000;
+			ts.tv_nsec = (ms % 1000) * 1000000L;
+			timeout = &ts;
+		}
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, timeout,
+			nullptr, 0);
+	}
+
+	void futex_wake(std::atomic<uint32_t>& word) {
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr,
+			nullptr, 0);
+	}
+#else
+	int make_memfd() {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	void futex_wait(std::atomic<uint32_t>& word, uint32_t value, int ms) {
+		std::this_thread::sleep_for(std::chrono::milliseconds((ms >= 0 && ms < 1) ? ms : 1));
+	}
+
+	void futex_wake(std::atomic<uint32_t>& word) {}
+#endif
+
+	// Wake any process sleeping on a sequence word.
+	void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting) {
+		seq.fetch_add(1);
+		if (waiting.load() > 0) {
+			futex_wake(seq);
+		}
+	}
+
+	// Wait until ready() holds, spinning briefly and then sleeping on the sequence word, which
+	// is bumped by notify() whenever ready() may have changed. The waiter is counted before
+	// the word is read and ready() checked again, so a notify() in between is never missed.
+	template<typename Ready>
+	bool wait_until(Ready ready, std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting,
+			bool dont_wait, int timeout) {
+		if (ready()) {
+			return (true);
+		}
+		if (dont_wait) {
+			return (false);
+		}
+		for (int i = 0; spin && i < spin_count; ++i) {
+			relax();
+			if (ready()) {
+				return (true);
+			}
+		}
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		while (true) {
+			int ms = -1;
+			if (timeout >= 0) {
+				ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					deadline - std::chrono::steady_clock::now()).count());
+				if (ms <= 0) {
+					return ready();
+				}
+			}
+			waiting.fetch_add(1);
+			uint32_t value = seq.load();
+			if (ready()) {
+				waiting.fetch_sub(1);
+				return (true);
+			}
+			futex_wait(seq, value, ms);
+			waiting.fetch_sub(1);
+			if (ready()) {
+				return (true);
+			}
+		}
+	}
+}
+
+shm_ring::shm_ring(int fd, size_t capacity, bool initialise)
+	: d_fd(fd)
+	, d_control(nullptr)
+	, d_data(nullptr)
+	, d_capacity(capacity)
+	, d_mapped(control_size + capacity)
+	, d_timeout(-1)
+{
+	void* mapping = ::mmap(nullptr, d_mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == mapping) {
+		std::string error = system_error("cannot map shared memory ring");
+		::close(fd);
+		throw exception(error);
+	}
+	d_data = static_cast<unsigned char*>(mapping) + control_size;
+	if (initialise) {
+		d_control = new (mapping) control();
+		d_control->d_capacity = capacity;
+		d_control->d_reserved.store(0);
+		d_control->d_committed.store(0);
+		d_control->d_message_seq.store(0);
+		d_control->d_receivers_waiting.store(0);
+		d_control->d_released.store(0);
+		d_control->d_room_seq.store(0);
+		d_control->d_senders_waiting.store(0);
+		d_control->d_magic = ring_magic;
+	} else {
+		d_control = static_cast<control*>(mapping);
+		if (d_control->d_magic != ring_magic || d_control->d_capacity != capacity) {
+			::munmap(mapping, d_mapped);
+			::close(fd);
+			throw exception("not a shared memory ring");
+		}
+	}
+}
+
+shm_ring::~shm_ring() {
+	::munmap(d_control, d_mapped);
+	::close(d_fd);
+}
+
+std::unique_ptr<shm_ring>
+shm_ring::create(size_t capacity) {
+	size_t rounded = 4096;
+	while (rounded < capacity) {
+		rounded *= 2;
+	}
+	int fd = make_memfd();
+	if (-1 == fd) {
+		throw exception(system_error("cannot create shared memory ring"));
+	}
+	if (-1 == ::ftruncate(fd, control_size + rounded)) {
+		std::string error = system_error("cannot size shared memory ring");
+		::close(fd);
+		throw exception(error);
+	}
+	return std::unique_ptr<shm_ring>(new shm_ring(fd, rounded, true));
+}
+
+std::unique_ptr<shm_ring>
+shm_ring::attach(int fd) {
+	int copy = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (-1 == copy) {
+		throw exception(system_error("cannot attach to shared memory ring"));
+	}
+	return attach_owned(copy);
+}
+
+std::unique_ptr<shm_ring>
+shm_ring::attach(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (-1 == fd) {
+		throw exception(system_error("cannot open shared memory ring " + path));
+	}
+	return attach_owned(fd);
+}
+
+std::unique_ptr<shm_ring>
+shm_ring::attach_owned(int fd) {
+	struct stat st;
+	if (-1 == ::fstat(fd, &st)) {
+		std::string error = system_error("cannot attach to shared memory ring");
+		::close(fd);
+		throw exception(error);
+	}
+	size_t capacity = (st.st_size > static_cast<off_t>(control_size))
+		? st.st_size - control_size : 0;
+	if (capacity < 4096 || 0 != (capacity & (capacity - 1))) {
+		::close(fd);
+		throw exception("not a shared memory ring");
+	}
+	return std::unique_ptr<shm_ring>(new shm_ring(fd, capacity, false));
+}
+
+std::string
+shm_ring::path() const {
+	return "/proc/" + std::to_string(::getpid()) + "/fd/" + std::to_string(d_fd);
+}
+
+bool
+shm_ring::reserve(size_t size, slot& s, bool dont_wait) {
+	if (size > max_message_size()) {
+		throw exception("message is too large for the shared memory ring");
+	}
+	size_t need = record_bytes(size);
+	uint64_t position = d_control->d_reserved.load(std::memory_order_relaxed);
+	size_t total;
+	while (true) {
+		size_t tail = d_capacity - (position & (d_capacity - 1));
+		total = (need <= tail) ? need : tail + need;
+		if (position + total - d_control->d_released.load(std::memory_order_acquire) > d_capacity) {
+			if (!wait_for_room(position + total - d_capacity, dont_wait)) {
+				return (false);
+			}
+			position = d_control->d_reserved.load(std::memory_order_relaxed);
+			continue;
+		}
+		if (d_control->d_reserved.compare_exchange_weak(position, position + total)) {
+			break;
+		}
+	}
+
+	size_t offset = position & (d_capacity - 1);
+	if (total != need) {
+		// the message does not fit before the end of the ring, so fill the end with padding
+		// and start the message at the beginning
+		record* padding = reinterpret_cast<record*>(d_data + offset);
+		padding->d_size = static_cast<uint32_t>(total - need - record_size);
+		padding->d_flags = padding_flag;
+		offset = 0;
+	}
+	record* r = reinterpret_cast<record*>(d_data + offset);
+	r->d_size = static_cast<uint32_t>(size);
+	r->d_flags = 0;
+	s.data = d_data + offset + record_size;
+	s.size = size;
+	s.position = position;
+	return (true);
+}
+
+void
+shm_ring::commit(const slot& s) {
+	size_t need = record_bytes(s.size);
+	size_t tail = d_capacity - (s.position & (d_capacity - 1));
+	uint64_t end = s.position + ((need <= tail) ? need : tail + need);
+
+	// wait for the senders which reserved before this one, who are only copying their body
+	for (int i = 0; d_control->d_committed.load(std::memory_order_acquire) != s.position; ++i) {
+		if (spin && i < spin_count) {
+			relax();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	d_control->d_committed.store(end);
+	notify(d_control->d_message_seq, d_control->d_receivers_waiting);
+}
+
+bool
+shm_ring::peek(slot& s, bool dont_wait) {
+	uint64_t position = d_control->d_released.load(std::memory_order_relaxed);
+	while (true) {
+		if (!wait_for_message(position, dont_wait)) {
+			return (false);
+		}
+		size_t offset = position & (d_capacity - 1);
+		const record* r = reinterpret_cast<const record*>(d_data + offset);
+		if (0 == (r->d_flags & padding_flag)) {
+			s.data = d_data + offset + record_size;
+			s.size = r->d_size;
+			s.position = position;
+			return (true);
+		}
+		// skip the padding at the end of the ring
+		position += record_size + r->d_size;
+		d_control->d_released.store(position);
+		notify(d_control->d_room_seq, d_control->d_senders_waiting);
+	}
+}
+
+void
+shm_ring::release(const slot& s) {
+	d_control->d_released.store(s.position + record_bytes(s.size));
+	notify(d_control->d_room_seq, d_control->d_senders_waiting);
+}
+
+int
+shm_ring::sendmsg(message&& msg, bool dont_wait) {
+	size_t size = 0;
+	for (auto it = msg.cbegin(); it != msg.cend(); ++it) {
+		size += it->size();
+	}
+	slot s;
+	if (!reserve(size, s, dont_wait)) {
+		return -1;
+	}
+	unsigned char* out = s.data;
+	for (auto& p : msg) {
+		std::memcpy(out, p.as<void>(), p.size());
+		out += p.size();
+	}
+	commit(s);
+	return static_cast<int>(size);
+}
+
+int
+shm_ring::send_raw(const void* buf, size_t len, int flags) {
+	slot s;
+	if (!reserve(len, s, 0 != (flags & NN_DONTWAIT))) {
+		return -1;
+	}
+	std::memcpy(s.data, buf, len);
+	commit(s);
+	return static_cast<int>(len);
+}
+
+std::unique_ptr<message>
+shm_ring::recvmsg(bool dont_wait) {
+	slot s;
+	if (!peek(s, dont_wait)) {
+		return std::unique_ptr<message>();
+	}
+	parts msgparts;
+	msgparts.push_back(part(s.data, s.size));
+	release(s);
+	return std::unique_ptr<message>(new message(std::move(msgparts)));
+}
+
+int
+shm_ring::recv_raw(void* buf, size_t len, int flags) {
+	slot s;
+	if (!peek(s, 0 != (flags & NN_DONTWAIT))) {
+		return -1;
+	}
+	std::memcpy(buf, s.data, (len < s.size) ? len : s.size);
+	release(s);
+	return static_cast<int>(s.size);
+}
+
+bool
+shm_ring::wait_for_room(uint64_t position, bool dont_wait) {
+	control* c = d_control;
+	return wait_until([c, position]() {
+		return c->d_released.load(std::memory_order_acquire) >= position;
+	}, c->d_room_seq, c->d_senders_waiting, dont_wait, d_timeout);
+}
+
+bool
+shm_ring::wait_for_message(uint64_t position, bool dont_wait) {
+	control* c = d_control;
+	return wait_until([c, position]() {
+		return c->d_committed.load(std::memory_order_acquire) > position;
+	}, c->d_message_seq, c->d_receivers_waiting, dont_wait, d_timeout);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SHM_RING_HPP_INCLUDED
+#define NANOMSGPP_SHM_RING_HPP_INCLUDED
+
+#ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
+#	include "message.hpp"
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace nanomsgpp {
+
+	// A shared memory ring carries messages between processes on the same host without going
+	// through the kernel. The ring lives in a memfd, which other processes map with attach(),
+	// either from a descriptor passed to them or from the path() of the creating process. Any
+	// number of threads and processes may send on a ring, but only one thread may receive.
+	//
+	// Messages are written in place with reserve() and commit(), and read in place with peek()
+	// and release(), so a large payload is never copied by the ring. sendmsg(), recvmsg(),
+	// send_raw() and recv_raw() follow the socket API for code which does not need that, except
+	// that a full or empty ring is reported by returning -1 or a null message rather than by
+	// throwing. A receiver sleeps on a futex while the ring is empty, and a sender while it
+	// is full, so idle peers do not spin.
+	//
+	// Shared memory rings are only available on Linux.
+	class shm_ring {
+	public:
+		// A message reserved for writing or peeked for reading, whose body is in the ring.
+		struct slot {
+			unsigned char* data;      // the body
+			size_t         size;      // the size of the body
+			uint64_t       position;  // where the message starts in the ring's stream
+		};
+
+	private:
+		// The cursors shared by every process, at the start of the mapping.
+		struct control;
+
+		int            d_fd;
+		control*       d_control;
+		unsigned char* d_data;
+		size_t         d_capacity;
+		size_t         d_mapped;
+		int            d_timeout;
+
+		// Map the ring held by the given memfd, initialising it if it is new.
+		shm_ring(int fd, size_t capacity, bool initialise);
+
+		// Attach to a ring from a descriptor which the ring takes ownership of.
+		static std::unique_ptr<shm_ring> attach_owned(int fd);
+
+	public:
+		// Create a ring of at least capacity bytes in a new memfd.
+		static std::unique_ptr<shm_ring> create(size_t capacity);
+
+		// Attach to a ring from a descriptor of its memfd, which is duplicated.
+		static std::unique_ptr<shm_ring> attach(int fd);
+
+		// Attach to a ring from a path naming its memfd, such as the path() of the creator.
+		static std::unique_ptr<shm_ring> attach(const std::string& path);
+
+		// Destructor, unmaps the ring. The ring is freed once every process has closed it.
+		~shm_ring();
+
+		// MANIPULATORS
+
+		// Get the memfd holding the ring, for passing to another process.
+		int get_fd() const { return d_fd; }
+
+		// Get a path other processes of the same user can attach to while this one is alive.
+		std::string path() const;
+
+		// Get the number of bytes in the ring.
+		size_t capacity() const { return d_capacity; }
+
+		// Get the largest body a message may have.
+		size_t max_message_size() const { return d_capacity / 2 - 8; }
+
+		// Set how long, in milliseconds, a blocking call waits for room or for a message. A
+		// negative timeout waits forever, which is the default.
+		void set_timeout(int ms) { d_timeout = ms; }
+
+		// Reserve room for a message of the given size. Returns false if the ring is full and
+		// dont_wait is set, or the timeout expired. Throws if the message can never fit.
+		bool reserve(size_t size, slot& s, bool dont_wait = true);
+
+		// Make a reserved message visible to the receiver. Messages are made visible in the
+		// order they were reserved, so this waits for earlier reservations to be committed.
+		void commit(const slot& s);
+
+		// Get the oldest message. Returns false if the ring is empty and dont_wait is set, or
+		// the timeout expired. The body stays valid until it is released.
+		bool peek(slot& s, bool dont_wait = true);
+
+		// Free a message returned by peek(), making its room available to senders.
+		void release(const slot& s);
+
+		// Send the parts of a message as one body. Returns the number of bytes sent, or -1 if
+		// the ring was full.
+		int sendmsg(message&& msg, bool dont_wait = true);
+
+		// Send a raw message buffer. Returns the number of bytes sent, or -1 if the ring was full.
+		int send_raw(const void* buf, size_t len, int flags);
+
+		// Receive a message as a single part. Returns a null message if the ring was empty.
+		std::unique_ptr<message> recvmsg(bool dont_wait = true);
+
+		// Receive a message into a buffer, truncating it to len bytes. Returns the size of the
+		// message, or -1 if the ring was empty.
+		int recv_raw(void* buf, size_t len, int flags);
+
+	private:
+		// Wait until the receiver has released the ring up to the given position.
+		bool wait_for_room(uint64_t position, bool dont_wait);
+
+		// Wait until a message has been committed at the given position.
+		bool wait_for_message(uint64_t position, bool dont_wait);
+
+		// NOT IMPLEMENTED
+		shm_ring(const shm_ring& other) = delete;
+		shm_ring& operator=(const shm_ring& other) = delete;
+	};
+
+}
+
+#endif
@@ -22,24 +22,157 @@
 
 #include "nanomsgpp/socket.hpp"
 #include "nanomsgpp/exception.hpp"
+#include "nanomsgpp/trace.hpp"
 #include <nanomsg/nn.h>
+#include <cerrno>
 #include <cstring>
 
 using namespace nanomsgpp;
 
+namespace {
+
+	// Query the domain of an existing socket file descriptor.
+	socket_domain domain_of(int socket) {
+		int domain = AF_SP; size_t len = sizeof(domain);
+		nn_getsockopt(socket, NN_SOL_SOCKET, NN_DOMAIN, &domain, &len);
+		return static_cast<socket_domain>(domain);
+	}
+
+	// Extract the SP_HDR protocol header from the control data of a received message.
+	std::string sp_header(struct nn_msghdr *hdr) {
+		struct nn_cmsghdr *cmsg = NN_CMSG_FIRSTHDR(hdr);
+		while (cmsg != nullptr) {
+			if (cmsg->cmsg_level == PROTO_SP && cmsg->cmsg_type == SP_HDR) {
+				unsigned char *data = NN_CMSG_DATA(cmsg);
+				size_t size;
+				std::memcpy(&size, data, sizeof(size));
+				return std::string(reinterpret_cast<char*>(data + sizeof(size)), size);
+			}
+			cmsg = NN_CMSG_NXTHDR(hdr, cmsg);
+		}
+		return std::string();
+	}
+
+	// Read a nanomsg statistic, which is zero for a closed socket.
+	uint64_t statistic(int socket, int stat) {
+		if (socket < 0) {
+			return 0;
+		}
+		uint64_t value = nn_get_statistic(socket, stat);
+		return (static_cast<uint64_t>(-1) == value) ? 0 : value;
+	}
+
+	// Read the clock if the histograms or an attached tracer will use the reading.
+	inline int64_t start_timer(bool traced) {
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+		(void)traced;
+		return trace_now();
+#else
+		return traced ? trace_now() : 0;
+#endif
+	}
+
+}
+
+struct socket::instruments {
+	histogram             d_send_ns;
+	histogram             d_recv_ns;
+	histogram             d_send_bytes;
+	histogram             d_recv_bytes;
+	histogram             d_round_trip_ns;
+	bool                  d_request;
+	std::atomic<int64_t>  d_request_sent;  // when the outstanding request was sent, or zero
+
+	// Round trips are only timed on cooked REQ sockets, where each reply answers the last
+	// request; a raw REQ socket may have any number of requests outstanding.
+	instruments(int s, socket_domain domain)
+		: d_request(false)
+		, d_request_sent(0)
+	{
+		int protocol = 0; size_t len = sizeof(protocol);
+		if (socket_domain::sp == domain
+				&& 0 == nn_getsockopt(s, NN_SOL_SOCKET, NN_PROTOCOL, &protocol, &len)) {
+			d_request = static_cast<int>(socket_type::request) == protocol;
+		}
+	}
+};
+
+inline void
+socket::record_send(int64_t start, int nb) {
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+	if (nb >= 0) {
+		int64_t now = trace_now();
+		d_instruments->d_send_ns.record(now - start);
+		d_instruments->d_send_bytes.record(nb);
+		if (d_instruments->d_request) {
+			d_instruments->d_request_sent.store(start, std::memory_order_relaxed);
+		}
+	}
+#endif
+	if (NANOMSGPP_TRACE_ENABLED(sendmsg)) {
+		int error = (-1 == nb) ? nn_errno() : 0;
+		int64_t took = (start != 0) ? trace_now() - start : 0;
+		NANOMSGPP_TRACE(sendmsg, d_socket, (nb < 0) ? 0 : nb, error, took);
+	}
+	(void)start;
+}
+
+inline void
+socket::record_recv(int64_t start, int nb) {
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+	if (nb >= 0) {
+		int64_t now = trace_now();
+		d_instruments->d_recv_ns.record(now - start);
+		d_instruments->d_recv_bytes.record(nb);
+		if (d_instruments->d_request) {
+			int64_t sent = d_instruments->d_request_sent.exchange(0, std::memory_order_relaxed);
+			if (sent != 0) {
+				d_instruments->d_round_trip_ns.record(now - sent);
+			}
+		}
+	}
+#endif
+	if (NANOMSGPP_TRACE_ENABLED(recvmsg)) {
+		int error = (-1 == nb) ? nn_errno() : 0;
+		int64_t took = (start != 0) ? trace_now() - start : 0;
+		NANOMSGPP_TRACE(recvmsg, d_socket, (nb < 0) ? 0 : nb, error, took);
+	}
+	(void)start;
+}
+
 socket::socket(socket &&other) {
 	*this = std::move(other);
 }
 
 socket::socket(int socket)
 	: d_socket(socket)
+	, d_domain(domain_of(socket))
 	, d_endpoints()
-{}
+	, d_would_block(0)
+	, d_errors(0)
+	, d_bytes_copied(0)
+	, d_bytes_zero_copy(0)
+	, d_instruments()
+{
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+	d_instruments.reset(new instruments(d_socket, d_domain));
+#endif
+}
 
 socket::socket(socket_domain domain, socket_type type)
 	: d_socket(nn_socket(static_cast<int>(domain), static_cast<int>(type)))
+	, d_domain(domain)
 	, d_endpoints()
-{}
+	, d_would_block(0)
+	, d_errors(0)
+	, d_bytes_copied(0)
+	, d_bytes_zero_copy(0)
+	, d_instruments()
+{
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+	d_instruments.reset(new instruments(d_socket, d_domain));
+#endif
+}
 
 socket::~socket() {
 	close();
@@ -48,8 +181,14 @@ socket::~socket() {
 socket&
 socket::operator=(socket &&other) {
 	d_socket = other.d_socket;
+	d_domain = other.d_domain;
 	other.d_socket = -1;
 	d_endpoints = std::move(other.d_endpoints);
+	d_instruments = std::move(other.d_instruments);
+	d_would_block.store(other.d_would_block.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	d_errors.store(other.d_errors.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	d_bytes_copied.store(other.d_bytes_copied.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	d_bytes_zero_copy.store(other.d_bytes_zero_copy.load(std::memory_order_relaxed), std::memory_order_relaxed);
 	return (*this);
 }
 
@@ -67,7 +206,7 @@ void
 socket::set_option_raw(int level, int option, const void *val, size_t len) {
 	int result = nn_setsockopt(d_socket, level, option, val, len);
 	if (result != 0) {
-		throw internal_exception();
+		throw failure();
 	}
 }
 
@@ -89,7 +228,7 @@ void
 socket::get_option_raw(int level, int option, void *val, size_t *len) {
 	int result = nn_getsockopt(d_socket, level, option, val, len);
 	if (result != 0) {
-		throw internal_exception();
+		throw failure();
 	}
 }
 
@@ -97,7 +236,7 @@ void
 socket::bind(const std::string &addr) {
 	int id = nn_bind(d_socket, addr.c_str());
 	if (-1 == id) {
-		throw internal_exception();
+		throw failure();
 	} else {
 		d_endpoints[addr] = id;
 	}
@@ -107,7 +246,7 @@ void
 socket::connect(const std::string &addr) {
 	int id = nn_connect(d_socket, addr.c_str());
 	if (-1 == id) {
-		throw internal_exception();
+		throw failure();
 	} else {
 		d_endpoints[addr] = id;
 	}
@@ -122,7 +261,7 @@ socket::shutdown(const std::string &addr) {
 	}
 	int result = nn_shutdown(d_socket, id);
 	if (-1 == result) {
-		throw internal_exception();
+		throw failure();
 	}
 }
 
@@ -132,18 +271,63 @@ socket::close() {
 		int result = nn_close(d_socket);
 		d_socket = -1;
 		if (-1 == result) {
-			throw internal_exception();
+			throw failure();
 		}
 	}
 }
 
 int
 socket::sendmsg(message&& msg, bool dont_wait) {
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(sendmsg));
 	int nb = nn_sendmsg(d_socket, msg.gen_nn_msghdr().get(), (dont_wait) ? NN_DONTWAIT : 0);
-	msg.release();
+	record_send(start, nb);
+	if (-1 == nb) {
+		throw failure();
+	}
+	// nanomsg owns the parts allocated by nn_allocmsg now, and has copied the others
+	bool zero_copy = false;
+	for (auto& p : msg) {
+		if (NN_MSG == p.size()) {
+			p.release();
+			zero_copy = true;
+		}
+	}
+	msg.clear();
+	if (zero_copy) {
+		count_zero_copy(nb);
+	} else {
+		count_copied(nb);
+	}
+	return nb;
+}
+
+int
+socket::sendmsg(const shared_payload& payload, bool dont_wait) {
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(sendmsg));
+	int nb = nn_send(d_socket, payload.data(), payload.size(), (dont_wait) ? NN_DONTWAIT : 0);
+	record_send(start, nb);
 	if (-1 == nb) {
-		throw internal_exception();
+		throw failure();
 	}
+	count_copied(nb);
+	return nb;
+}
+
+int
+socket::sendmsg(shared_payload&& payload, bool dont_wait) {
+	void* chunk = payload.release();
+	if (nullptr == chunk) {
+		return sendmsg(static_cast<const shared_payload&>(payload), dont_wait);
+	}
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(sendmsg));
+	int nb = nn_send(d_socket, &chunk, NN_MSG, (dont_wait) ? NN_DONTWAIT : 0);
+	record_send(start, nb);
+	if (-1 == nb) {
+		internal_exception e = failure();
+		nn_freemsg(chunk);
+		throw e;
+	}
+	count_zero_copy(nb);
 	return nb;
 }
 
@@ -155,9 +339,16 @@ socket::operator<<(message&& msg) {
 
 int
 socket::send_raw(const void *buf, size_t len, int flags) {
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(sendmsg));
 	int nb = nn_send(d_socket, buf, len, flags);
+	record_send(start, nb);
 	if (-1 == nb) {
-		throw internal_exception();
+		throw failure();
+	}
+	if (NN_MSG == len) {
+		count_zero_copy(nb);
+	} else {
+		count_copied(nb);
 	}
 	return nb;
 }
@@ -167,6 +358,7 @@ socket::recvmsg(size_t n_parts, bool dont_wait) {
 	struct nn_msghdr hdr;
 	struct nn_iovec iov[n_parts];
 	unsigned char* buf[n_parts];
+	void* control = nullptr;
 
 	size_t buf_size = (1 == n_parts) ? NN_MSG : 2048;
 
@@ -183,10 +375,22 @@ socket::recvmsg(size_t n_parts, bool dont_wait) {
 	std::memset(&hdr, 0, sizeof(hdr));
 	hdr.msg_iov = iov;
 	hdr.msg_iovlen = n_parts;
+	if (socket_domain::sp_raw == d_domain) {
+		hdr.msg_control = &control;
+		hdr.msg_controllen = NN_MSG;
+	}
 
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(recvmsg));
 	int nb = nn_recvmsg(d_socket, &hdr, (dont_wait) ? NN_DONTWAIT : 0);
+	record_recv(start, nb);
 	if (-1 == nb) {
-		throw internal_exception();
+		throw failure();
+	}
+
+	std::string header;
+	if (control != nullptr) {
+		header = sp_header(&hdr);
+		nn_freemsg(control);
 	}
 
 	parts msgparts;
@@ -195,22 +399,127 @@ socket::recvmsg(size_t n_parts, bool dont_wait) {
 			msgparts.push_back(part(buf[i], nb, true));
 			int rc = nn_freemsg(buf[i]); // TODO: free me in part destructor?
 			if (-1 == rc) {
-				throw internal_exception();
+				throw failure();
 			}
 		} else {
 			msgparts.push_back(part(*(void**)buf[i], buf_size, true)); // TODO: size should be NN_MSG?
 		}
 	}
 
-	return std::unique_ptr<message>
-		(new message(std::move(msgparts)));
+	count_copied(nb);
+	std::unique_ptr<message> msg(new message(std::move(msgparts)));
+	msg->set_header(header);
+	return msg;
+}
+
+int
+socket::recvmsg(message& msg, bool dont_wait) {
+	void* body = nullptr;
+	void* control = nullptr;
+	struct nn_iovec iov = { &body, NN_MSG };
+	struct nn_msghdr hdr;
+	std::memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = &iov;
+	hdr.msg_iovlen = 1;
+	if (socket_domain::sp_raw == d_domain) {
+		hdr.msg_control = &control;
+		hdr.msg_controllen = NN_MSG;
+	}
+
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(recvmsg));
+	int nb = nn_recvmsg(d_socket, &hdr, (dont_wait) ? NN_DONTWAIT : 0);
+	record_recv(start, nb);
+	if (-1 == nb) {
+		throw failure();
+	}
+
+	if (control != nullptr) {
+		msg.set_header(sp_header(&hdr));
+		nn_freemsg(control);
+	} else if (!msg.header().empty()) {
+		msg.set_header(std::string());
+	}
+	msg.clear();
+	msg.add_part(part(body, nb, false));
+	count_zero_copy(nb);
+	return nb;
 }
 
 int
 socket::recv_raw(void *buf, size_t len, int flags) {
+	int64_t start = start_timer(NANOMSGPP_TRACE_ENABLED(recvmsg));
 	int nb = nn_recv(d_socket, buf, len, flags);
+	record_recv(start, nb);
 	if (-1 == nb) {
-		throw internal_exception();
+		throw failure();
+	}
+	if (NN_MSG == len) {
+		count_zero_copy(nb);
+	} else {
+		count_copied(nb);
 	}
 	return nb;
 }
+
+socket::statistics
+socket::stats() const {
+	statistics result;
+	result.established_connections = statistic(d_socket, NN_STAT_ESTABLISHED_CONNECTIONS);
+	result.accepted_connections = statistic(d_socket, NN_STAT_ACCEPTED_CONNECTIONS);
+	result.dropped_connections = statistic(d_socket, NN_STAT_DROPPED_CONNECTIONS);
+	result.broken_connections = statistic(d_socket, NN_STAT_BROKEN_CONNECTIONS);
+	result.current_connections = statistic(d_socket, NN_STAT_CURRENT_CONNECTIONS);
+	result.messages_sent = statistic(d_socket, NN_STAT_MESSAGES_SENT);
+	result.messages_received = statistic(d_socket, NN_STAT_MESSAGES_RECEIVED);
+	result.bytes_sent = statistic(d_socket, NN_STAT_BYTES_SENT);
+	result.bytes_received = statistic(d_socket, NN_STAT_BYTES_RECEIVED);
+	result.would_block = d_would_block.load(std::memory_order_relaxed);
+	result.errors = d_errors.load(std::memory_order_relaxed);
+	result.bytes_copied = d_bytes_copied.load(std::memory_order_relaxed);
+	result.bytes_zero_copy = d_bytes_zero_copy.load(std::memory_order_relaxed);
+	return result;
+}
+
+socket::histograms
+socket::get_histograms() const {
+	histograms result;
+	if (d_instruments) {
+		result.send_ns = d_instruments->d_send_ns.get_snapshot();
+		result.recv_ns = d_instruments->d_recv_ns.get_snapshot();
+		result.send_bytes = d_instruments->d_send_bytes.get_snapshot();
+		result.recv_bytes = d_instruments->d_recv_bytes.get_snapshot();
+		result.round_trip_ns = d_instruments->d_round_trip_ns.get_snapshot();
+	}
+	return result;
+}
+
+socket::histograms
+socket::reset_histograms() {
+	histograms result;
+	if (d_instruments) {
+		result.send_ns = d_instruments->d_send_ns.reset();
+		result.recv_ns = d_instruments->d_recv_ns.reset();
+		result.send_bytes = d_instruments->d_send_bytes.reset();
+		result.recv_bytes = d_instruments->d_recv_bytes.reset();
+		result.round_trip_ns = d_instruments->d_round_trip_ns.reset();
+	}
+	return result;
+}
+
+bool
+socket::histograms_enabled() {
+#ifdef NANOMSGPP_LATENCY_HISTOGRAMS
+	return (true);
+#else
+	return (false);
+#endif
+}
+
+internal_exception
+socket::failure() {
+	if (EAGAIN == nn_errno()) {
+		d_would_block.fetch_add(1, std::memory_order_relaxed);
+	}
+	d_errors.fetch_add(1, std::memory_order_relaxed);
+	return internal_exception();
+}
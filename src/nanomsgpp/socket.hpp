@@ -32,7 +32,18 @@
 #ifndef NANOMSGPP_MESSAGE_HPP_INCLUDED
 #	include "message.hpp"
 #endif
+#ifndef NANOMSGPP_SHARED_PAYLOAD_HPP_INCLUDED
+#	include "shared_payload.hpp"
+#endif
+#ifndef NANOMSGPP_EXCEPTION_HPP_INCLUDED
+#	include "exception.hpp"
+#endif
+#ifndef NANOMSGPP_HISTOGRAM_HPP_INCLUDED
+#	include "histogram.hpp"
+#endif
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -43,8 +54,48 @@ namespace nanomsgpp {
 	// Sockets are used to establish nanomsg connections via TCP or IPC. Sockets must be initialised
 	// with parameters to describe their domain and protocol.
 	class socket {
-		int                        d_socket;
-		std::map<std::string, int> d_endpoints;
+	public:
+		// A snapshot of the socket statistics. The first group is kept by nanomsg, the second
+		// by the socket itself.
+		struct statistics {
+			uint64_t established_connections; // number of connections established
+			uint64_t accepted_connections;    // number of connections accepted
+			uint64_t dropped_connections;     // number of connections dropped
+			uint64_t broken_connections;      // number of connections broken
+			uint64_t current_connections;     // number of connections currently open
+			uint64_t messages_sent;           // number of messages sent
+			uint64_t messages_received;       // number of messages received
+			uint64_t bytes_sent;              // number of bytes sent
+			uint64_t bytes_received;          // number of bytes received
+
+			uint64_t would_block;             // number of sends and receives failing with EAGAIN
+			uint64_t errors;                  // number of exceptions thrown
+			uint64_t bytes_copied;            // bytes copied to or from a user buffer
+			uint64_t bytes_zero_copy;         // bytes handed over in nanomsg chunks
+		};
+
+		// Snapshots of the latency and size histograms of the socket. Latencies are in
+		// nanoseconds and include the time a blocking call waited.
+		struct histograms {
+			histogram::snapshot send_ns;        // time taken by successful sends
+			histogram::snapshot recv_ns;        // time taken by successful receives
+			histogram::snapshot send_bytes;     // sizes of the messages sent
+			histogram::snapshot recv_bytes;     // sizes of the messages received
+			histogram::snapshot round_trip_ns;  // time from a request to its reply, cooked REQ only
+		};
+
+	private:
+		// The histograms a socket records into when they are compiled in.
+		struct instruments;
+
+		int                          d_socket;
+		socket_domain                d_domain;
+		std::map<std::string, int>   d_endpoints;
+		std::atomic<uint64_t>        d_would_block;
+		std::atomic<uint64_t>        d_errors;
+		std::atomic<uint64_t>        d_bytes_copied;
+		std::atomic<uint64_t>        d_bytes_zero_copy;
+		std::unique_ptr<instruments> d_instruments;
 
 	public:
 		// Move constructor.
@@ -67,18 +118,37 @@ namespace nanomsgpp {
 		// Get the socket file descriptor.
 		int get_fd() const { return d_socket; }
 
-		// Send messages, setting dont_wait to false will cause the call to block.
+		// Get the socket domain.
+		socket_domain get_domain() const { return d_domain; }
+
+		// Send messages, setting dont_wait to false will cause the call to block. If the
+		// message has a protocol header it is passed to the socket as SP_HDR control data.
+		// The parts are freed once nanomsg has copied them, except for a part allocated by
+		// nn_allocmsg, which must be the only part and is handed to nanomsg without copying.
+		// If sending fails the parts are left with the message.
 		int sendmsg(message&& msg, bool dont_wait = true);
 
+		// Send a shared payload, which nanomsg copies.
+		int sendmsg(const shared_payload& payload, bool dont_wait = true);
+
+		// Send a shared payload, handing its chunk to nanomsg without a copy if this is the
+		// last reference to it.
+		int sendmsg(shared_payload&& payload, bool dont_wait = true);
+
 		// Stream message send operator.
 		socket& operator<<(message&& msg);
 
 		// Send a raw message buffer allocated by the user.
 		int send_raw(const void *buf, size_t len, int flags);
 
-		// Receive a message.
+		// Receive a message. Messages received on a raw socket carry their protocol header.
 		std::unique_ptr<message> recvmsg(size_t n_parts, bool dont_wait = true);
 
+		// Receive a message into msg, replacing its parts with a single part holding the
+		// chunk nanomsg received into. Reusing a message this way allocates nothing beyond
+		// the chunk. Returns the size of the message.
+		int recvmsg(message& msg, bool dont_wait = true);
+
 		// Stream message receive operator.
 		socket& operator>>(std::unique_ptr<message> &m);
 
@@ -113,7 +183,37 @@ namespace nanomsgpp {
 		// Close the socket.
 		void close();
 
+		// Get a snapshot of the socket statistics. This may be called from any thread while
+		// the socket is in use; the counters are read independently, so a snapshot taken
+		// during a send may count its message but not yet its bytes. The nanomsg statistics
+		// are zero once the socket is closed.
+		statistics stats() const;
+
+		// Get snapshots of the histograms, which stay empty unless the library was built with
+		// NANOMSGPP_LATENCY_HISTOGRAMS defined (configure --enable-latency-histograms). The
+		// round trip histogram is only recorded by request sockets.
+		histograms get_histograms() const;
+
+		// Get snapshots of the histograms and reset them, without stopping traffic.
+		histograms reset_histograms();
+
+		// Check whether the library records histograms.
+		static bool histograms_enabled();
+
 	private:
+		// Record a successful send of nb bytes which started at the given time.
+		void record_send(int64_t start, int nb);
+
+		// Record a successful receive of nb bytes which started at the given time.
+		void record_recv(int64_t start, int nb);
+
+		// Count a failed call and build the exception describing it.
+		internal_exception failure();
+
+		// Count bytes moved by a successful call.
+		void count_copied(int nb) { d_bytes_copied.fetch_add(nb, std::memory_order_relaxed); }
+		void count_zero_copy(int nb) { d_bytes_zero_copy.fetch_add(nb, std::memory_order_relaxed); }
+
 		// NOT IMPLEMENTED
 		socket() = delete;
 		socket(const socket &other) = delete;
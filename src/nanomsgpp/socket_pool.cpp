@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/socket_pool.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <cstring>
+
+using namespace nanomsgpp;
+
+// *** LEASE IMPLEMENTATION
+
+socket_pool::lease::lease(socket_pool* pool, std::unique_ptr<socket>&& s)
+	: d_pool(pool)
+	, d_socket(std::move(s))
+	, d_healthy(true)
+{}
+
+socket_pool::lease::lease(lease&& other)
+	: d_pool(other.d_pool)
+	, d_socket(std::move(other.d_socket))
+	, d_healthy(other.d_healthy)
+{}
+
+socket_pool::lease::~lease() {
+	if (d_socket) {
+		d_pool->checkin(std::move(d_socket), d_healthy);
+	}
+}
+
+std::unique_ptr<message>
+socket_pool::lease::request(message&& msg) {
+	try {
+		d_socket->sendmsg(std::move(msg), false);
+		return d_socket->recvmsg(1, false);
+	} catch (...) {
+		invalidate();
+		throw;
+	}
+}
+
+// *** SOCKET POOL IMPLEMENTATION
+
+socket_pool::socket_pool(const std::vector<std::string>& addrs, size_t max_size,
+		configurator configure, socket_type type, socket_domain domain)
+	: d_domain(domain)
+	, d_type(type)
+	, d_addrs(addrs)
+	, d_max_size(max_size)
+	, d_configure(std::move(configure))
+	, d_size(0)
+	, d_idle_timeout(-1)
+{
+	if (0 == d_max_size) {
+		throw exception("a socket pool needs a maximum size of at least one");
+	}
+	std::memset(&d_metrics, 0, sizeof(d_metrics));
+}
+
+socket_pool::~socket_pool()
+{}
+
+socket_pool::lease
+socket_pool::checkout(int timeout) {
+	// declared before the lock, so expired sockets are closed after it is released
+	std::vector<std::unique_ptr<socket>> expired;
+	std::unique_lock<std::mutex> lock(d_lock);
+	d_metrics.checkouts++;
+	expire(expired);
+	if (d_idle.empty() && d_size >= d_max_size) {
+		clock::time_point start = clock::now();
+		auto ready = [this]() { return !d_idle.empty() || d_size < d_max_size; };
+		bool ok = true;
+		if (timeout < 0) {
+			d_cond.wait(lock, ready);
+		} else {
+			ok = d_cond.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+		}
+		uint64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>
+			(clock::now() - start).count();
+		d_metrics.waits++;
+		d_metrics.wait_ns += waited;
+		if (waited > d_metrics.max_wait_ns) {
+			d_metrics.max_wait_ns = waited;
+		}
+		if (!ok) {
+			d_metrics.timeouts++;
+			throw exception("timed out waiting for a free socket");
+		}
+	}
+	if (!d_idle.empty()) {
+		std::unique_ptr<socket> s = std::move(d_idle.back().d_socket);
+		d_idle.pop_back();
+		return lease(this, std::move(s));
+	}
+	// reserve a slot for the new socket, so it can be connected without holding the lock
+	d_size++;
+	lock.unlock();
+	try {
+		return lease(this, create());
+	} catch (...) {
+		lock.lock();
+		d_size--;
+		lock.unlock();
+		d_cond.notify_one();
+		throw;
+	}
+}
+
+void
+socket_pool::reserve(size_t n) {
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(d_lock);
+			if (d_size >= n || d_size >= d_max_size) {
+				return;
+			}
+			d_size++;
+		}
+		std::unique_ptr<socket> s;
+		try {
+			s = create();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(d_lock);
+			d_size--;
+			throw;
+		}
+		checkin(std::move(s), true);
+	}
+}
+
+void
+socket_pool::set_idle_timeout(int timeout) {
+	std::lock_guard<std::mutex> lock(d_lock);
+	d_idle_timeout = timeout;
+}
+
+socket_pool::metrics
+socket_pool::get_metrics() {
+	std::lock_guard<std::mutex> lock(d_lock);
+	metrics m = d_metrics;
+	m.size = d_size;
+	m.idle = d_idle.size();
+	return m;
+}
+
+std::unique_ptr<socket>
+socket_pool::create() {
+	std::unique_ptr<socket> s(new socket(d_domain, d_type));
+	if (s->get_fd() < 0) {
+		throw internal_exception();
+	}
+	if (d_configure) {
+		d_configure(*s);
+	}
+	for (auto& addr : d_addrs) {
+		s->connect(addr);
+	}
+	std::lock_guard<std::mutex> lock(d_lock);
+	d_metrics.created++;
+	return s;
+}
+
+void
+socket_pool::expire(std::vector<std::unique_ptr<socket>>& expired) {
+	if (d_idle_timeout < 0) {
+		return;
+	}
+	clock::time_point limit = clock::now() - std::chrono::milliseconds(d_idle_timeout);
+	// d_idle is in checkin order, so the expired sockets are at the front
+	auto it = d_idle.begin();
+	while (it != d_idle.end() && it->d_since <= limit) {
+		expired.push_back(std::move(it->d_socket));
+		++it;
+	}
+	d_idle.erase(d_idle.begin(), it);
+	d_size -= expired.size();
+	d_metrics.expired += expired.size();
+}
+
+void
+socket_pool::checkin(std::unique_ptr<socket> s, bool healthy) {
+	{
+		std::lock_guard<std::mutex> lock(d_lock);
+		if (healthy && s->get_fd() >= 0) {
+			idle_socket idle = { std::move(s), clock::now() };
+			d_idle.push_back(std::move(idle));
+		} else {
+			d_size--;
+			d_metrics.evicted++;
+		}
+	}
+	d_cond.notify_one();
+	// an evicted socket is closed by the destructor of s, outside the lock
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SOCKET_POOL_HPP_INCLUDED
+#define NANOMSGPP_SOCKET_POOL_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A socket pool shares connected request sockets between threads. A thread checks out a
+	// socket for the duration of a request and returns it to the pool afterwards. Sockets are
+	// created lazily up to a maximum size, and a socket which failed or was closed while checked
+	// out is closed instead of being returned. Sockets left idle for longer than the idle timeout
+	// are closed on the next checkout rather than lent out.
+	class socket_pool {
+	public:
+		// A configurator is run on every socket the pool creates, before it is connected.
+		typedef std::function<void(socket&)> configurator;
+
+		// A snapshot of the pool counters.
+		struct metrics {
+			uint64_t checkouts;    // number of sockets checked out
+			uint64_t waits;        // number of checkouts which waited for a free socket
+			uint64_t timeouts;     // number of checkouts which timed out
+			uint64_t wait_ns;      // total time spent waiting for a free socket
+			uint64_t max_wait_ns;  // longest time spent waiting for a free socket
+			uint64_t created;      // number of sockets created
+			uint64_t evicted;      // number of sockets closed after a failure
+			uint64_t expired;      // number of sockets closed after the idle timeout
+			size_t   size;         // number of sockets owned by the pool
+			size_t   idle;         // number of sockets waiting to be checked out
+		};
+
+		// A lease is a socket checked out of the pool. The socket is returned to the pool when
+		// the lease is destroyed, so a lease must not outlive its pool.
+		class lease {
+			socket_pool*            d_pool;
+			std::unique_ptr<socket> d_socket;
+			bool                    d_healthy;
+
+		public:
+			// Move constructor.
+			lease(lease&& other);
+
+			// Destructor, returns the socket to the pool.
+			~lease();
+
+			// MANIPULATORS
+
+			// Get the leased socket.
+			socket& get() { return *d_socket; }
+
+			// Access the leased socket.
+			socket* operator->() { return d_socket.get(); }
+
+			// Send a request and wait for its reply. If either step fails the socket is
+			// invalidated and the exception is rethrown.
+			std::unique_ptr<message> request(message&& msg);
+
+			// Mark the socket as failed, so it is closed instead of returned to the pool.
+			void invalidate() { d_healthy = false; }
+
+		private:
+			friend class socket_pool;
+
+			// Construct a lease for the given socket.
+			lease(socket_pool* pool, std::unique_ptr<socket>&& s);
+
+			// NOT IMPLEMENTED
+			lease() = delete;
+			lease(const lease& other) = delete;
+			lease& operator=(const lease& other) = delete;
+			lease& operator=(lease&& other) = delete;
+		};
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		// An idle socket and the time it was returned to the pool.
+		struct idle_socket {
+			std::unique_ptr<socket> d_socket;
+			clock::time_point       d_since;
+		};
+
+		socket_domain                        d_domain;
+		socket_type                          d_type;
+		std::vector<std::string>             d_addrs;
+		size_t                               d_max_size;
+		configurator                         d_configure;
+		std::mutex                           d_lock;
+		std::condition_variable              d_cond;
+		std::vector<idle_socket>             d_idle;
+		size_t                               d_size;
+		int                                  d_idle_timeout;
+		metrics                              d_metrics;
+
+	public:
+		// Construct a pool of at most max_size request sockets connected to the given
+		// addresses. Throws if max_size is zero.
+		socket_pool(const std::vector<std::string>& addrs, size_t max_size,
+			configurator configure = configurator(),
+			socket_type type = socket_type::request,
+			socket_domain domain = socket_domain::sp);
+
+		// Destructor.
+		~socket_pool();
+
+		// MANIPULATORS
+
+		// Check out a socket, creating one if none is idle and the pool has not reached its
+		// maximum size, otherwise waiting up to timeout milliseconds for one to be returned.
+		// A negative timeout waits forever.
+		lease checkout(int timeout = -1);
+
+		// Close idle sockets which have not been used for timeout milliseconds when a socket is
+		// next checked out. A negative timeout, the default, keeps idle sockets forever.
+		void set_idle_timeout(int timeout);
+
+		// Create sockets until at least n are owned by the pool.
+		void reserve(size_t n);
+
+		// Get a snapshot of the pool counters.
+		metrics get_metrics();
+
+	private:
+		// Create and connect a new socket.
+		std::unique_ptr<socket> create();
+
+		// Remove the idle sockets older than the idle timeout, appending them to expired so
+		// they can be closed outside the lock. The lock must be held.
+		void expire(std::vector<std::unique_ptr<socket>>& expired);
+
+		// Return a socket to the pool, closing it if it is unhealthy or closed.
+		void checkin(std::unique_ptr<socket> s, bool healthy);
+
+		// NOT IMPLEMENTED
+		socket_pool() = delete;
+		socket_pool(const socket_pool& other) = delete;
+		socket_pool& operator=(const socket_pool& other) = delete;
+	};
+
+}
+
+#endif
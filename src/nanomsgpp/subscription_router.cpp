@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/subscription_router.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <nanomsg/pubsub.h>
+
+using namespace nanomsgpp;
+
+const uint32_t subscription_router::npos;
+
+subscription_router::subscription_router(socket& s)
+	: d_socket(s)
+	, d_size(0)
+	, d_dispatched(0)
+	, d_unmatched(0)
+{
+	// the root node stands for the empty topic
+	d_nodes.push_back(node{ npos, npos, npos, 0 });
+}
+
+void
+subscription_router::set_topic_width(size_t width, prefix_matcher::isa i) {
+	if (d_size > 0) {
+		throw exception("topic width must be set before subscribing");
+	}
+	d_matcher.reset(new prefix_matcher(width, i));
+}
+
+void
+subscription_router::subscribe(const std::string& topic, handler h) {
+	if (d_matcher) {
+		if (topic.size() != d_matcher->width()) {
+			throw exception("topic does not have the router topic width");
+		}
+		uint32_t i = d_matcher->find(topic.data(), topic.size());
+		if (i != npos) {
+			d_handlers[i] = std::move(h);
+			return;
+		}
+		d_socket.set_option(NN_SUB, socket_option::sub_subscribe, topic);
+		d_matcher->insert(topic.data(), add_handler(std::move(h)));
+		d_size++;
+		return;
+	}
+
+	uint32_t n = 0;
+	for (size_t i = 0; i < topic.size() && n != npos; ++i) {
+		n = find_child(n, static_cast<unsigned char>(topic[i]));
+	}
+	if (n != npos && d_nodes[n].d_handler != npos) {
+		d_handlers[d_nodes[n].d_handler] = std::move(h);
+		return;
+	}
+
+	// subscribe before adding the nodes, so a failure leaves the trie unchanged
+	d_socket.set_option(NN_SUB, socket_option::sub_subscribe, topic);
+	n = 0;
+	for (unsigned char c : topic) {
+		n = add_child(n, c);
+	}
+	d_nodes[n].d_handler = add_handler(std::move(h));
+	d_size++;
+}
+
+bool
+subscription_router::unsubscribe(const std::string& topic) {
+	if (d_matcher) {
+		uint32_t i = (topic.size() == d_matcher->width())
+			? d_matcher->find(topic.data(), topic.size()) : npos;
+		if (npos == i) {
+			return (false);
+		}
+		d_socket.set_option(NN_SUB, socket_option::sub_unsubscribe, topic);
+		d_matcher->erase(topic.data());
+		remove_handler(i);
+		d_size--;
+		return (true);
+	}
+
+	// remember the path, so nodes left without topics can be unlinked on the way back up
+	std::vector<uint32_t> path(1, 0);
+	for (unsigned char c : topic) {
+		uint32_t n = find_child(path.back(), c);
+		if (npos == n) {
+			return (false);
+		}
+		path.push_back(n);
+	}
+	node& last = d_nodes[path.back()];
+	if (npos == last.d_handler) {
+		return (false);
+	}
+
+	d_socket.set_option(NN_SUB, socket_option::sub_unsubscribe, topic);
+	remove_handler(last.d_handler);
+	last.d_handler = npos;
+	d_size--;
+
+	for (size_t i = path.size() - 1; i > 0; --i) {
+		uint32_t n = path[i];
+		if (d_nodes[n].d_child != npos || d_nodes[n].d_handler != npos) {
+			break;
+		}
+		uint32_t* link = &d_nodes[path[i - 1]].d_child;
+		while (*link != n) {
+			link = &d_nodes[*link].d_sibling;
+		}
+		*link = d_nodes[n].d_sibling;
+		d_free_nodes.push_back(n);
+	}
+	return (true);
+}
+
+const subscription_router::handler*
+subscription_router::match(const void* data, size_t size) const {
+	if (d_matcher) {
+		uint32_t i = d_matcher->find(data, size);
+		return (npos == i) ? nullptr : &d_handlers[i];
+	}
+
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint32_t n = 0;
+	uint32_t best = d_nodes[0].d_handler;
+	for (size_t i = 0; i < size; ++i) {
+		n = find_child(n, p[i]);
+		if (npos == n) {
+			break;
+		}
+		if (d_nodes[n].d_handler != npos) {
+			best = d_nodes[n].d_handler;
+		}
+	}
+	return (npos == best) ? nullptr : &d_handlers[best];
+}
+
+bool
+subscription_router::dispatch(bool dont_wait) {
+	void* body = nullptr;
+	int nb = nn_recv(d_socket.get_fd(), &body, NN_MSG, dont_wait ? NN_DONTWAIT : 0);
+	if (-1 == nb) {
+		if (EAGAIN == nn_errno() || ETIMEDOUT == nn_errno()) {
+			return (false);
+		}
+		throw internal_exception();
+	}
+
+	const handler* h = match(body, nb);
+	if (nullptr == h) {
+		d_unmatched++;
+		nn_freemsg(body);
+		return (true);
+	}
+	d_dispatched++;
+
+	// the handler may replace the body, so the chunk is freed through the view's slot
+	message_view view(&body, nb, nullptr, 0);
+	try {
+		(*h)(view);
+	} catch (...) {
+		nn_freemsg(body);
+		throw;
+	}
+	nn_freemsg(body);
+	return (true);
+}
+
+uint32_t
+subscription_router::add_handler(handler h) {
+	uint32_t i;
+	if (d_free_handlers.empty()) {
+		i = static_cast<uint32_t>(d_handlers.size());
+		d_handlers.push_back(std::move(h));
+	} else {
+		i = d_free_handlers.back();
+		d_free_handlers.pop_back();
+		d_handlers[i] = std::move(h);
+	}
+	return i;
+}
+
+void
+subscription_router::remove_handler(uint32_t i) {
+	d_handlers[i] = nullptr;
+	d_free_handlers.push_back(i);
+}
+
+uint32_t
+subscription_router::find_child(uint32_t n, unsigned char byte) const {
+	uint32_t c = d_nodes[n].d_child;
+	while (c != npos && d_nodes[c].d_byte < byte) {
+		c = d_nodes[c].d_sibling;
+	}
+	return (c != npos && d_nodes[c].d_byte == byte) ? c : npos;
+}
+
+uint32_t
+subscription_router::add_child(uint32_t n, unsigned char byte) {
+	// find the link to the first child not less than the byte
+	uint32_t link = n;
+	bool first = true;
+	uint32_t c = d_nodes[n].d_child;
+	while (c != npos && d_nodes[c].d_byte < byte) {
+		link = c;
+		first = false;
+		c = d_nodes[c].d_sibling;
+	}
+	if (c != npos && d_nodes[c].d_byte == byte) {
+		return c;
+	}
+
+	uint32_t child;
+	if (d_free_nodes.empty()) {
+		child = static_cast<uint32_t>(d_nodes.size());
+		d_nodes.push_back(node{ npos, c, npos, byte });
+	} else {
+		child = d_free_nodes.back();
+		d_free_nodes.pop_back();
+		d_nodes[child] = node{ npos, c, npos, byte };
+	}
+	if (first) {
+		d_nodes[n].d_child = child;
+	} else {
+		d_nodes[link].d_sibling = child;
+	}
+	return child;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SUBSCRIPTION_ROUTER_HPP_INCLUDED
+#define NANOMSGPP_SUBSCRIPTION_ROUTER_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#	include "message_view.hpp"
+#endif
+#ifndef NANOMSGPP_PREFIX_MATCHER_HPP_INCLUDED
+#	include "prefix_matcher.hpp"
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A subscription router owns the subscriptions of a SUB socket and dispatches each message
+	// it receives to the handler of the longest topic which is a prefix of the message. Topics
+	// are held in a prefix trie, so a message is matched in time proportional to its topic and
+	// without allocating. When every topic has the same width, a prefix_matcher can be used
+	// instead of the trie. The router is not thread safe, and must be used from one thread.
+	class subscription_router {
+	public:
+		// Handlers are called with the received message, which is freed when they return.
+		// Handlers must not subscribe or unsubscribe.
+		typedef std::function<void(message_view& msg)> handler;
+
+	private:
+		// A trie node. The children of a node are linked through their siblings in byte order,
+		// and nodes refer to each other by index so the trie is a single array.
+		struct node {
+			uint32_t      d_child;
+			uint32_t      d_sibling;
+			uint32_t      d_handler;
+			unsigned char d_byte;
+		};
+
+		static const uint32_t npos = 0xffffffff;
+
+		socket&                         d_socket;
+		std::vector<node>               d_nodes;
+		std::vector<uint32_t>           d_free_nodes;
+		std::vector<handler>            d_handlers;
+		std::vector<uint32_t>           d_free_handlers;
+		std::unique_ptr<prefix_matcher> d_matcher;
+		size_t                          d_size;
+		uint64_t                        d_dispatched;
+		uint64_t                        d_unmatched;
+
+	public:
+		// Construct a router for the given SUB socket.
+		explicit subscription_router(socket& s);
+
+		// MANIPULATORS
+
+		// Match topics of exactly the given width with a prefix_matcher using the given
+		// instruction set. Must be called before subscribing.
+		void set_topic_width(size_t width,
+			prefix_matcher::isa i = prefix_matcher::best_isa());
+
+		// Subscribe to a topic, dispatching its messages to the given handler. Subscribing to
+		// a topic again replaces its handler. The empty topic matches every message.
+		void subscribe(const std::string& topic, handler h);
+
+		// Unsubscribe from a topic. Returns false if the router was not subscribed to it.
+		bool unsubscribe(const std::string& topic);
+
+		// Find the handler of the longest topic which is a prefix of the given data. Returns
+		// nullptr if no topic matches.
+		const handler* match(const void* data, size_t size) const;
+
+		// Receive a message and dispatch it to its handler. Returns false if no message was
+		// received, because none was waiting or the receive timed out.
+		bool dispatch(bool dont_wait = true);
+
+		// Get the number of topics subscribed to.
+		size_t size() const { return d_size; }
+
+		// Get the number of messages dispatched to a handler.
+		uint64_t dispatched() const { return d_dispatched; }
+
+		// Get the number of messages received which matched no topic.
+		uint64_t unmatched() const { return d_unmatched; }
+
+	private:
+		// Store a handler, returning its index.
+		uint32_t add_handler(handler h);
+
+		// Free the handler with the given index.
+		void remove_handler(uint32_t i);
+
+		// Find the child of a node for the given byte, returning npos if there is none.
+		uint32_t find_child(uint32_t n, unsigned char byte) const;
+
+		// Find the child of a node for the given byte, adding it if there is none.
+		uint32_t add_child(uint32_t n, unsigned char byte);
+
+		// NOT IMPLEMENTED
+		subscription_router(const subscription_router& other) = delete;
+		subscription_router& operator=(const subscription_router& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/survey.hpp"
+#include "nanomsgpp/exception.hpp"
+#include <nanomsg/nn.h>
+#include <nanomsg/survey.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace nanomsgpp;
+
+namespace {
+
+	typedef std::chrono::steady_clock clock;
+
+	uint64_t elapsed_ns(clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+	}
+
+	// Get a percentile of sorted latencies by the nearest rank method.
+	uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+		if (sorted.empty()) {
+			return (0);
+		}
+		size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+		return (sorted[std::max<size_t>(rank, 1) - 1]);
+	}
+
+}
+
+survey::survey(socket& surveyor)
+	: d_socket(surveyor)
+	, d_deadline(1000)
+	, d_needed(0)
+{
+	d_poller.add_socket(d_socket, poll_event::in);
+	d_deadline = d_socket.get_option<int>(NN_SURVEYOR, socket_option::surveyor_deadline);
+}
+
+void
+survey::set_deadline(int ms) {
+	d_socket.set_option(NN_SURVEYOR, socket_option::surveyor_deadline, ms);
+	d_deadline = ms;
+}
+
+void
+survey::set_quorum(size_t n_respondents, double fraction) {
+	d_needed = static_cast<size_t>(std::ceil(n_respondents * fraction));
+}
+
+survey::result
+survey::run(message&& question, reducer r) {
+	result res = {};
+	d_latencies.clear();
+
+	clock::time_point start = clock::now();
+	clock::time_point deadline = start + std::chrono::milliseconds(d_deadline);
+	d_socket.sendmsg(std::move(question), false);
+
+	int fd = d_socket.get_fd();
+	bool done = false;
+	while (!done) {
+		// take every response which has already arrived before polling again
+		void* body = nullptr;
+		int nb = nn_recv(fd, &body, NN_MSG, NN_DONTWAIT);
+		if (nb >= 0) {
+			d_latencies.push_back(elapsed_ns(start));
+			res.responses++;
+			message_view view(&body, nb, nullptr, 0);
+			try {
+				r(view);
+			} catch (...) {
+				nn_freemsg(body);
+				throw;
+			}
+			nn_freemsg(body);
+			if (d_needed > 0 && res.responses >= d_needed) {
+				res.complete = true;
+				done = true;
+			}
+			continue;
+		}
+
+		// the socket reports the end of the survey with ETIMEDOUT, or EFSM once the survey
+		// has been cancelled
+		int error = nn_errno();
+		if (error == ETIMEDOUT || error == EFSM) {
+			break;
+		} else if (error != EAGAIN) {
+			throw internal_exception();
+		}
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>
+			(deadline - clock::now()).count();
+		if (left < 0) {
+			break;
+		}
+		d_poller.poll(static_cast<int>(left) + 1);
+	}
+	if (0 == d_needed) {
+		res.complete = true;
+	}
+
+	res.elapsed_ns = elapsed_ns(start);
+	std::sort(d_latencies.begin(), d_latencies.end());
+	res.p50_ns = percentile(d_latencies, 0.50);
+	res.p90_ns = percentile(d_latencies, 0.90);
+	res.p99_ns = percentile(d_latencies, 0.99);
+	res.max_ns = d_latencies.empty() ? 0 : d_latencies.back();
+	return (res);
+}
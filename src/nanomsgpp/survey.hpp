@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_SURVEY_HPP_INCLUDED
+#define NANOMSGPP_SURVEY_HPP_INCLUDED
+
+#ifndef NANOMSGPP_SOCKET_HPP_INCLUDED
+#	include "socket.hpp"
+#endif
+#ifndef NANOMSGPP_MESSAGE_VIEW_HPP_INCLUDED
+#	include "message_view.hpp"
+#endif
+#ifndef NANOMSGPP_POLLER_HPP_INCLUDED
+#	include "poller.hpp"
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A survey sends a question on a SURVEYOR socket and streams the responses into a reducer
+	// as they arrive. A survey ends at the surveyor deadline, or as soon as enough responses
+	// have arrived, and reports the latency of the responses it received.
+	class survey {
+	public:
+		// Called with each response, which is freed when the reducer returns.
+		typedef std::function<void(message_view& response)> reducer;
+
+		// The outcome of a survey.
+		struct result {
+			size_t   responses;  // number of responses received
+			bool     complete;   // whether enough responses arrived before the deadline
+			uint64_t elapsed_ns; // time from sending the question to the end of the survey
+			uint64_t p50_ns;     // response latency percentiles
+			uint64_t p90_ns;
+			uint64_t p99_ns;
+			uint64_t max_ns;
+		};
+
+	private:
+		socket&               d_socket;
+		poller                d_poller;
+		int                   d_deadline;
+		size_t                d_needed;
+		std::vector<uint64_t> d_latencies;
+
+	public:
+		// Construct a survey on the given SURVEYOR socket.
+		explicit survey(socket& surveyor);
+
+		// MANIPULATORS
+
+		// Set the survey deadline in milliseconds, which also sets the surveyor_deadline option
+		// of the socket.
+		void set_deadline(int ms);
+
+		// End each survey as soon as k responses have arrived. Zero waits for the deadline.
+		void complete_after(size_t k) { d_needed = k; }
+
+		// End each survey as soon as the given fraction of n_respondents has responded.
+		void set_quorum(size_t n_respondents, double fraction);
+
+		// Send a question and pass each response to the reducer until the survey ends.
+		// Responses arriving after the survey ends are not seen by the next one, because the
+		// surveyor socket discards responses carrying the id of an earlier survey.
+		result run(message&& question, reducer r);
+
+	private:
+		// NOT IMPLEMENTED
+		survey(const survey& other) = delete;
+		survey& operator=(const survey& other) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "nanomsgpp/trace.hpp"
+
+#ifdef NANOMSGPP_HAVE_SDT
+
+// The semaphores a tracer increments while it is attached to a probe.
+extern "C" {
+	volatile unsigned short nanomsgpp_sendmsg_semaphore __attribute__((section(".probes"))) = 0;
+	volatile unsigned short nanomsgpp_recvmsg_semaphore __attribute__((section(".probes"))) = 0;
+	volatile unsigned short nanomsgpp_poll_semaphore __attribute__((section(".probes"))) = 0;
+	volatile unsigned short nanomsgpp_part_alloc_semaphore __attribute__((section(".probes"))) = 0;
+	volatile unsigned short nanomsgpp_device_fwd_semaphore __attribute__((section(".probes"))) = 0;
+}
+
+#endif
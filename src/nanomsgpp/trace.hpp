@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_TRACE_HPP_INCLUDED
+#define NANOMSGPP_TRACE_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+
+// Static user-space (USDT) tracepoints of the nanomsgpp provider, for perf, bpftrace and
+// systemtap. Every probe carries four arguments:
+//
+//   probe         arg0                arg1            arg2    arg3
+//   sendmsg       socket fd           bytes sent      errno   nanoseconds in the call
+//   recvmsg       socket fd           bytes received  errno   nanoseconds in the call
+//   poll          number of sockets   number ready    errno   nanoseconds in the call
+//   part_alloc    1 if nn_allocmsg    bytes           errno   nanoseconds in the call
+//   device_fwd    source socket fd    bytes           errno   nanoseconds from receive to send
+//
+// errno is zero when the call succeeded. A probe is a single nop until a tracer attaches,
+// and the clock is only read while its semaphore shows a tracer is attached, e.g.
+//
+//   bpftrace -e 'usdt:/usr/lib/libnanomsgpp.so:nanomsgpp:recvmsg /arg3 > 1000000/ { ... }'
+//
+// The probes are compiled in when <sys/sdt.h> is available (systemtap-sdt-dev).
+#if defined(__linux__) && defined(__has_include)
+#	if __has_include(<sys/sdt.h>)
+#		define NANOMSGPP_HAVE_SDT
+#	endif
+#endif
+
+#ifdef NANOMSGPP_HAVE_SDT
+#	define _SDT_HAS_SEMAPHORES 1
+#	include <sys/sdt.h>
+
+extern "C" {
+	extern volatile unsigned short nanomsgpp_sendmsg_semaphore;
+	extern volatile unsigned short nanomsgpp_recvmsg_semaphore;
+	extern volatile unsigned short nanomsgpp_poll_semaphore;
+	extern volatile unsigned short nanomsgpp_part_alloc_semaphore;
+	extern volatile unsigned short nanomsgpp_device_fwd_semaphore;
+}
+
+// Check whether a tracer is attached to a probe.
+#	define NANOMSGPP_TRACE_ENABLED(probe) \
+	__builtin_expect(nanomsgpp_##probe##_semaphore != 0, 0)
+
+// Fire a probe.
+#	define NANOMSGPP_TRACE(probe, a0, a1, a2, a3) \
+	STAP_PROBE4(nanomsgpp, probe, a0, a1, a2, a3)
+#else
+#	define NANOMSGPP_TRACE_ENABLED(probe) (false)
+#	define NANOMSGPP_TRACE(probe, a0, a1, a2, a3) \
+	do { if (false) { (void)(a0); (void)(a1); (void)(a2); (void)(a3); } } while (0)
+#endif
+
+namespace nanomsgpp {
+
+	// Read the clock used to time tracepoints and histograms, in nanoseconds.
+	inline int64_t trace_now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_WORKER_POOL_HPP_INCLUDED
+#define NANOMSGPP_WORKER_POOL_HPP_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nanomsgpp {
+
+	// A worker pool runs a consumer over submitted items on a fixed set of threads. Each worker
+	// owns a queue which it drains in FIFO order; an idle worker steals from the back of the
+	// other queues, so a burst landing on one worker is spread over every core.
+	template<typename T>
+	class worker_pool {
+	public:
+		typedef std::function<void(T&)> consumer;
+
+	private:
+		struct queue {
+			std::mutex    d_lock;
+			std::deque<T> d_items;
+		};
+
+		consumer                            d_consumer;
+		std::vector<std::unique_ptr<queue>> d_queues;
+		std::vector<std::thread>            d_threads;
+		std::mutex                          d_lock;
+		std::condition_variable             d_cond;
+		std::atomic<size_t>                 d_pending;
+		std::atomic<size_t>                 d_idle;
+		std::atomic<size_t>                 d_next;
+		std::atomic<uint64_t>               d_steals;
+		bool                                d_stopping;
+
+	public:
+		// Construct a pool of n_workers threads, each running the consumer over the items
+		// submitted to the pool. The consumer must not throw.
+		worker_pool(size_t n_workers, consumer c);
+
+		// Destructor, drains the pool.
+		~worker_pool();
+
+		// MANIPULATORS
+
+		// Submit an item to be consumed by one of the workers.
+		void submit(T&& item);
+
+		// Wait for every submitted item to be consumed and join the workers.
+		void stop();
+
+		// Get the number of workers.
+		size_t size() const { return d_queues.size(); }
+
+		// Get the number of items waiting to be consumed.
+		size_t pending() const { return d_pending.load(); }
+
+		// Get the number of items a worker has stolen from another worker's queue.
+		uint64_t steals() const { return d_steals.load(std::memory_order_relaxed); }
+
+	private:
+		// The loop run by each worker thread.
+		void run(size_t index);
+
+		// Take the next item for the given worker, stealing if its own queue is empty.
+		bool take(size_t index, T& item);
+
+		// NOT IMPLEMENTED
+		worker_pool() = delete;
+		worker_pool(const worker_pool& other) = delete;
+		worker_pool& operator=(const worker_pool& other) = delete;
+	};
+
+	// INLINE FUNCTION DEFINITIONS
+
+	template<typename T>
+	worker_pool<T>::worker_pool(size_t n_workers, consumer c)
+		: d_consumer(std::move(c))
+		, d_pending(0)
+		, d_idle(0)
+		, d_next(0)
+		, d_steals(0)
+		, d_stopping(false)
+	{
+		if (0 == n_workers) {
+			n_workers = 1;
+		}
+		for (size_t i = 0; i < n_workers; ++i) {
+			d_queues.emplace_back(new queue());
+		}
+		for (size_t i = 0; i < n_workers; ++i) {
+			d_threads.emplace_back(&worker_pool::run, this, i);
+		}
+	}
+
+	template<typename T>
+	worker_pool<T>::~worker_pool() {
+		stop();
+	}
+
+	template<typename T>
+	void worker_pool<T>::submit(T&& item) {
+		queue& q = *d_queues[d_next.fetch_add(1, std::memory_order_relaxed) % d_queues.size()];
+		d_pending.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(q.d_lock);
+			q.d_items.push_back(std::move(item));
+		}
+		if (d_idle.load() > 0) {
+			std::lock_guard<std::mutex> lock(d_lock);
+			d_cond.notify_one();
+		}
+	}
+
+	template<typename T>
+	void worker_pool<T>::stop() {
+		{
+			std::lock_guard<std::mutex> lock(d_lock);
+			d_stopping = true;
+		}
+		d_cond.notify_all();
+		for (auto& t : d_threads) {
+			if (t.joinable()) {
+				t.join();
+			}
+		}
+	}
+
+	template<typename T>
+	void worker_pool<T>::run(size_t index) {
+		T item;
+		while (true) {
+			if (take(index, item)) {
+				d_consumer(item);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(d_lock);
+			d_idle.fetch_add(1);
+			d_cond.wait(lock, [this]() { return d_pending.load() > 0 || d_stopping; });
+			d_idle.fetch_sub(1);
+			if (d_stopping && 0 == d_pending.load()) {
+				return;
+			}
+		}
+	}
+
+	template<typename T>
+	bool worker_pool<T>::take(size_t index, T& item) {
+		size_t n = d_queues.size();
+		for (size_t i = 0; i < n; ++i) {
+			queue& q = *d_queues[(index + i) % n];
+			std::lock_guard<std::mutex> lock(q.d_lock);
+			if (q.d_items.empty()) {
+				continue;
+			}
+			if (0 == i) {
+				item = std::move(q.d_items.front());
+				q.d_items.pop_front();
+			} else {
+				item = std::move(q.d_items.back());
+				q.d_items.pop_back();
+				d_steals.fetch_add(1, std::memory_order_relaxed);
+			}
+			d_pending.fetch_sub(1);
+			return (true);
+		}
+		return (false);
+	}
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+#include "alloc_counter.hpp"
+
+#include <nanomsgpp/channel.hpp>
+#include <nanomsgpp/poller.hpp>
+#include <nanomsgpp/socket.hpp>
+#include <nanomsgpp/socket_pool.hpp>
+
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// The number of operations each budget is measured over.
+	const int n_ops = 1000;
+
+	// Allocations nanomsg may make now and then, such as when a queue grows, which are
+	// allowed over a run of n_ops operations so the budgets hold for any nanomsg version.
+	const uint64_t slack = n_ops / 10;
+
+	// Count the allocations made by n_ops calls of op, after warming it up.
+	template<typename Op>
+	uint64_t count(Op op) {
+		for (int i = 0; i < 100; ++i) {
+			op();
+		}
+		test::alloc_counter counter;
+		for (int i = 0; i < n_ops; ++i) {
+			op();
+		}
+		return counter.allocations();
+	}
+
+	struct connected_pair {
+		nn::socket a;
+		nn::socket b;
+
+		explicit connected_pair(const std::string& addr)
+			: a(nn::socket_domain::sp, nn::socket_type::pair)
+			, b(nn::socket_domain::sp, nn::socket_type::pair) {
+			a.bind(addr);
+			b.connect(addr);
+		}
+	};
+
+}
+
+TEST_CASE("recvmsg into a reused message allocates only what nanomsg does", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	connected_pair p("inproc://alloc-recv");
+	std::string body(100, 'x');
+
+	uint64_t raw = count([&]() {
+		nn_send(p.a.get_fd(), body.data(), body.size(), 0);
+		void* chunk = nullptr;
+		nn_recv(p.b.get_fd(), &chunk, NN_MSG, 0);
+		nn_freemsg(chunk);
+	});
+	nn::message msg;
+	uint64_t wrapped = count([&]() {
+		nn_send(p.a.get_fd(), body.data(), body.size(), 0);
+		p.b.recvmsg(msg, false);
+	});
+	REQUIRE(wrapped <= raw + slack);
+	REQUIRE(msg.size() == 1);
+	REQUIRE(msg.at(0).size() == body.size());
+	REQUIRE(std::string(msg.at(0).as<char>(), msg.at(0).size()) == body);
+}
+
+TEST_CASE("sendmsg frees the parts it sends", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	connected_pair p("inproc://alloc-send");
+	std::string body(100, 'x');
+	std::vector<char> buffer(body.size());
+
+	uint64_t raw = count([&]() {
+		nn_send(p.a.get_fd(), body.data(), body.size(), 0);
+		nn_recv(p.b.get_fd(), buffer.data(), buffer.size(), 0);
+	});
+
+	// building the message costs the part list and the part, and sending it the header
+	// and its io vector
+	test::alloc_counter counter;
+	uint64_t wrapped = count([&]() {
+		nn::message msg;
+		msg << body;
+		p.a.sendmsg(std::move(msg), false);
+		nn_recv(p.b.get_fd(), buffer.data(), buffer.size(), 0);
+	});
+	uint64_t allocations = counter.allocations();
+	uint64_t frees = counter.frees();
+	REQUIRE(wrapped <= raw + 4 * n_ops + slack);
+	REQUIRE(frees == allocations);
+}
+
+TEST_CASE("sendmsg hands nn_allocmsg parts to nanomsg", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	connected_pair p("inproc://alloc-send-chunk");
+	std::vector<char> buffer(100);
+
+	// the chunk is freed by nanomsg once it is received, and not again by the message
+	test::alloc_counter counter;
+	count([&]() {
+		nn::message msg;
+		msg << nn::part(buffer.size(), 0);
+		p.a.sendmsg(std::move(msg), false);
+		nn_recv(p.b.get_fd(), buffer.data(), buffer.size(), 0);
+	});
+	uint64_t allocations = counter.allocations();
+	uint64_t frees = counter.frees();
+	REQUIRE(frees == allocations);
+}
+
+TEST_CASE("pooled sends allocate only what nanomsg does", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	nn::socket pull(nn::socket_domain::sp, nn::socket_type::pull);
+	pull.bind("inproc://alloc-pool");
+	nn::socket_pool pool({ "inproc://alloc-pool" }, 2, nn::socket_pool::configurator(),
+		nn::socket_type::push);
+	pool.reserve(2);
+	nn::socket push(nn::socket_domain::sp, nn::socket_type::push);
+	push.connect("inproc://alloc-pool");
+	std::string body(100, 'x');
+	std::vector<char> buffer(body.size());
+
+	uint64_t raw = count([&]() {
+		push.send_raw(body.data(), body.size(), 0);
+		pull.recv_raw(buffer.data(), buffer.size(), 0);
+	});
+	uint64_t pooled = count([&]() {
+		{
+			nn::socket_pool::lease lease = pool.checkout();
+			lease->send_raw(body.data(), body.size(), 0);
+		}
+		pull.recv_raw(buffer.data(), buffer.size(), 0);
+	});
+	REQUIRE(pooled <= raw + slack);
+}
+
+TEST_CASE("poller dispatch allocates only what nanomsg does", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	connected_pair p("inproc://alloc-poll");
+	p.a.send_raw("x", 1, 0);
+	nn_pollfd pfd = { p.b.get_fd(), NN_POLLIN, 0 };
+
+	uint64_t raw = count([&]() {
+		nn_poll(&pfd, 1, 0);
+	});
+	nn::poller poller;
+	poller.add_socket(p.b, nn::poll_event::in);
+	uint64_t polled = count([&]() {
+		poller.poll(0);
+		poller.has_event(p.b, nn::poll_event::in);
+	});
+	REQUIRE(polled <= raw + slack);
+}
+
+TEST_CASE("channels hand prepared messages over without allocating", "[alloc_budget]") {
+	if (!test::alloc_counter::supported()) {
+		WARN("allocations are not counted on this platform");
+		return;
+	}
+	nn::channel c(16, nn::channel::mode::spsc);
+	nn::message msg;
+	msg << std::string(100, 'x');
+
+	uint64_t moved = count([&]() {
+		c.sendmsg(std::move(msg));
+		c.recvmsg(msg);
+	});
+	REQUIRE(moved == 0);
+	REQUIRE(msg.size() == 1);
+	REQUIRE(msg.at(0).size() == 100);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "alloc_counter.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+
+namespace {
+
+	thread_local uint64_t t_allocations = 0;
+	thread_local uint64_t t_frees = 0;
+
+}
+
+#if defined(__GLIBC__)
+// Wrap glibc's allocator for the whole program linking this file, which is the test program
+// and the wrapper benchmark. The wrappers only bump thread local counters, so they do not
+// change what is measured beyond a few cycles per call. This must stay the only definition
+// of the wrappers in a program.
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t n, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void  __libc_free(void* ptr);
+
+	void* malloc(size_t size) {
+		++t_allocations;
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t n, size_t size) {
+		++t_allocations;
+		return __libc_calloc(n, size);
+	}
+
+	void* realloc(void* ptr, size_t size) {
+		if (nullptr == ptr) {
+			++t_allocations;
+		}
+		return __libc_realloc(ptr, size);
+	}
+
+	void free(void* ptr) {
+		if (ptr != nullptr) {
+			++t_frees;
+		}
+		__libc_free(ptr);
+	}
+}
+#endif
+
+namespace test {
+
+	void
+	alloc_counter::reset() {
+		d_allocations = t_allocations;
+		d_frees = t_frees;
+	}
+
+	uint64_t
+	alloc_counter::allocations() const {
+		return t_allocations - d_allocations;
+	}
+
+	uint64_t
+	alloc_counter::frees() const {
+		return t_frees - d_frees;
+	}
+
+	bool
+	alloc_counter::supported() {
+		// an allocation made here is only seen if the wrappers above are in use
+		uint64_t before = t_allocations;
+		void* volatile p = std::malloc(16);
+		std::free(p);
+		return t_allocations != before;
+	}
+
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NANOMSGPP_TEST_ALLOC_COUNTER_HPP_INCLUDED
+#define NANOMSGPP_TEST_ALLOC_COUNTER_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace test {
+
+	// An allocation counter counts the heap allocations and frees made by the current thread
+	// since it was constructed or reset, including those made by nanomsg. Counting relies on
+	// alloc_counter.cpp wrapping glibc's allocator in the program linking it; elsewhere, or when
+	// another tool such as valgrind replaces the allocator, supported() is false and the counts
+	// stay zero.
+	class alloc_counter {
+		uint64_t d_allocations;
+		uint64_t d_frees;
+
+	public:
+		// Default constructor, starts counting.
+		alloc_counter() { reset(); }
+
+		// MANIPULATORS
+
+		// Start counting again from zero.
+		void reset();
+
+		// Get the number of allocations since the counter was reset.
+		uint64_t allocations() const;
+
+		// Get the number of frees since the counter was reset.
+		uint64_t frees() const;
+
+		// Check whether allocations are being counted.
+		static bool supported();
+	};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/bridge.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("bridges batch and split messages", "[bridge]") {
+	nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+	REQUIRE_NOTHROW(producer.connect("inproc://bridge_in"));
+	nn::socket in(nn::socket_domain::sp_raw, nn::socket_type::pull);
+	REQUIRE_NOTHROW(in.bind("inproc://bridge_in"));
+
+	nn::socket wan_out(nn::socket_domain::sp_raw, nn::socket_type::push);
+	REQUIRE_NOTHROW(wan_out.connect("inproc://bridge_wan"));
+	nn::socket wan_in(nn::socket_domain::sp_raw, nn::socket_type::pull);
+	REQUIRE_NOTHROW(wan_in.bind("inproc://bridge_wan"));
+
+	nn::socket out(nn::socket_domain::sp_raw, nn::socket_type::push);
+	REQUIRE_NOTHROW(out.bind("inproc://bridge_out"));
+	nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+	REQUIRE_NOTHROW(consumer.connect("inproc://bridge_out"));
+	consumer.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::bridge batcher(in, wan_out, nn::bridge::mode::batch);
+	batcher.set_poll_interval(10);
+	nn::bridge splitter(wan_in, out, nn::bridge::mode::split);
+	splitter.set_poll_interval(10);
+
+	SECTION("messages arrive in order") {
+		batcher.set_max_latency(5000);
+		batcher.start();
+		splitter.start();
+
+		for (uint32_t i = 0; i < 100; ++i) {
+			nn::message m;
+			m << i;
+			producer.sendmsg(std::move(m), false);
+		}
+		for (uint32_t i = 0; i < 100; ++i) {
+			REQUIRE(*consumer.recvmsg(1, false)->at(0).as<uint32_t>() == i);
+		}
+
+		batcher.stop();
+		splitter.stop();
+		nn::bridge::statistics b = batcher.get_statistics();
+		REQUIRE(b.messages_in == 100);
+		REQUIRE(b.bytes_in == 100 * sizeof(uint32_t));
+		REQUIRE(b.batches >= 1);
+		REQUIRE(b.batches == b.messages_out);
+		REQUIRE(b.flushed_by_stop == 0);
+		uint64_t flushed = b.flushed_by_size + b.flushed_by_time;
+		REQUIRE(flushed == b.batches);
+		REQUIRE(b.batch_sizes.size() == nn::bridge::n_buckets);
+		REQUIRE(std::accumulate(b.batch_sizes.begin(), b.batch_sizes.end(), uint64_t(0)) == b.batches);
+
+		nn::bridge::statistics s = splitter.get_statistics();
+		REQUIRE(s.messages_in == b.messages_out);
+		REQUIRE(s.messages_out == 100);
+		REQUIRE(s.errors == 0);
+	}
+	SECTION("batches are bounded by size") {
+		batcher.set_max_batch_size(64);
+		batcher.set_max_latency(100000);
+		for (uint32_t i = 0; i < 20; ++i) {
+			nn::message m;
+			m << uint64_t(i);
+			producer.sendmsg(std::move(m), false);
+		}
+		batcher.start();
+		splitter.start();
+
+		for (uint32_t i = 0; i < 20; ++i) {
+			REQUIRE(*consumer.recvmsg(1, false)->at(0).as<uint64_t>() == i);
+		}
+		batcher.stop();
+		splitter.stop();
+		REQUIRE(batcher.get_statistics().flushed_by_size > 0);
+	}
+	SECTION("stopping sends the pending batch") {
+		batcher.set_max_latency(10000000);
+		batcher.start();
+		splitter.start();
+		for (uint32_t i = 0; i < 3; ++i) {
+			nn::message m;
+			m << i;
+			producer.sendmsg(std::move(m), false);
+		}
+		while (batcher.get_statistics().messages_in < 3) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		batcher.stop();
+
+		for (uint32_t i = 0; i < 3; ++i) {
+			REQUIRE(*consumer.recvmsg(1, false)->at(0).as<uint32_t>() == i);
+		}
+		splitter.stop();
+		nn::bridge::statistics b = batcher.get_statistics();
+		REQUIRE(b.flushed_by_stop == 1);
+		REQUIRE(b.flushed_by_time == 0);
+	}
+	SECTION("malformed frames are counted") {
+		splitter.start();
+		nn::socket raw(nn::socket_domain::sp, nn::socket_type::push);
+		REQUIRE_NOTHROW(raw.connect("inproc://bridge_wan"));
+		nn::message m;
+		m << uint32_t(0);
+		raw.sendmsg(std::move(m), false);
+
+		REQUIRE_THROWS(consumer.recvmsg(1, false));
+		splitter.stop();
+		REQUIRE(splitter.get_statistics().errors == 1);
+	}
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/channel.hpp>
+#include <nanomsgpp/poller.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	nn::message make(int i) {
+		nn::message msg;
+		msg << i;
+		return msg;
+	}
+
+	int value(nn::message& msg) {
+		return *msg.at(0).as<int>();
+	}
+
+}
+
+TEST_CASE("channels move messages in order", "[channel]") {
+	for (nn::channel::mode mode : { nn::channel::mode::spsc, nn::channel::mode::mpmc }) {
+		nn::channel c(3, mode);
+		REQUIRE(c.capacity() == 4);
+		REQUIRE(c.get_mode() == mode);
+		REQUIRE(c.recvmsg() == nullptr);
+		REQUIRE(c.writable());
+		REQUIRE(!c.readable());
+
+		for (int lap = 0; lap < 3; ++lap) {
+			for (int i = 0; i < 4; ++i) {
+				REQUIRE(c.sendmsg(make(i)) == sizeof(int));
+			}
+			REQUIRE(!c.writable());
+
+			// a message which does not fit stays with the caller
+			nn::message extra = make(4);
+			REQUIRE(c.sendmsg(std::move(extra)) == -1);
+			REQUIRE(value(extra) == 4);
+
+			for (int i = 0; i < 4; ++i) {
+				REQUIRE(c.readable());
+				std::unique_ptr<nn::message> msg = c.recvmsg();
+				REQUIRE(msg != nullptr);
+				REQUIRE(value(*msg) == i);
+			}
+			REQUIRE(!c.readable());
+		}
+
+		// the parts are moved, not copied
+		nn::message msg;
+		msg << std::string("zero copy");
+		void* body = msg.at(0).as<void>();
+		c.sendmsg(std::move(msg));
+		nn::message received;
+		REQUIRE(c.recvmsg(received));
+		REQUIRE(received.at(0).as<void>() == body);
+	}
+}
+
+TEST_CASE("channels block until they can be used", "[channel]") {
+	nn::channel c(2, nn::channel::mode::spsc);
+	c.set_timeout(20);
+	REQUIRE(c.recvmsg(false) == nullptr);
+	c.sendmsg(make(0));
+	c.sendmsg(make(1));
+	REQUIRE(c.sendmsg(make(2), false) == -1);
+
+	c.set_timeout(-1);
+	std::thread receiver([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		for (int i = 0; i < 3; ++i) {
+			std::unique_ptr<nn::message> msg = c.recvmsg(false);
+			REQUIRE(value(*msg) == i);
+		}
+	});
+	REQUIRE(c.sendmsg(make(2), false) == sizeof(int));
+	receiver.join();
+}
+
+TEST_CASE("mpmc channels deliver every message once", "[channel]") {
+	nn::channel c(64, nn::channel::mode::mpmc);
+	const int n_threads = 4;
+	const int n = 20000;
+	std::atomic<long long> sum(0);
+	std::atomic<int> received(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < n_threads; ++t) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < n; ++i) {
+				c.sendmsg(make(t * n + i), false);
+			}
+		});
+		threads.emplace_back([&]() {
+			nn::message msg;
+			while (received.load() < n_threads * n) {
+				if (c.recvmsg(msg)) {
+					sum += value(msg);
+					received++;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	long long total = static_cast<long long>(n_threads) * n;
+	REQUIRE(received.load() == total);
+	REQUIRE(sum.load() == total * (total - 1) / 2);
+}
+
+TEST_CASE("channels can be polled with sockets", "[channel]") {
+	nn::channel c(8);
+	nn::socket s1(nn::socket_domain::sp, nn::socket_type::pair);
+	nn::socket s2(nn::socket_domain::sp, nn::socket_type::pair);
+	s1.bind("inproc://channel-poll");
+	s2.connect("inproc://channel-poll");
+
+	nn::poller poller;
+	poller.add_channel(c, nn::poll_event::in);
+	poller.add_socket(s2, nn::poll_event::in);
+	REQUIRE(!poller.poll(20));
+
+	c.sendmsg(make(1));
+	REQUIRE(poller.poll(0));
+	REQUIRE(poller.has_event(c, nn::poll_event::in));
+	REQUIRE(!poller.has_event(s2, nn::poll_event::in));
+	c.recvmsg();
+
+	// a message sent while the poller waits wakes it
+	std::thread sender([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		c.sendmsg(make(2));
+	});
+	auto start = std::chrono::steady_clock::now();
+	REQUIRE(poller.poll(5000));
+	bool prompt = std::chrono::steady_clock::now() - start < std::chrono::seconds(2);
+	REQUIRE(prompt);
+	REQUIRE(poller.has_event(c, nn::poll_event::in));
+	sender.join();
+	c.recvmsg();
+
+	s1.send_raw("x", 1, 0);
+	REQUIRE(poller.poll(1000));
+	REQUIRE(poller.has_event(s2, nn::poll_event::in));
+	REQUIRE(!poller.has_event(c, nn::poll_event::in));
+
+	poller.remove_channel(c);
+	REQUIRE(!poller.has_event(c, nn::poll_event::in));
+}
+
+TEST_CASE("channels on the heap keep their alignment", "[channel]") {
+	std::unique_ptr<nn::channel> c(new nn::channel(8));
+	bool aligned = reinterpret_cast<uintptr_t>(c.get()) % alignof(nn::channel) == 0;
+	REQUIRE(aligned);
+
+	// a copied poller watches the same channel
+	nn::poller p1;
+	p1.add_channel(*c, nn::poll_event::in);
+	nn::poller p2(p1);
+	c->sendmsg(make(1));
+	REQUIRE(p2.poll(0));
+	REQUIRE(p2.has_event(*c, nn::poll_event::in));
+	p1.remove_channel(*c);
+	REQUIRE(p2.poll(0));
+}
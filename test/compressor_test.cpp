@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/bridge.hpp>
+#include <nanomsgpp/compressor.hpp>
+#include <nanomsgpp/device.hpp>
+#include <nanomsgpp/lz_codec.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Text with enough repetition to compress well.
+	std::string sample(size_t n) {
+		std::string s;
+		for (size_t i = 0; s.size() < n; ++i) {
+			s += "{\"topic\":\"prices\",\"seq\":" + std::to_string(i) + ",\"bid\":101.25},";
+		}
+		s.resize(n);
+		return s;
+	}
+
+	nn::message make_message(const std::string& s) {
+		nn::message m;
+		m << nn::part(s.data(), s.size());
+		return m;
+	}
+
+	std::string body(std::unique_ptr<nn::message> m) {
+		return std::string(m->at(0).as<char>(), m->at(0).size());
+	}
+
+}
+
+TEST_CASE("lz codec round trips", "[compressor]") {
+	nn::lz_codec codec;
+	std::vector<std::string> inputs = { "", "a", "abcabcabcabcabcabcabc", sample(100), sample(70000) };
+	std::string noise;
+	for (int i = 0; i < 5000; ++i) {
+		noise += static_cast<char>((i * 2654435761u) >> 24);
+	}
+	inputs.push_back(noise);
+
+	for (auto& in : inputs) {
+		std::vector<char> packed(nn::lz_codec::max_compressed_size(in.size()));
+		size_t n = codec.compress(in.data(), in.size(), packed.data());
+		REQUIRE(n <= packed.size());
+
+		std::vector<char> out(in.size() + 1);
+		size_t size = 0;
+		REQUIRE(nn::lz_codec::decompress(packed.data(), n, out.data(), in.size(), size));
+		REQUIRE(size == in.size());
+		REQUIRE(std::string(out.data(), size) == in);
+	}
+
+	SECTION("repetitive data shrinks") {
+		std::string in = sample(70000);
+		std::vector<char> packed(nn::lz_codec::max_compressed_size(in.size()));
+		REQUIRE(codec.compress(in.data(), in.size(), packed.data()) < in.size() / 2);
+	}
+	SECTION("truncated input is detected") {
+		std::string in = sample(1000);
+		std::vector<char> packed(nn::lz_codec::max_compressed_size(in.size()));
+		size_t n = codec.compress(in.data(), in.size(), packed.data());
+		std::vector<char> out(in.size());
+		size_t size;
+		// a block cut after a run of literals is well formed, but comes up short
+		bool ok = nn::lz_codec::decompress(packed.data(), n / 2, out.data(), out.size(), size);
+		REQUIRE_FALSE((ok && size == in.size()));
+		REQUIRE_FALSE(nn::lz_codec::decompress(packed.data(), n, out.data(), out.size() / 2, size));
+	}
+}
+
+TEST_CASE("compressor hooks compress device hops", "[compressor]") {
+	nn::socket s1(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s1.bind("inproc://compress_a"));
+	nn::socket s2(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s2.bind("inproc://compress_b"));
+	nn::socket s3(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s3.connect("inproc://compress_b"));
+	nn::socket s4(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s4.bind("inproc://compress_c"));
+
+	nn::socket c1(nn::socket_domain::sp, nn::socket_type::pair);
+	REQUIRE_NOTHROW(c1.connect("inproc://compress_a"));
+	nn::socket c2(nn::socket_domain::sp, nn::socket_type::pair);
+	REQUIRE_NOTHROW(c2.connect("inproc://compress_c"));
+	c2.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	// c1 -> s1 [compress] s2 -> s3 [decompress] s4 -> c2
+	nn::compressor near(64);
+	nn::compressor far;
+	nn::device d1(s1, s2);
+	d1.set_poll_interval(10);
+	d1.add_hook(near.compress_hook(nn::device::direction::a_to_b));
+	nn::device d2(s3, s4);
+	d2.set_poll_interval(10);
+	d2.add_hook(far.decompress_hook(nn::device::direction::a_to_b));
+	d1.start();
+	d2.start();
+
+	std::string large = sample(4096);
+	std::string small = "tick";
+	c1.sendmsg(make_message(large), false);
+	c1.sendmsg(make_message(small), false);
+	REQUIRE(body(c2.recvmsg(1, false)) == large);
+	REQUIRE(body(c2.recvmsg(1, false)) == small);
+
+	d1.stop();
+	d2.stop();
+	nn::compressor::statistics s = near.get_statistics();
+	REQUIRE(s.messages == 2);
+	REQUIRE(s.compressed == 1);
+	REQUIRE(s.bytes_in == large.size() + small.size());
+	REQUIRE(s.bytes_out < s.bytes_in);
+	REQUIRE(s.ratio() > 1.0);
+	REQUIRE(d1.get_counters(nn::device::direction::a_to_b).bytes < large.size());
+
+	nn::compressor::statistics f = far.get_statistics();
+	REQUIRE(f.decompressed == 1);
+	REQUIRE(f.decompress_bytes == large.size());
+	REQUIRE(f.errors == 0);
+}
+
+TEST_CASE("compressor hooks pass small messages through in place", "[compressor]") {
+	nn::compressor c(64);
+	nn::device::hook compress = c.compress_hook(nn::device::direction::a_to_b);
+	nn::device::hook decompress = c.decompress_hook(nn::device::direction::a_to_b);
+
+	std::string small = "tick";
+	void* chunk = nn_allocmsg(small.size(), 0);
+	std::memcpy(chunk, small.data(), small.size());
+	nn::message_view view(&chunk, small.size(), nullptr, 0);
+
+	REQUIRE(compress(nn::device::direction::a_to_b, view));
+	REQUIRE(view.size() == small.size() + 1);
+	REQUIRE(view.data()[0] == 0);
+	REQUIRE(std::string(reinterpret_cast<char*>(view.data()) + 1, small.size()) == small);
+
+	REQUIRE(decompress(nn::device::direction::a_to_b, view));
+	REQUIRE(std::string(reinterpret_cast<char*>(view.data()), view.size()) == small);
+	REQUIRE(c.get_statistics().compressed == 0);
+	nn_freemsg(chunk);
+}
+
+TEST_CASE("compressor drops malformed messages", "[compressor]") {
+	nn::compressor c;
+	nn::device::hook h = c.decompress_hook(nn::device::direction::a_to_b);
+
+	std::vector<std::vector<unsigned char>> inputs = {
+		{},                              // no method byte
+		{ 7, 1, 2, 3 },                  // unknown method
+		{ 1, 0, 1 },                     // truncated size
+		{ 1, 0xff, 0xff, 0xff, 0x7f, 0 } // size larger than the data can expand to
+	};
+	for (auto& in : inputs) {
+		void* chunk = nn_allocmsg(in.size(), 0);
+		std::memcpy(chunk, in.data(), in.size());
+		nn::message_view view(&chunk, in.size(), nullptr, 0);
+		REQUIRE_FALSE(h(nn::device::direction::a_to_b, view));
+		nn_freemsg(chunk);
+	}
+	REQUIRE(c.get_statistics().errors == inputs.size());
+
+	SECTION("other directions pass through") {
+		unsigned char junk = 7;
+		void* chunk = nn_allocmsg(1, 0);
+		std::memcpy(chunk, &junk, 1);
+		nn::message_view view(&chunk, 1, nullptr, 0);
+		REQUIRE(h(nn::device::direction::b_to_a, view));
+		nn_freemsg(chunk);
+	}
+}
+
+TEST_CASE("bridges compress batches", "[compressor]") {
+	nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+	REQUIRE_NOTHROW(producer.connect("inproc://cbridge_in"));
+	nn::socket in(nn::socket_domain::sp_raw, nn::socket_type::pull);
+	REQUIRE_NOTHROW(in.bind("inproc://cbridge_in"));
+
+	nn::socket wan_out(nn::socket_domain::sp_raw, nn::socket_type::push);
+	REQUIRE_NOTHROW(wan_out.connect("inproc://cbridge_wan"));
+	nn::socket wan_in(nn::socket_domain::sp_raw, nn::socket_type::pull);
+	REQUIRE_NOTHROW(wan_in.bind("inproc://cbridge_wan"));
+
+	nn::socket out(nn::socket_domain::sp_raw, nn::socket_type::push);
+	REQUIRE_NOTHROW(out.bind("inproc://cbridge_out"));
+	nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+	REQUIRE_NOTHROW(consumer.connect("inproc://cbridge_out"));
+	consumer.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::compressor near;
+	nn::compressor far;
+	nn::bridge batcher(in, wan_out, nn::bridge::mode::batch);
+	batcher.set_poll_interval(10);
+	batcher.set_max_latency(5000);
+	batcher.set_compressor(near);
+	nn::bridge splitter(wan_in, out, nn::bridge::mode::split);
+	splitter.set_poll_interval(10);
+	splitter.set_compressor(far);
+
+	std::vector<std::string> sent;
+	for (size_t i = 0; i < 50; ++i) {
+		sent.push_back(sample(100 + i));
+		producer.sendmsg(make_message(sent.back()), false);
+	}
+	batcher.start();
+	splitter.start();
+	for (auto& s : sent) {
+		REQUIRE(body(consumer.recvmsg(1, false)) == s);
+	}
+	batcher.stop();
+	splitter.stop();
+
+	nn::bridge::statistics b = batcher.get_statistics();
+	REQUIRE(b.bytes_out < b.bytes_in);
+	REQUIRE(near.get_statistics().compressed >= 1);
+	REQUIRE(far.get_statistics().decompressed == near.get_statistics().compressed);
+	REQUIRE(splitter.get_statistics().errors == 0);
+}
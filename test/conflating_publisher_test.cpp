@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/conflating_publisher.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	std::string receive(nn::socket& s) {
+		std::unique_ptr<nn::message> m = s.recvmsg(1, false);
+		return std::string(m->at(0).as<char>(), m->at(0).size());
+	}
+
+	void publish(nn::conflating_publisher& p, const std::string& topic, const std::string& value) {
+		std::string body = topic + value;
+		p.publish(body.data(), body.size(), topic.size());
+	}
+
+}
+
+TEST_CASE("conflating publisher sends the latest value per topic", "[conflating_publisher]") {
+	nn::socket pub(nn::socket_domain::sp, nn::socket_type::publish);
+	REQUIRE_NOTHROW(pub.bind("inproc://conflate"));
+	nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+	REQUIRE_NOTHROW(sub.connect("inproc://conflate"));
+	sub.set_option(NN_SUB, nn::socket_option::sub_subscribe, "");
+	sub.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::conflating_publisher publisher(pub);
+
+	SECTION("updates within a window are conflated") {
+		publish(publisher, "EUR:", "1.10");
+		publish(publisher, "GBP:", "1.30");
+		publish(publisher, "EUR:", "1.11");
+		publish(publisher, "EUR:", "1.12");
+		publisher.flush();
+		REQUIRE(receive(sub) == "EUR:1.12");
+		REQUIRE(receive(sub) == "GBP:1.30");
+
+		publish(publisher, "GBP:", "1.31");
+		publisher.flush();
+		REQUIRE(receive(sub) == "GBP:1.31");
+		publisher.flush();
+		REQUIRE_THROWS(sub.recvmsg(1, true));
+
+		nn::conflating_publisher::statistics s = publisher.get_statistics();
+		REQUIRE(s.published == 5);
+		REQUIRE(s.conflated == 2);
+		REQUIRE(s.sent == 3);
+		REQUIRE(s.topics == 2);
+	}
+	SECTION("the table grows with the topics") {
+		const int n = 1000;
+		for (int round = 0; round < 2; ++round) {
+			for (int i = 0; i < n; ++i) {
+				publish(publisher, "T" + std::to_string(i) + ":", std::to_string(round));
+			}
+		}
+		publisher.flush();
+		for (int i = 0; i < n; ++i) {
+			REQUIRE(receive(sub) == "T" + std::to_string(i) + ":1");
+		}
+		REQUIRE(publisher.get_statistics().topics == n);
+		REQUIRE(publisher.get_statistics().conflated == n);
+	}
+	SECTION("the publisher thread flushes every window") {
+		publisher.set_window(5);
+		publisher.start();
+		publish(publisher, "EUR:", "1.10");
+		REQUIRE(receive(sub) == "EUR:1.10");
+		publisher.stop();
+	}
+	SECTION("late joiners request a snapshot") {
+		nn::socket rep(nn::socket_domain::sp, nn::socket_type::reply);
+		REQUIRE_NOTHROW(rep.bind("inproc://conflate_snapshot"));
+		nn::socket req(nn::socket_domain::sp, nn::socket_type::request);
+		REQUIRE_NOTHROW(req.connect("inproc://conflate_snapshot"));
+		req.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		publish(publisher, "EUR:", "1.10");
+		publish(publisher, "EUR:", "1.12");
+		publish(publisher, "GBP:", "1.30");
+		publish(publisher, "JPY:", "0.0061");
+		publisher.serve_snapshots(rep);
+		publisher.start();
+
+		std::vector<std::string> values;
+		auto collect = [&values](const void* body, size_t size) {
+			values.push_back(std::string(static_cast<const char*>(body), size));
+		};
+		REQUIRE(nn::conflating_publisher::request_snapshot(req, "EUR:", collect) == 1);
+		REQUIRE(values == std::vector<std::string>({ "EUR:1.12" }));
+
+		values.clear();
+		REQUIRE(nn::conflating_publisher::request_snapshot(req, "", collect) == 3);
+		REQUIRE(values.size() == 3);
+		publisher.stop();
+		REQUIRE(publisher.get_statistics().snapshots == 2);
+	}
+}
+
+TEST_CASE("conflating publisher needs a publish socket", "[conflating_publisher]") {
+	nn::socket push(nn::socket_domain::sp, nn::socket_type::push);
+	REQUIRE_THROWS(nn::conflating_publisher publisher(push));
+
+	nn::socket pub(nn::socket_domain::sp, nn::socket_type::publish);
+	nn::conflating_publisher publisher(pub);
+	REQUIRE_THROWS(publisher.publish("EUR", 3, 4));
+}
@@ -25,6 +25,7 @@
 #include <nanomsgpp/device.hpp>
 #include <nanomsgpp/socket.hpp>
 
+#include <chrono>
 #include <thread>
 
 namespace nn = nanomsgpp;
@@ -37,12 +38,222 @@ TEST_CASE("devices can be created", "[device]") {
 		nn::socket s2(nn::socket_domain::sp_raw, nn::socket_type::pair);
 		REQUIRE_NOTHROW(s2.bind("inproc://testb"));
 
-//		std::thread t1([&]() {
-//			REQUIRE_THROWS(nn::device d(s1, s2));
-//		});
+		nn::device d(s1, s2);
+		REQUIRE(false == d.running());
+	}
+	SECTION("start and stop") {
+		nn::socket s1(nn::socket_domain::sp_raw, nn::socket_type::pair);
+		REQUIRE_NOTHROW(s1.bind("inproc://testa"));
+
+		nn::socket s2(nn::socket_domain::sp_raw, nn::socket_type::pair);
+		REQUIRE_NOTHROW(s2.bind("inproc://testb"));
+
+		nn::device d(s1, s2, 2);
+		d.set_poll_interval(10);
+		REQUIRE_NOTHROW(d.start());
+		REQUIRE(true == d.running());
+
+		std::thread t1([&]() { d.wait(); });
+		d.stop();
+		t1.join();
+		REQUIRE(false == d.running());
+	}
+}
+
+TEST_CASE("devices forward messages", "[device]") {
+	nn::socket s1(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s1.bind("inproc://testa"));
+
+	nn::socket c1(nn::socket_domain::sp, nn::socket_type::pair);
+	REQUIRE_NOTHROW(c1.connect("inproc://testa"));
+	c1.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	SECTION("in both directions") {
+		nn::socket s2(nn::socket_domain::sp_raw, nn::socket_type::pair);
+		REQUIRE_NOTHROW(s2.bind("inproc://testb"));
+
+		nn::socket c2(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(c2.connect("inproc://testb"));
+		c2.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		nn::device d(s1, s2);
+		d.set_poll_interval(10);
+		d.start();
+
+		for (uint32_t i = 0; i < 10; ++i) {
+			nn::message m;
+			m << i;
+			c1.sendmsg(std::move(m), false);
+			REQUIRE(*c2.recvmsg(1, false)->at(0).as<uint32_t>() == i);
+		}
+		nn::message m;
+		m << uint64_t(1);
+		c2.sendmsg(std::move(m), false);
+		REQUIRE(*c1.recvmsg(1, false)->at(0).as<uint64_t>() == 1);
+
+		d.stop();
+		nn::device::counters a_to_b = d.get_counters(nn::device::direction::a_to_b);
+		REQUIRE(a_to_b.messages == 10);
+		REQUIRE(a_to_b.bytes == 10 * sizeof(uint32_t));
+		REQUIRE(a_to_b.dropped == 0);
+		nn::device::counters b_to_a = d.get_counters(nn::device::direction::b_to_a);
+		REQUIRE(b_to_a.messages == 1);
+		REQUIRE(b_to_a.bytes == sizeof(uint64_t));
+	}
+	SECTION("in loopback mode") {
+		nn::socket s2(-1);
+
+		nn::device d(s1, s2);
+		d.set_poll_interval(10);
+		d.start();
+
+		nn::message m;
+		m << uint32_t(1234);
+		c1.sendmsg(std::move(m), false);
+		REQUIRE(*c1.recvmsg(1, false)->at(0).as<uint32_t>() == 1234);
+
+		d.stop();
+		REQUIRE(d.get_counters(nn::device::direction::a_to_b).messages == 1);
+	}
+}
 
-		s2.close();
-		s1.close();
-//		t1.join();
+TEST_CASE("device hooks see messages in place", "[device]") {
+	nn::socket s1(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s1.bind("inproc://testa"));
+	nn::socket s2(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	REQUIRE_NOTHROW(s2.bind("inproc://testb"));
+
+	nn::socket c1(nn::socket_domain::sp, nn::socket_type::pair);
+	REQUIRE_NOTHROW(c1.connect("inproc://testa"));
+	nn::socket c2(nn::socket_domain::sp, nn::socket_type::pair);
+	REQUIRE_NOTHROW(c2.connect("inproc://testb"));
+	c2.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::device d(s1, s2);
+	d.set_poll_interval(10);
+
+	SECTION("filter and transform") {
+		d.add_hook([](nn::device::direction dir, nn::message_view& msg) {
+			return dir == nn::device::direction::a_to_b && (*msg.as<uint32_t>() % 2) == 0;
+		});
+		d.add_hook([](nn::device::direction, nn::message_view& msg) {
+			*msg.as<uint32_t>() += 1000;
+			return true;
+		});
+		d.start();
+
+		for (uint32_t i = 0; i < 10; ++i) {
+			nn::message m;
+			m << i;
+			c1.sendmsg(std::move(m), false);
+		}
+		for (uint32_t i = 0; i < 10; i += 2) {
+			REQUIRE(*c2.recvmsg(1, false)->at(0).as<uint32_t>() == i + 1000);
+		}
+
+		d.stop();
+		nn::device::counters c = d.get_counters(nn::device::direction::a_to_b);
+		REQUIRE(c.messages == 5);
+		REQUIRE(c.filtered == 5);
+	}
+	SECTION("replace the body") {
+		d.add_hook([](nn::device::direction, nn::message_view& msg) {
+			void* chunk = nn_allocmsg(sizeof(uint64_t), 0);
+			*static_cast<uint64_t*>(chunk) = *msg.as<uint32_t>();
+			msg.replace(chunk, sizeof(uint64_t));
+			return true;
+		});
+		d.start();
+
+		nn::message m;
+		m << uint32_t(1234);
+		c1.sendmsg(std::move(m), false);
+		REQUIRE(*c2.recvmsg(1, false)->at(0).as<uint64_t>() == 1234);
+
+		d.stop();
+		REQUIRE(d.get_counters(nn::device::direction::a_to_b).bytes == sizeof(uint64_t));
+	}
+	SECTION("tee to a third socket") {
+		nn::socket tap(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(tap.bind("inproc://testc"));
+		nn::socket c3(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(c3.connect("inproc://testc"));
+		c3.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		d.add_hook(nn::device::tee(tap));
+		d.start();
+
+		nn::message m;
+		m << uint32_t(1234);
+		c1.sendmsg(std::move(m), false);
+		REQUIRE(*c2.recvmsg(1, false)->at(0).as<uint32_t>() == 1234);
+		REQUIRE(*c3.recvmsg(1, false)->at(0).as<uint32_t>() == 1234);
+	}
+	SECTION("tee one direction") {
+		nn::socket tap(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(tap.bind("inproc://testc"));
+		nn::socket c3(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(c3.connect("inproc://testc"));
+		c3.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+		c1.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		d.add_hook(nn::device::tee(tap, nn::device::direction::b_to_a));
+		d.start();
+
+		nn::message m1;
+		m1 << uint32_t(1);
+		c1.sendmsg(std::move(m1), false);
+		REQUIRE(*c2.recvmsg(1, false)->at(0).as<uint32_t>() == 1);
+		nn::message m2;
+		m2 << uint32_t(2);
+		c2.sendmsg(std::move(m2), false);
+		REQUIRE(*c1.recvmsg(1, false)->at(0).as<uint32_t>() == 2);
+
+		// only the second message was mirrored
+		REQUIRE(*c3.recvmsg(1, false)->at(0).as<uint32_t>() == 2);
+	}
+}
+
+TEST_CASE("devices retry messages with protocol headers", "[device]") {
+	nn::socket front(nn::socket_domain::sp_raw, nn::socket_type::reply);
+	REQUIRE_NOTHROW(front.bind("inproc://retry_front"));
+	nn::socket back(nn::socket_domain::sp_raw, nn::socket_type::request);
+	REQUIRE_NOTHROW(back.bind("inproc://retry_back"));
+
+	nn::socket client(nn::socket_domain::sp, nn::socket_type::request);
+	REQUIRE_NOTHROW(client.connect("inproc://retry_front"));
+	client.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::device d(front, back);
+	d.set_poll_interval(10);
+	d.set_drain_timeout(20);
+	d.start();
+
+	// no worker is connected yet, so the device keeps retrying the request
+	nn::message request;
+	request << uint32_t(7);
+	client.sendmsg(std::move(request), false);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	SECTION("until a worker connects") {
+		nn::socket worker(nn::socket_domain::sp, nn::socket_type::reply);
+		REQUIRE_NOTHROW(worker.connect("inproc://retry_back"));
+		worker.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		REQUIRE(*worker.recvmsg(1, false)->at(0).as<uint32_t>() == 7);
+		nn::message reply;
+		reply << uint32_t(8);
+		worker.sendmsg(std::move(reply), false);
+		REQUIRE(*client.recvmsg(1, false)->at(0).as<uint32_t>() == 8);
+
+		d.stop();
+		REQUIRE(d.get_counters(nn::device::direction::a_to_b).messages == 1);
+		REQUIRE(d.get_counters(nn::device::direction::b_to_a).messages == 1);
+	}
+	SECTION("until the drain timeout expires") {
+		d.stop();
+		nn::device::counters a_to_b = d.get_counters(nn::device::direction::a_to_b);
+		REQUIRE(a_to_b.messages == 0);
+		REQUIRE(a_to_b.dropped == 1);
 	}
 }
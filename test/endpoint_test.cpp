@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/channel.hpp>
+#include <nanomsgpp/endpoint.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <memory>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Check that a pair of endpoints hands messages over and reports an empty endpoint the
+	// way a socket does.
+	void check_pair(nn::endpoint& out, nn::endpoint& in) {
+		nn::message m1;
+		m1 << uint32_t(1);
+		REQUIRE(out.sendmsg(std::move(m1)) == sizeof(uint32_t));
+		std::unique_ptr<nn::message> r1 = in.recvmsg(false);
+		REQUIRE(*r1->at(0).as<uint32_t>() == 1);
+
+		nn::message m2;
+		m2 << uint32_t(2);
+		out.sendmsg(std::move(m2));
+		nn::message r2;
+		in.recvmsg(r2, false);
+		REQUIRE(*r2.at(0).as<uint32_t>() == 2);
+
+		int error = 0;
+		try {
+			in.recvmsg();
+		} catch (nn::internal_exception &e) {
+			error = e.error();
+		}
+		REQUIRE(error == EAGAIN);
+	}
+
+}
+
+TEST_CASE("endpoints hide whether they wrap a socket or a channel", "[endpoint]") {
+	SECTION("socket") {
+		nn::socket s1(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(s1.bind("inproc://endpoint"));
+		nn::socket s2(nn::socket_domain::sp, nn::socket_type::pair);
+		REQUIRE_NOTHROW(s2.connect("inproc://endpoint"));
+		s2.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+		std::unique_ptr<nn::endpoint> out = nn::endpoint::wrap(s1);
+		std::unique_ptr<nn::endpoint> in = nn::endpoint::wrap(s2);
+		check_pair(*out, *in);
+	}
+	SECTION("channel") {
+		nn::channel c(4);
+		c.set_timeout(1000);
+
+		std::unique_ptr<nn::endpoint> out = nn::endpoint::wrap(c);
+		std::unique_ptr<nn::endpoint> in = nn::endpoint::wrap(c);
+		check_pair(*out, *in);
+	}
+	SECTION("full channel") {
+		nn::channel c(1);
+		c.set_timeout(10);
+		std::unique_ptr<nn::endpoint> out = nn::endpoint::wrap(c);
+
+		for (size_t i = 0; i < c.capacity(); ++i) {
+			nn::message m1;
+			m1 << uint32_t(1);
+			out->sendmsg(std::move(m1));
+		}
+		nn::message m2;
+		m2 << uint32_t(2);
+		int error = 0;
+		try {
+			out->sendmsg(std::move(m2), false);
+		} catch (nn::internal_exception &e) {
+			error = e.error();
+		}
+		REQUIRE(error == ETIMEDOUT);
+
+		// the message which was not sent is left with the caller
+		REQUIRE(*m2.at(0).as<uint32_t>() == 2);
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/histogram.hpp>
+
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("histograms count values in log-linear buckets", "[histogram]") {
+	SECTION("buckets cover every value") {
+		REQUIRE(nn::histogram::bucket_of(0) == 0);
+		REQUIRE(nn::histogram::bucket_of(63) == 63);
+		REQUIRE(nn::histogram::bucket_of(64) == 64);
+		REQUIRE(nn::histogram::bucket_of(UINT64_MAX) == nn::histogram::n_buckets - 1);
+		REQUIRE(nn::histogram::highest_of(nn::histogram::n_buckets - 1) == UINT64_MAX);
+		for (size_t i = 1; i < nn::histogram::n_buckets; ++i) {
+			REQUIRE(nn::histogram::lowest_of(i) == nn::histogram::highest_of(i - 1) + 1);
+			REQUIRE(nn::histogram::bucket_of(nn::histogram::lowest_of(i)) == i);
+			REQUIRE(nn::histogram::bucket_of(nn::histogram::highest_of(i)) == i);
+		}
+	}
+	SECTION("buckets are within 3% of their values") {
+		for (size_t i = 64; i < nn::histogram::n_buckets; ++i) {
+			uint64_t width = nn::histogram::highest_of(i) - nn::histogram::lowest_of(i) + 1;
+			bool precise = width * 32 <= nn::histogram::lowest_of(i);
+			REQUIRE(precise);
+		}
+	}
+	SECTION("snapshots give percentiles") {
+		nn::histogram h;
+		for (uint64_t v = 1; v <= 1000; ++v) {
+			h.record(v);
+		}
+		nn::histogram::snapshot s = h.get_snapshot();
+		REQUIRE(s.count() == 1000);
+		REQUIRE(s.sum() == 500500);
+		REQUIRE(s.min() == 1);
+		REQUIRE(s.max() == 1000);
+		REQUIRE(s.mean() == Approx(500.5));
+		REQUIRE(s.percentile(0) == 1);
+		REQUIRE(s.percentile(100) == 1000);
+		uint64_t median = s.percentile(50);
+		REQUIRE(median >= 500);
+		REQUIRE(median <= 515);
+		uint64_t p99 = s.percentile(99);
+		REQUIRE(p99 >= 990);
+		REQUIRE(p99 <= 1000);
+	}
+	SECTION("an empty snapshot reads zero") {
+		nn::histogram h;
+		nn::histogram::snapshot s = h.get_snapshot();
+		REQUIRE(s.count() == 0);
+		REQUIRE(s.min() == 0);
+		REQUIRE(s.max() == 0);
+		REQUIRE(s.percentile(99) == 0);
+	}
+	SECTION("reset hands every value to one snapshot") {
+		nn::histogram h;
+		const int n_threads = 4;
+		const int n_values = 20000;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < n_threads; ++t) {
+			threads.emplace_back([&h, t]() {
+				for (int i = 0; i < n_values; ++i) {
+					h.record(t * 1000 + i % 100);
+				}
+			});
+		}
+		nn::histogram::snapshot total;
+		for (int i = 0; i < 50; ++i) {
+			total.merge(h.reset());
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		total.merge(h.reset());
+		REQUIRE(total.count() == n_threads * n_values);
+		REQUIRE(total.max() == 3099);
+		REQUIRE(h.get_snapshot().count() == 0);
+	}
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/device.hpp>
+#include <nanomsgpp/hop_latency.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <string>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("hop latency stamps are framed", "[hop_latency]") {
+	SECTION("an unstamped body has no stamps") {
+		std::string body(40, 'x');
+		REQUIRE(nn::hop_latency::count(body.data(), body.size()) == 0);
+		REQUIRE(nn::hop_latency::count(body.data(), 0) == 0);
+	}
+	SECTION("a body ending like a stamp has no stamps") {
+		std::string body(40, 'x');
+		body[39] = static_cast<char>(0xa7);
+		body[38] = 2;
+		REQUIRE(nn::hop_latency::count(body.data(), body.size()) == 0);
+		body[38] = 1;
+		REQUIRE(nn::hop_latency::count(body.data(), body.size()) == 0);
+
+		nn::hop_latency recorder(1);
+		REQUIRE(recorder.record(body.data(), body.size()) == body.size());
+	}
+	SECTION("stamps are counted across the parts of a message") {
+		nn::message msg;
+		msg << std::string("hello");
+		REQUIRE(nn::hop_latency::stamp(msg, 1));
+		REQUIRE(nn::hop_latency::stamp(msg, 2));
+		REQUIRE(msg.size() == 3);
+
+		std::string body;
+		for (size_t i = 0; i < msg.size(); ++i) {
+			body.append(msg.at(i).as<char>(), msg.at(i).size());
+		}
+		REQUIRE(body.size() == 5 + 2 * nn::hop_latency::stamp_size);
+		REQUIRE(nn::hop_latency::count(body.data(), body.size()) == 2);
+
+		nn::hop_latency recorder(3);
+		REQUIRE(recorder.record(body.data(), body.size()) == 5);
+		nn::hop_latency::snapshot s = recorder.get_snapshot();
+		REQUIRE(s.end_to_end_ns.count() == 1);
+		REQUIRE(s.hops.size() == 2);
+		REQUIRE(s.hops[0].id == 2);
+		REQUIRE(s.hops[1].id == 3);
+		REQUIRE(s.hops[1].latency_ns.count() == 1);
+	}
+}
+
+TEST_CASE("hop latency is recorded across sockets and devices", "[hop_latency]") {
+	nn::socket sender(nn::socket_domain::sp, nn::socket_type::pair);
+	nn::socket front(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	nn::socket back(nn::socket_domain::sp_raw, nn::socket_type::pair);
+	nn::socket receiver(nn::socket_domain::sp, nn::socket_type::pair);
+	front.bind("inproc://hop-front");
+	back.bind("inproc://hop-back");
+	sender.connect("inproc://hop-front");
+	receiver.connect("inproc://hop-back");
+	receiver.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::device d(front, back);
+	d.set_poll_interval(10);
+	d.add_hook(nn::hop_latency::stamper(2));
+	d.start();
+
+	nn::hop_latency recorder(3);
+	nn::message msg;
+	for (int i = 0; i < 10; ++i) {
+		nn::message out;
+		out << std::string("payload");
+		REQUIRE(nn::hop_latency::stamp(out, 1));
+		sender.sendmsg(std::move(out), false);
+
+		receiver.recvmsg(msg, false);
+		REQUIRE(recorder.record(msg) == 7);
+		REQUIRE(msg.at(0).size() == 7);
+		REQUIRE(std::string(msg.at(0).as<char>(), 7) == "payload");
+	}
+	d.stop();
+
+	nn::hop_latency::snapshot s = recorder.reset();
+	REQUIRE(s.end_to_end_ns.count() == 10);
+	REQUIRE(s.hops.size() == 2);
+	REQUIRE(s.hops[0].id == 2);
+	REQUIRE(s.hops[0].latency_ns.count() == 10);
+	REQUIRE(s.hops[1].id == 3);
+	REQUIRE(s.hops[1].latency_ns.count() == 10);
+	bool ordered = s.hops[0].latency_ns.max() <= s.end_to_end_ns.max();
+	REQUIRE(ordered);
+	REQUIRE(recorder.get_snapshot().end_to_end_ns.count() == 0);
+
+	SECTION("messages received into a new message") {
+		d.start();
+		nn::message out;
+		out << std::string("payload");
+		REQUIRE(nn::hop_latency::stamp(out, 1));
+		sender.sendmsg(std::move(out), false);
+
+		// recvmsg(1) copies the body into a part of its real size
+		std::unique_ptr<nn::message> in = receiver.recvmsg(1, false);
+		size_t stamped = 7 + 2 * nn::hop_latency::stamp_size;
+		REQUIRE(in->at(0).size() == stamped);
+		REQUIRE(recorder.record(*in) == 7);
+		REQUIRE(std::string(in->at(0).as<char>(), in->at(0).size()) == "payload");
+		REQUIRE(recorder.get_snapshot().end_to_end_ns.count() == 1);
+		d.stop();
+	}
+	SECTION("parts of unknown size are refused") {
+		nn::message chunk;
+		chunk << nn::part(16, 0);
+		REQUIRE_THROWS(recorder.record(chunk));
+	}
+	SECTION("unstamped messages pass through") {
+		std::string body("plain");
+		REQUIRE(recorder.record(body.data(), body.size()) == 5);
+		REQUIRE(recorder.get_snapshot().end_to_end_ns.count() == 0);
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/key_router.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	std::map<std::string, std::string> assignment(nn::key_router& router, int n_keys) {
+		std::map<std::string, std::string> a;
+		for (int i = 0; i < n_keys; ++i) {
+			std::string key = "account-" + std::to_string(i);
+			a[key] = router.target_of(key.data(), key.size());
+		}
+		return a;
+	}
+
+}
+
+TEST_CASE("key router spreads keys and moves few of them", "[key_router]") {
+	nn::key_router router;
+	REQUIRE_THROWS(router.target_of("k", 1));
+	for (int i = 0; i < 4; ++i) {
+		router.add_target("inproc://worker" + std::to_string(i));
+	}
+	REQUIRE(router.size() == 4);
+	REQUIRE_THROWS(router.add_target("inproc://worker0"));
+
+	const int n_keys = 10000;
+	std::map<std::string, std::string> before = assignment(router, n_keys);
+	std::map<std::string, int> load;
+	for (auto& a : before) {
+		load[a.second]++;
+	}
+	REQUIRE(load.size() == 4);
+	for (auto& l : load) {
+		REQUIRE(l.second > n_keys / 4 / 2);
+		REQUIRE(l.second < n_keys / 4 * 2);
+	}
+
+	SECTION("removing a target only moves its keys") {
+		REQUIRE(router.remove_target("inproc://worker2"));
+		REQUIRE_FALSE(router.remove_target("inproc://worker2"));
+		std::map<std::string, std::string> after = assignment(router, n_keys);
+		for (auto& a : after) {
+			REQUIRE(a.second != "inproc://worker2");
+			if (before[a.first] != "inproc://worker2") {
+				REQUIRE(a.second == before[a.first]);
+			}
+		}
+	}
+	SECTION("adding a target only moves keys to it") {
+		router.add_target("inproc://worker4");
+		std::map<std::string, std::string> after = assignment(router, n_keys);
+		int moved = 0;
+		for (auto& a : after) {
+			if (a.second != before[a.first]) {
+				REQUIRE(a.second == "inproc://worker4");
+				moved++;
+			}
+		}
+		REQUIRE(moved > n_keys / 5 / 2);
+		REQUIRE(moved < n_keys / 5 * 2);
+	}
+}
+
+TEST_CASE("key router sends keys to the same worker", "[key_router]") {
+	std::vector<nn::socket> workers;
+	nn::key_router router;
+	for (int i = 0; i < 3; ++i) {
+		std::string addr = "inproc://key_worker" + std::to_string(i);
+		workers.emplace_back(nn::socket_domain::sp, nn::socket_type::pull);
+		REQUIRE_NOTHROW(workers.back().bind(addr));
+		workers.back().set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+		router.add_target(addr);
+	}
+
+	std::map<std::string, int> expected;
+	for (int i = 0; i < 30; ++i) {
+		std::string key = "k" + std::to_string(i % 10);
+		nn::message m;
+		m << uint32_t(i);
+		router.sendmsg(key.data(), key.size(), std::move(m), false);
+		expected[router.target_of(key.data(), key.size())]++;
+	}
+
+	uint64_t total = 0;
+	for (int i = 0; i < 3; ++i) {
+		std::string addr = "inproc://key_worker" + std::to_string(i);
+		for (int j = 0; j < expected[addr]; ++j) {
+			REQUIRE(workers[i].recvmsg(1, false)->at(0).size() == sizeof(uint32_t));
+		}
+		REQUIRE_THROWS(workers[i].recvmsg(1, true));
+		nn::key_router::counters c = router.get_counters(addr);
+		REQUIRE(c.messages == static_cast<uint64_t>(expected[addr]));
+		REQUIRE(c.bytes == c.messages * sizeof(uint32_t));
+		total += c.messages;
+	}
+	REQUIRE(total == 30);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/metrics_exporter.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Send an HTTP request to a local port and read the whole response.
+	std::string http_get(uint16_t port, const std::string& request) {
+		int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+		std::string response;
+		if (0 == ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+			::send(fd, request.data(), request.size(), 0);
+			char buf[4096];
+			ssize_t n;
+			while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+				response.append(buf, n);
+			}
+		}
+		::close(fd);
+		return response;
+	}
+
+	bool contains(const std::string& text, const std::string& part) {
+		return text.find(part) != std::string::npos;
+	}
+
+}
+
+TEST_CASE("metrics exporters serve the published text", "[metrics_exporter]") {
+	nn::metrics_registry registry;
+	int value = 1;
+	registry.add("value", [&value](nn::metrics_registry::writer& w) {
+		w.gauge("test_value", "A test value.", "", value);
+	});
+
+	nn::metrics_exporter exporter(registry);
+	exporter.set_poll_interval(10);
+	exporter.set_interval(60000);
+
+	SECTION("over HTTP") {
+		exporter.serve_http(0);
+		REQUIRE(exporter.http_port() != 0);
+		exporter.start();
+		REQUIRE(exporter.running());
+
+		std::string response = http_get(exporter.http_port(), "GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n");
+		REQUIRE(contains(response, "HTTP/1.1 200 OK\r\n"));
+		REQUIRE(contains(response, "Content-Type: text/plain; version=0.0.4"));
+		REQUIRE(contains(response, "\r\n\r\n# HELP test_value A test value.\n"));
+		REQUIRE(contains(response, "test_value 1\n"));
+
+		// scrapes read the published text, which the source does not change
+		value = 2;
+		REQUIRE(contains(http_get(exporter.http_port(), "GET / HTTP/1.0\r\n\r\n"), "test_value 1\n"));
+		registry.collect();
+		REQUIRE(contains(http_get(exporter.http_port(), "GET / HTTP/1.0\r\n\r\n"), "test_value 2\n"));
+
+		REQUIRE(contains(http_get(exporter.http_port(), "GET /other HTTP/1.0\r\n\r\n"), "404"));
+		REQUIRE(contains(http_get(exporter.http_port(), "POST /metrics HTTP/1.0\r\n\r\n"), "405"));
+		exporter.stop();
+		REQUIRE_FALSE(exporter.running());
+	}
+	SECTION("a silent scraper does not hold up stopping") {
+		exporter.serve_http(0);
+		exporter.start();
+		int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(exporter.http_port());
+		inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+		REQUIRE(0 == ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+		// let the exporter accept the connection and wait for the request
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		auto start = std::chrono::steady_clock::now();
+		exporter.stop();
+		bool prompt = std::chrono::steady_clock::now() - start < std::chrono::seconds(1);
+		REQUIRE(prompt);
+		::close(fd);
+	}
+	SECTION("over a reply socket") {
+		exporter.serve_rep("inproc://metrics-exporter");
+		exporter.start();
+
+		nn::socket req(nn::socket_domain::sp, nn::socket_type::request);
+		req.connect("inproc://metrics-exporter");
+		req.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+		req.send_raw("", 0, 0);
+		void* reply = nullptr;
+		int nb = req.recv_raw(&reply, NN_MSG, 0);
+		std::string text(static_cast<char*>(reply), nb);
+		nn_freemsg(reply);
+		REQUIRE(contains(text, "test_value 1\n"));
+		exporter.stop();
+	}
+	SECTION("collecting on an interval") {
+		exporter.set_interval(10);
+		exporter.start();
+		value = 3;
+		bool refreshed = false;
+		for (int i = 0; i < 200 && !refreshed; ++i) {
+			refreshed = contains(*registry.published(), "test_value 3\n");
+			usleep(5000);
+		}
+		REQUIRE(refreshed);
+	}
+}
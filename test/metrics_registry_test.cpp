@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/metrics_registry.hpp>
+
+#include <string>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	bool contains(const std::string& text, const std::string& part) {
+		return text.find(part) != std::string::npos;
+	}
+
+}
+
+TEST_CASE("metrics writers format the Prometheus text format", "[metrics_registry]") {
+	SECTION("samples are grouped into families") {
+		nn::metrics_registry::writer w;
+		w.counter("requests_total", "Requests.", "a=\"1\"", uint64_t(3));
+		w.gauge("depth", "Queue depth.", "", 1.5);
+		w.counter("requests_total", "Requests.", "a=\"2\"", uint64_t(4));
+		REQUIRE(w.str() ==
+			"# HELP depth Queue depth.\n"
+			"# TYPE depth gauge\n"
+			"depth 1.5\n"
+			"# HELP requests_total Requests.\n"
+			"# TYPE requests_total counter\n"
+			"requests_total{a=\"1\"} 3\n"
+			"requests_total{a=\"2\"} 4\n");
+	}
+	SECTION("label values are escaped") {
+		REQUIRE(nn::metrics_registry::writer::label("k", "a\"b\\c\nd") == "k=\"a\\\"b\\\\c\\nd\"");
+	}
+	SECTION("histograms are written as summaries") {
+		nn::histogram h;
+		for (uint64_t v = 1; v <= 100; ++v) {
+			h.record(v);
+		}
+		nn::metrics_registry::writer w;
+		w.summary("latency_seconds", "Latency.", "s=\"x\"", h.get_snapshot(), 0.5);
+		std::string text = w.str();
+		REQUIRE(contains(text, "# TYPE latency_seconds summary\n"));
+		REQUIRE(contains(text, "latency_seconds{s=\"x\",quantile=\"0.5\"} 25\n"));
+		REQUIRE(contains(text, "latency_seconds_sum{s=\"x\"} 2525\n"));
+		REQUIRE(contains(text, "latency_seconds_count{s=\"x\"} 100\n"));
+	}
+}
+
+TEST_CASE("metrics registries publish their sources", "[metrics_registry]") {
+	nn::socket a(nn::socket_domain::sp, nn::socket_type::pair);
+	nn::socket b(nn::socket_domain::sp, nn::socket_type::pair);
+	a.bind("inproc://metrics-registry");
+	b.connect("inproc://metrics-registry");
+	nn::socket_pool pool({ "inproc://metrics-registry-pool" }, 2);
+
+	nn::metrics_registry registry;
+	REQUIRE(registry.published()->empty());
+	registry.add_socket("a", a);
+	registry.add_pool("requests", pool);
+	registry.add("custom", [](nn::metrics_registry::writer& w) {
+		w.gauge("custom_value", "A custom value.", "", 7);
+	});
+
+	a.send_raw("hello", 5, 0);
+	registry.collect();
+	std::shared_ptr<const std::string> first = registry.published();
+	REQUIRE(contains(*first, "nanomsgpp_socket_messages_sent_total{socket=\"a\"} 1\n"));
+	REQUIRE(contains(*first, "nanomsgpp_socket_bytes_copied_total{socket=\"a\"} 5\n"));
+	REQUIRE(contains(*first, "nanomsgpp_pool_checkouts_total{pool=\"requests\"} 0\n"));
+	REQUIRE(contains(*first, "custom_value 7\n"));
+
+	SECTION("published text is not changed by later collections") {
+		a.send_raw("hello", 5, 0);
+		registry.collect();
+		REQUIRE(contains(*first, "nanomsgpp_socket_messages_sent_total{socket=\"a\"} 1\n"));
+		REQUIRE(contains(*registry.published(),
+			"nanomsgpp_socket_messages_sent_total{socket=\"a\"} 2\n"));
+	}
+	SECTION("sources can be removed") {
+		registry.remove("a");
+		registry.collect();
+		REQUIRE_FALSE(contains(*registry.published(), "socket=\"a\""));
+		REQUIRE(contains(*registry.published(), "custom_value 7\n"));
+	}
+}
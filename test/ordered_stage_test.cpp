@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/ordered_stage.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	int parse(nn::message_view& msg) {
+		return std::stoi(std::string(msg.as<char>(), msg.size()));
+	}
+
+}
+
+TEST_CASE("ordered stage keeps the input order", "[ordered_stage]") {
+	nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+	nn::socket input(nn::socket_domain::sp, nn::socket_type::pull);
+	nn::socket output(nn::socket_domain::sp, nn::socket_type::push);
+	nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+	input.bind("inproc://ordered-in");
+	producer.connect("inproc://ordered-in");
+	consumer.bind("inproc://ordered-out");
+	output.connect("inproc://ordered-out");
+	consumer.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 2000);
+
+	// early messages are slow, every tenth is dropped, every seventh is replaced and every
+	// eleventh is cut to its first digit
+	nn::ordered_stage stage(input, output, 4, [](nn::message_view& msg) {
+		int i = parse(msg);
+		if (0 == i % 10) {
+			return (false);
+		}
+		if (0 == i % 3) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		if (0 == i % 7) {
+			std::string body = "r" + std::to_string(i);
+			void* chunk = nn_allocmsg(body.size(), 0);
+			std::memcpy(chunk, body.data(), body.size());
+			msg.replace(chunk, body.size());
+		} else if (0 == i % 11) {
+			msg.resize(1);
+		}
+		return (true);
+	});
+	REQUIRE(stage.size() == 4);
+	stage.set_window(16);
+	stage.set_poll_interval(10);
+	stage.start();
+
+	const int n = 500;
+	for (int i = 1; i <= n; ++i) {
+		std::string body = std::to_string(i);
+		producer.send_raw(body.data(), body.size(), 0);
+	}
+	for (int i = 1; i <= n; ++i) {
+		if (0 == i % 10) {
+			continue;
+		}
+		char buffer[32];
+		int nb = consumer.recv_raw(buffer, sizeof(buffer), 0);
+		std::string expected = ((0 == i % 7) ? "r" : "") + std::to_string(i);
+		if (0 != i % 7 && 0 == i % 11) {
+			expected.resize(1);
+		}
+		REQUIRE(std::string(buffer, nb) == expected);
+	}
+	stage.stop();
+
+	nn::ordered_stage::statistics st = stage.get_statistics();
+	REQUIRE(st.received == n);
+	REQUIRE(st.filtered == n / 10);
+	REQUIRE(st.sent == n - n / 10);
+	REQUIRE(st.dropped == 0);
+	REQUIRE(st.buffered == 0);
+	REQUIRE(st.buffered_bytes == 0);
+	REQUIRE(st.max_buffered < 16);
+	REQUIRE(st.total_wait_ns <= st.max_wait_ns * st.reordered);
+}
+
+TEST_CASE("ordered stage bounds the reorder buffer", "[ordered_stage]") {
+	nn::socket producer(nn::socket_domain::sp, nn::socket_type::push);
+	nn::socket input(nn::socket_domain::sp, nn::socket_type::pull);
+	nn::socket output(nn::socket_domain::sp, nn::socket_type::push);
+	nn::socket consumer(nn::socket_domain::sp, nn::socket_type::pull);
+	input.bind("inproc://bounded-in");
+	producer.connect("inproc://bounded-in");
+	consumer.bind("inproc://bounded-out");
+	output.connect("inproc://bounded-out");
+	consumer.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 2000);
+
+	// the first message holds up the others until the window is full
+	nn::ordered_stage stage(input, output, 2, [](nn::message_view& msg) {
+		if (0 == parse(msg)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		return (true);
+	});
+	stage.set_window(4);
+	stage.set_poll_interval(10);
+	stage.start();
+
+	const int n = 20;
+	for (int i = 0; i < n; ++i) {
+		std::string body = std::to_string(i);
+		producer.send_raw(body.data(), body.size(), 0);
+	}
+	for (int i = 0; i < n; ++i) {
+		char buffer[32];
+		int nb = consumer.recv_raw(buffer, sizeof(buffer), 0);
+		REQUIRE(std::string(buffer, nb) == std::to_string(i));
+	}
+	stage.stop();
+
+	nn::ordered_stage::statistics st = stage.get_statistics();
+	REQUIRE(st.sent == n);
+	REQUIRE(st.stalls > 0);
+	REQUIRE(st.reordered > 0);
+	REQUIRE(st.max_buffered > 0);
+	REQUIRE(st.max_buffered < 4);
+	REQUIRE(st.max_buffered_bytes >= st.max_buffered);
+	REQUIRE(st.max_wait_ns > 0);
+}
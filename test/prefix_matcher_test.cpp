@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/prefix_matcher.hpp>
+
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	std::string instrument(size_t i) {
+		std::string s = "XNAS:" + std::to_string(i * 7919 % 1000003);
+		s.resize(12, '_');
+		return s;
+	}
+
+	std::vector<nn::prefix_matcher::isa> supported_isas() {
+		std::vector<nn::prefix_matcher::isa> isas;
+		for (auto i : { nn::prefix_matcher::isa::scalar, nn::prefix_matcher::isa::sse42,
+				nn::prefix_matcher::isa::avx2 }) {
+			if (nn::prefix_matcher::supported(i)) {
+				isas.push_back(i);
+			}
+		}
+		return isas;
+	}
+
+}
+
+TEST_CASE("prefix matcher finds fixed width prefixes", "[prefix_matcher]") {
+	REQUIRE(nn::prefix_matcher::supported(nn::prefix_matcher::isa::scalar));
+	REQUIRE(nn::prefix_matcher::supported(nn::prefix_matcher::best_isa()));
+	REQUIRE_THROWS(nn::prefix_matcher(0));
+	REQUIRE_THROWS(nn::prefix_matcher(nn::prefix_matcher::max_width + 1));
+
+	for (auto i : supported_isas()) {
+		nn::prefix_matcher m(12, i);
+		REQUIRE(m.get_isa() == i);
+		REQUIRE(m.find("XNAS:0______", 12) == nn::prefix_matcher::npos);
+
+		const size_t n = 20000;
+		for (size_t k = 0; k < n; ++k) {
+			REQUIRE(m.insert(instrument(k).data(), k));
+		}
+		REQUIRE(m.size() == n);
+		for (size_t k = 0; k < n; ++k) {
+			std::string msg = instrument(k) + " bid=101.25";
+			REQUIRE(m.find(msg.data(), msg.size()) == k);
+		}
+		REQUIRE(m.find("XNAS:", 5) == nn::prefix_matcher::npos);
+		REQUIRE(m.find("XNYS:0______", 12) == nn::prefix_matcher::npos);
+
+		// replacing keeps the size, and erased prefixes stop matching without hiding others
+		REQUIRE_FALSE(m.insert(instrument(7).data(), 70));
+		REQUIRE(m.find(instrument(7).data(), 12) == 70);
+		for (size_t k = 0; k < n; k += 2) {
+			REQUIRE(m.erase(instrument(k).data()));
+		}
+		REQUIRE_FALSE(m.erase(instrument(0).data()));
+		REQUIRE(m.size() == n / 2);
+		for (size_t k = 0; k < n; ++k) {
+			uint32_t want = (k % 2) ? ((7 == k) ? 70 : k) : nn::prefix_matcher::npos;
+			REQUIRE(m.find(instrument(k).data(), 12) == want);
+		}
+
+		// deleted slots are reused
+		for (size_t k = 0; k < n; k += 2) {
+			REQUIRE(m.insert(instrument(k).data(), k));
+		}
+		REQUIRE(m.size() == n);
+		REQUIRE(m.find(instrument(0).data(), 12) == 0);
+
+		m.clear();
+		REQUIRE(m.size() == 0);
+		REQUIRE(m.find(instrument(1).data(), 12) == nn::prefix_matcher::npos);
+	}
+}
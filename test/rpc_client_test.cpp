@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/rpc_client.hpp>
+#include <nanomsgpp/server.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("rpc clients pipeline requests", "[rpc_client]") {
+	nn::server srv(nn::socket_type::reply, [](nn::message& request) {
+		nn::message reply;
+		reply << *request.at(0).as<uint32_t>();
+		return reply;
+	}, 4);
+	REQUIRE_NOTHROW(srv.bind("inproc://rpc"));
+	srv.start();
+
+	SECTION("call requires a running client") {
+		nn::rpc_client client;
+		REQUIRE_THROWS(client.call(nn::message(), 100));
+	}
+	SECTION("futures receive their own replies") {
+		nn::rpc_client client;
+		REQUIRE_NOTHROW(client.connect("inproc://rpc"));
+		client.start();
+
+		std::vector<std::future<std::unique_ptr<nn::message>>> replies;
+		for (uint32_t i = 0; i < 100; ++i) {
+			nn::message request;
+			request << i;
+			replies.push_back(client.call(std::move(request)));
+		}
+		for (uint32_t i = 0; i < 100; ++i) {
+			std::unique_ptr<nn::message> reply = replies[i].get();
+			REQUIRE(*reply->at(0).as<uint32_t>() == i);
+		}
+		REQUIRE(client.sent() == 100);
+		REQUIRE(client.completed() == 100);
+		REQUIRE(client.in_flight() == 0);
+	}
+	SECTION("in flight requests are bounded") {
+		nn::rpc_client client(8);
+		REQUIRE_NOTHROW(client.connect("inproc://rpc"));
+		client.start();
+
+		std::atomic<int> done(0);
+		for (uint32_t i = 0; i < 100; ++i) {
+			nn::message request;
+			request << i;
+			client.call(std::move(request), [&](std::unique_ptr<nn::message> reply, int error) {
+				if (0 == error && reply) { done++; }
+			});
+			REQUIRE(client.in_flight() <= 8);
+		}
+		while (client.in_flight() > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		REQUIRE(done == 100);
+	}
+}
+
+TEST_CASE("rpc client requests expire", "[rpc_client]") {
+	nn::socket sink(nn::socket_domain::sp_raw, nn::socket_type::reply);
+	REQUIRE_NOTHROW(sink.bind("inproc://rpc_sink"));
+
+	nn::rpc_client client;
+	REQUIRE_NOTHROW(client.connect("inproc://rpc_sink"));
+	client.start();
+
+	nn::message request;
+	request << uint32_t(1);
+	std::future<std::unique_ptr<nn::message>> reply = client.call(std::move(request), 50);
+	REQUIRE_THROWS(reply.get());
+	REQUIRE(client.timeouts() == 1);
+	REQUIRE(client.in_flight() == 0);
+}
+
+TEST_CASE("rpc clients stop when their socket fails", "[rpc_client]") {
+	nn::socket sink(nn::socket_domain::sp_raw, nn::socket_type::reply);
+	REQUIRE_NOTHROW(sink.bind("inproc://rpc_fail"));
+
+	nn::rpc_client client;
+	REQUIRE_NOTHROW(client.connect("inproc://rpc_fail"));
+	client.start();
+
+	nn::message request;
+	request << uint32_t(1);
+	std::future<std::unique_ptr<nn::message>> reply = client.call(std::move(request), 60000);
+	client.get_socket().close();
+
+	// the pending call fails long before its deadline, and no more calls are accepted
+	REQUIRE(std::future_status::ready == reply.wait_for(std::chrono::seconds(5)));
+	REQUIRE_THROWS(reply.get());
+	REQUIRE_FALSE(client.running());
+	REQUIRE(client.in_flight() == 0);
+	REQUIRE_THROWS(client.call(nn::message(), 100));
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/server.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("worker pools consume every item", "[server]") {
+	SECTION("single worker") {
+		std::atomic<int> sum(0);
+		nn::worker_pool<int> pool(1, [&](int& i) { sum += i; });
+		for (int i = 1; i <= 100; ++i) {
+			pool.submit(int(i));
+		}
+		pool.stop();
+		REQUIRE(sum == 5050);
+		REQUIRE(pool.pending() == 0);
+	}
+	SECTION("many workers") {
+		std::atomic<int> sum(0);
+		nn::worker_pool<int> pool(4, [&](int& i) { sum += i; });
+		REQUIRE(pool.size() == 4);
+		for (int i = 1; i <= 1000; ++i) {
+			pool.submit(int(i));
+		}
+		pool.stop();
+		REQUIRE(sum == 500500);
+	}
+}
+
+TEST_CASE("servers answer requests", "[server]") {
+	SECTION("invalid socket type") {
+		REQUIRE_THROWS(nn::server(nn::socket_type::pair, [](nn::message&) { return nn::message(); }));
+	}
+	SECTION("reply to requests") {
+		nn::server srv(nn::socket_type::reply, [](nn::message& request) {
+			nn::message reply;
+			reply << std::string(request.at(0).as<char>(), request.at(0).size());
+			return reply;
+		}, 4);
+		REQUIRE_NOTHROW(srv.bind("inproc://server"));
+		srv.start();
+
+		nn::socket client(nn::socket_domain::sp, nn::socket_type::request);
+		client.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+		REQUIRE_NOTHROW(client.connect("inproc://server"));
+
+		for (int i = 0; i < 10; ++i) {
+			nn::message request;
+			request << std::to_string(i);
+			client.sendmsg(std::move(request), false);
+
+			std::unique_ptr<nn::message> reply = client.recvmsg(1, false);
+			REQUIRE(std::string(reply->at(0).as<char>(), reply->at(0).size()) == std::to_string(i));
+		}
+
+		srv.stop();
+		REQUIRE(srv.requests() == 10);
+		REQUIRE(srv.replies() == 10);
+		REQUIRE(srv.errors() == 0);
+	}
+	SECTION("stop when the socket fails") {
+		nn::server srv(nn::socket_type::reply, [](nn::message&) { return nn::message(); }, 1);
+		srv.set_poll_interval(10);
+		srv.start();
+		REQUIRE(srv.running());
+		srv.get_socket().close();
+		for (int i = 0; i < 200 && srv.running(); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		REQUIRE_FALSE(srv.running());
+		srv.stop();
+	}
+}
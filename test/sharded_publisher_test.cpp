@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/sharded_publisher.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("sharded publisher keeps topics on one shard", "[sharded_publisher]") {
+	std::vector<std::string> endpoints = { "inproc://shard0", "inproc://shard1", "inproc://shard2" };
+	nn::sharded_publisher publisher(endpoints);
+	REQUIRE(publisher.size() == 3);
+
+	// find topics landing on different shards
+	std::vector<std::string> topics;
+	std::map<size_t, std::string> by_shard;
+	for (int i = 0; by_shard.size() < 3; ++i) {
+		std::string t = "T" + std::to_string(i) + ":";
+		by_shard.emplace(nn::sharded_publisher::shard_of(t.data(), t.size(), 3), t);
+	}
+
+	nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+	sub.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+	std::vector<size_t> connected = nn::sharded_publisher::subscribe(sub, endpoints,
+		{ by_shard[0], by_shard[2] });
+	REQUIRE(connected == std::vector<size_t>({ 0, 2 }));
+
+	publisher.start();
+	const int n = 100;
+	for (int i = 0; i < n; ++i) {
+		for (auto& s : by_shard) {
+			std::string body = s.second + std::to_string(i);
+			REQUIRE(publisher.publish(body.data(), body.size(), s.second.size()));
+		}
+	}
+
+	// each topic arrives in order, and the topic of the unconnected shard not at all
+	std::map<std::string, int> next;
+	for (int i = 0; i < 2 * n; ++i) {
+		std::unique_ptr<nn::message> m = sub.recvmsg(1, false);
+		std::string body(m->at(0).as<char>(), m->at(0).size());
+		std::string topic = body.substr(0, body.find(':') + 1);
+		REQUIRE(topic != by_shard[1]);
+		REQUIRE(body == topic + std::to_string(next[topic]++));
+	}
+	publisher.stop();
+
+	for (size_t s = 0; s < publisher.size(); ++s) {
+		nn::sharded_publisher::statistics st = publisher.get_statistics(s);
+		REQUIRE(st.published == n);
+		REQUIRE(st.sent == n);
+		REQUIRE(st.dropped == 0);
+	}
+}
+
+TEST_CASE("sharded publisher drops when a queue is full", "[sharded_publisher]") {
+	nn::sharded_publisher publisher({ "inproc://shard_full" });
+	publisher.set_queue_capacity(2);
+	REQUIRE(publisher.publish("a:1", 3, 2));
+	REQUIRE(publisher.publish("a:2", 3, 2));
+	REQUIRE_FALSE(publisher.publish("a:3", 3, 2));
+	REQUIRE(publisher.get_statistics(0).dropped == 1);
+	REQUIRE_THROWS(publisher.publish("a", 1, 2));
+	REQUIRE_THROWS(nn::sharded_publisher(std::vector<std::string>()));
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/shared_payload.hpp>
+#include <nanomsgpp/socket.hpp>
+
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("shared payloads share one chunk", "[shared_payload]") {
+	std::string body = "price EUR 1.10";
+	nn::shared_payload a(body.data(), body.size());
+	REQUIRE(a.size() == body.size());
+	REQUIRE(std::string(a.as<char>(), a.size()) == body);
+	REQUIRE(a.use_count() == 1);
+
+	nn::shared_payload b = a;
+	REQUIRE(b.data() == a.data());
+	REQUIRE(a.use_count() == 2);
+	REQUIRE(b.release() == nullptr);
+
+	nn::shared_payload c = std::move(b);
+	REQUIRE(b.use_count() == 0);
+	REQUIRE(c.use_count() == 2);
+	c = nn::shared_payload();
+	REQUIRE(a.use_count() == 1);
+
+	void* chunk = a.release();
+	REQUIRE(chunk != nullptr);
+	REQUIRE(a.size() == 0);
+	REQUIRE(std::string(static_cast<char*>(chunk), body.size()) == body);
+	nn_freemsg(chunk);
+
+	SECTION("messages are serialized once") {
+		nn::message m;
+		m << uint32_t(1) << uint32_t(2);
+		nn::shared_payload p(m);
+		REQUIRE(p.size() == 2 * sizeof(uint32_t));
+		REQUIRE(p.as<uint32_t>()[0] == 1);
+		REQUIRE(p.as<uint32_t>()[1] == 2);
+	}
+}
+
+TEST_CASE("shared payloads fan out to many sockets", "[shared_payload]") {
+	const int n = 4;
+	std::vector<nn::socket> senders;
+	std::vector<nn::socket> receivers;
+	for (int i = 0; i < n; ++i) {
+		std::string addr = "inproc://fanout" + std::to_string(i);
+		senders.emplace_back(nn::socket_domain::sp, nn::socket_type::push);
+		REQUIRE_NOTHROW(senders.back().bind(addr));
+		receivers.emplace_back(nn::socket_domain::sp, nn::socket_type::pull);
+		REQUIRE_NOTHROW(receivers.back().connect(addr));
+		receivers.back().set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+	}
+
+	std::string body(1000, 'x');
+	nn::shared_payload p(body.data(), body.size());
+	for (int i = 0; i < n - 1; ++i) {
+		REQUIRE(senders[i].sendmsg(p, false) == static_cast<int>(body.size()));
+	}
+	REQUIRE(senders[n - 1].sendmsg(std::move(p), false) == static_cast<int>(body.size()));
+	REQUIRE(p.use_count() == 0);
+
+	for (auto& r : receivers) {
+		std::unique_ptr<nn::message> m = r.recvmsg(1, false);
+		REQUIRE(std::string(m->at(0).as<char>(), m->at(0).size()) == body);
+	}
+}
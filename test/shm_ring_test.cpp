@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/exception.hpp>
+#include <nanomsgpp/shm_ring.hpp>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("shared memory ring sends and receives", "[shm_ring]") {
+	std::unique_ptr<nn::shm_ring> ring = nn::shm_ring::create(1000);
+	REQUIRE(ring->capacity() == 4096);
+	REQUIRE(ring->max_message_size() == 2040);
+
+	char buffer[64];
+	REQUIRE(ring->recv_raw(buffer, sizeof(buffer), NN_DONTWAIT) == -1);
+	REQUIRE(ring->recvmsg() == nullptr);
+
+	REQUIRE(ring->send_raw("hello", 5, 0) == 5);
+	REQUIRE(ring->recv_raw(buffer, sizeof(buffer), 0) == 5);
+	REQUIRE(std::string(buffer, 5) == "hello");
+
+	nn::message msg;
+	msg << std::string("two ") << std::string("parts");
+	REQUIRE(ring->sendmsg(std::move(msg)) == 9);
+	std::unique_ptr<nn::message> received = ring->recvmsg();
+	REQUIRE(received != nullptr);
+	REQUIRE(received->size() == 1);
+	REQUIRE(std::string(received->at(0).as<char>(), received->at(0).size()) == "two parts");
+
+	// a message which can never fit is refused, and a full ring reports it
+	std::string big(2041, 'x');
+	REQUIRE_THROWS(ring->send_raw(big.data(), big.size(), 0));
+	big.resize(2040);
+	REQUIRE(ring->send_raw(big.data(), big.size(), NN_DONTWAIT) == 2040);
+	REQUIRE(ring->send_raw(big.data(), big.size(), NN_DONTWAIT) == -1);
+	ring->set_timeout(10);
+	REQUIRE(ring->send_raw(big.data(), big.size(), 0) == -1);
+	REQUIRE(ring->recv_raw(buffer, sizeof(buffer), 0) == 2040);
+	REQUIRE(ring->recv_raw(buffer, sizeof(buffer), 0) == -1);
+}
+
+TEST_CASE("shared memory ring wraps around in place", "[shm_ring]") {
+	std::unique_ptr<nn::shm_ring> ring = nn::shm_ring::create(4096);
+	for (int i = 0; i < 1000; ++i) {
+		size_t size = (i * 37) % 700;
+		nn::shm_ring::slot s;
+		REQUIRE(ring->reserve(size, s));
+		for (size_t j = 0; j < size; ++j) {
+			s.data[j] = static_cast<unsigned char>(i + j);
+		}
+		ring->commit(s);
+
+		nn::shm_ring::slot r;
+		REQUIRE(ring->peek(r));
+		REQUIRE(r.size == size);
+		REQUIRE(r.data == s.data);
+		bool intact = true;
+		for (size_t j = 0; j < size; ++j) {
+			intact = intact && r.data[j] == static_cast<unsigned char>(i + j);
+		}
+		REQUIRE(intact);
+		ring->release(r);
+	}
+}
+
+TEST_CASE("shared memory ring keeps the order of each sender", "[shm_ring]") {
+	std::unique_ptr<nn::shm_ring> ring = nn::shm_ring::create(16384);
+	std::unique_ptr<nn::shm_ring> attached = nn::shm_ring::attach(ring->get_fd());
+	const int n_senders = 4;
+	const int n = 20000;
+
+	std::vector<std::thread> senders;
+	for (int t = 0; t < n_senders; ++t) {
+		senders.emplace_back([&, t]() {
+			for (int i = 0; i < n; ++i) {
+				int body[2] = { t, i };
+				attached->send_raw(body, sizeof(body) + (i % 5) * 8, 0);
+			}
+		});
+	}
+	std::vector<int> next(n_senders, 0);
+	for (int i = 0; i < n_senders * n; ++i) {
+		nn::shm_ring::slot s;
+		REQUIRE(ring->peek(s, false));
+		int body[2];
+		std::memcpy(body, s.data, sizeof(body));
+		REQUIRE(body[1] == next[body[0]]++);
+		ring->release(s);
+	}
+	for (auto& t : senders) {
+		t.join();
+	}
+	REQUIRE(next == std::vector<int>(n_senders, n));
+}
+
+TEST_CASE("shared memory ring is shared with another process", "[shm_ring]") {
+	std::unique_ptr<nn::shm_ring> ring = nn::shm_ring::create(65536);
+	std::string path = ring->path();
+	pid_t child = fork();
+	REQUIRE(child >= 0);
+	if (0 == child) {
+		std::unique_ptr<nn::shm_ring> peer = nn::shm_ring::attach(path);
+		for (int i = 0; i < 1000; ++i) {
+			std::string body = "message " + std::to_string(i);
+			peer->send_raw(body.data(), body.size(), 0);
+		}
+		_exit(0);
+	}
+	ring->set_timeout(5000);
+	for (int i = 0; i < 1000; ++i) {
+		char buffer[32];
+		int nb = ring->recv_raw(buffer, sizeof(buffer), 0);
+		REQUIRE(std::string(buffer, nb) == "message " + std::to_string(i));
+	}
+	int status = 0;
+	REQUIRE(waitpid(child, &status, 0) == child);
+	REQUIRE(WIFEXITED(status));
+
+	REQUIRE_THROWS(nn::shm_ring::attach(std::string("/dev/null")));
+}
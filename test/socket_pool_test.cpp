@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/server.hpp>
+#include <nanomsgpp/socket_pool.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("socket pools lend request sockets", "[socket_pool]") {
+	nn::server srv(nn::socket_type::reply, [](nn::message& request) {
+		nn::message reply;
+		reply << *request.at(0).as<uint32_t>();
+		return reply;
+	}, 2);
+	REQUIRE_NOTHROW(srv.bind("inproc://pool"));
+	srv.start();
+
+	std::vector<std::string> addrs = { "inproc://pool" };
+	auto configure = [](nn::socket& s) {
+		s.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+	};
+
+	SECTION("sockets are created lazily") {
+		nn::socket_pool pool(addrs, 4, configure);
+		REQUIRE(pool.get_metrics().size == 0);
+		{
+			nn::socket_pool::lease l = pool.checkout();
+			REQUIRE(pool.get_metrics().size == 1);
+			REQUIRE(pool.get_metrics().idle == 0);
+		}
+		REQUIRE(pool.get_metrics().idle == 1);
+		{
+			nn::socket_pool::lease l = pool.checkout();
+			REQUIRE(pool.get_metrics().created == 1);
+		}
+		pool.reserve(3);
+		REQUIRE(pool.get_metrics().size == 3);
+		REQUIRE(pool.get_metrics().idle == 3);
+	}
+	SECTION("checkout waits at the maximum size") {
+		nn::socket_pool pool(addrs, 1, configure);
+		nn::socket_pool::lease l = pool.checkout();
+		REQUIRE_THROWS(pool.checkout(10));
+
+		nn::socket_pool::metrics m = pool.get_metrics();
+		REQUIRE(m.waits == 1);
+		REQUIRE(m.timeouts == 1);
+		REQUIRE(m.max_wait_ns > 0);
+	}
+	SECTION("invalidated sockets are evicted") {
+		nn::socket_pool pool(addrs, 2, configure);
+		{
+			nn::socket_pool::lease l = pool.checkout();
+			l.invalidate();
+		}
+		nn::socket_pool::metrics m = pool.get_metrics();
+		REQUIRE(m.evicted == 1);
+		REQUIRE(m.size == 0);
+	}
+	SECTION("closed sockets are evicted") {
+		nn::socket_pool pool(addrs, 2, configure);
+		{
+			nn::socket_pool::lease l = pool.checkout();
+			l->close();
+		}
+		nn::socket_pool::metrics m = pool.get_metrics();
+		REQUIRE(m.evicted == 1);
+		REQUIRE(m.size == 0);
+	}
+	SECTION("idle sockets expire") {
+		nn::socket_pool pool(addrs, 2, configure);
+		pool.reserve(2);
+		pool.set_idle_timeout(10);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		{
+			nn::socket_pool::lease l = pool.checkout();
+			nn::socket_pool::metrics m = pool.get_metrics();
+			REQUIRE(m.expired == 2);
+			REQUIRE(m.created == 3);
+			REQUIRE(m.size == 1);
+		}
+		REQUIRE(pool.get_metrics().idle == 1);
+	}
+	SECTION("the maximum size must be positive") {
+		REQUIRE_THROWS(nn::socket_pool(addrs, 0, configure));
+	}
+	SECTION("threads share the pool") {
+		nn::socket_pool pool(addrs, 2, configure);
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < 4; ++t) {
+			threads.emplace_back([&pool, t]() {
+				for (uint32_t i = 0; i < 25; ++i) {
+					nn::socket_pool::lease l = pool.checkout();
+					nn::message request;
+					request << (t * 100 + i);
+					std::unique_ptr<nn::message> reply = l.request(std::move(request));
+					if (*reply->at(0).as<uint32_t>() != t * 100 + i) {
+						l.invalidate();
+					}
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		nn::socket_pool::metrics m = pool.get_metrics();
+		REQUIRE(m.checkouts == 100);
+		REQUIRE(m.evicted == 0);
+		REQUIRE(m.size <= 2);
+	}
+}
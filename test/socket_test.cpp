@@ -24,6 +24,9 @@
 
 #include <nanomsgpp/socket.hpp>
 
+#include <cstring>
+#include <string>
+
 namespace nn = nanomsgpp;
 
 TEST_CASE("sockets can be manipulated", "[socket]") {
@@ -95,3 +98,130 @@ TEST_CASE("sockets can be manipulated", "[socket]") {
 		REQUIRE_NOTHROW(socket.shutdown("tcp://localhost:3000"));
 	}
 }
+
+TEST_CASE("sockets keep statistics", "[socket]") {
+	nn::socket a(nn::socket_domain::sp, nn::socket_type::pair);
+	nn::socket b(nn::socket_domain::sp, nn::socket_type::pair);
+	a.bind("inproc://socket-stats");
+	b.connect("inproc://socket-stats");
+
+	SECTION("counts copied and zero-copy bytes") {
+		a.send_raw("hello", 5, 0);
+		char buf[16];
+		REQUIRE(b.recv_raw(buf, sizeof(buf), 0) == 5);
+
+		void* chunk = nn_allocmsg(3, 0);
+		a.send_raw(&chunk, NN_MSG, 0);
+		void* received = nullptr;
+		REQUIRE(b.recv_raw(&received, NN_MSG, 0) == 3);
+		nn_freemsg(received);
+
+		nn::socket::statistics sa = a.stats();
+		nn::socket::statistics sb = b.stats();
+		REQUIRE(sa.bytes_copied == 5);
+		REQUIRE(sa.bytes_zero_copy == 3);
+		REQUIRE(sb.bytes_copied == 5);
+		REQUIRE(sb.bytes_zero_copy == 3);
+		REQUIRE(sa.messages_sent == 2);
+		REQUIRE(sb.messages_received == 2);
+		REQUIRE(sa.bytes_sent == 8);
+		REQUIRE(sb.bytes_received == 8);
+		REQUIRE(sa.errors == 0);
+	}
+	SECTION("hands nn_allocmsg parts to nanomsg") {
+		nn::part chunk(3, 0);
+		std::memcpy(chunk.as<char>(), "abc", 3);
+		nn::message msg;
+		msg << std::move(chunk);
+		REQUIRE(a.sendmsg(std::move(msg), false) == 3);
+		REQUIRE(msg.size() == 0);
+		char buf[16];
+		REQUIRE(b.recv_raw(buf, sizeof(buf), 0) == 3);
+		REQUIRE(std::string(buf, 3) == "abc");
+
+		nn::socket::statistics sa = a.stats();
+		REQUIRE(sa.bytes_zero_copy == 3);
+		REQUIRE(sa.bytes_copied == 0);
+	}
+	SECTION("counts failures") {
+		char buf[16];
+		REQUIRE_THROWS(b.recv_raw(buf, sizeof(buf), NN_DONTWAIT));
+		REQUIRE_THROWS(b.connect("invalid"));
+		nn::socket::statistics sb = b.stats();
+		REQUIRE(sb.would_block == 1);
+		REQUIRE(sb.errors == 2);
+	}
+	SECTION("survives a move") {
+		a.send_raw("hello", 5, 0);
+		nn::socket moved(std::move(a));
+		REQUIRE(moved.stats().bytes_copied == 5);
+	}
+	SECTION("reads zero from a closed socket") {
+		a.send_raw("hello", 5, 0);
+		a.close();
+		nn::socket::statistics sa = a.stats();
+		REQUIRE(sa.messages_sent == 0);
+		REQUIRE(sa.bytes_copied == 5);
+	}
+}
+
+TEST_CASE("sockets record latency histograms", "[socket]") {
+	nn::socket req(nn::socket_domain::sp, nn::socket_type::request);
+	nn::socket rep(nn::socket_domain::sp, nn::socket_type::reply);
+	rep.bind("inproc://socket-histograms");
+	req.connect("inproc://socket-histograms");
+
+	char buf[16];
+	for (int i = 0; i < 10; ++i) {
+		req.send_raw("ping", 4, 0);
+		rep.recv_raw(buf, sizeof(buf), 0);
+		rep.send_raw("pong!", 5, 0);
+		req.recv_raw(buf, sizeof(buf), 0);
+	}
+
+	nn::socket::histograms h = req.get_histograms();
+	if (!nn::socket::histograms_enabled()) {
+		REQUIRE(h.send_ns.count() == 0);
+		REQUIRE(h.round_trip_ns.count() == 0);
+		return;
+	}
+	REQUIRE(h.send_ns.count() == 10);
+	REQUIRE(h.recv_ns.count() == 10);
+	REQUIRE(h.send_bytes.max() == 4);
+	REQUIRE(h.recv_bytes.max() == 5);
+	REQUIRE(h.round_trip_ns.count() == 10);
+	REQUIRE(rep.get_histograms().round_trip_ns.count() == 0);
+
+	nn::socket::histograms reset = req.reset_histograms();
+	REQUIRE(reset.send_ns.count() == 10);
+	REQUIRE(req.get_histograms().send_ns.count() == 0);
+}
+
+TEST_CASE("raw request sockets record no round trips", "[socket]") {
+	nn::socket req(nn::socket_domain::sp_raw, nn::socket_type::request);
+	nn::socket rep(nn::socket_domain::sp, nn::socket_type::reply);
+	rep.bind("inproc://socket-raw-histograms");
+	req.connect("inproc://socket-raw-histograms");
+
+	char buf[16];
+	for (uint32_t i = 0; i < 10; ++i) {
+		nn::message request;
+		request << i;
+		// the request id, with the top bit marking the end of the backtrace
+		std::string header(4, '\0');
+		header[0] = static_cast<char>(0x80);
+		header[3] = static_cast<char>(i);
+		request.set_header(header);
+		req.sendmsg(std::move(request), false);
+		rep.recv_raw(buf, sizeof(buf), 0);
+		rep.send_raw("pong!", 5, 0);
+		REQUIRE(req.recvmsg(1, false)->header() == header);
+	}
+
+	nn::socket::histograms h = req.get_histograms();
+	if (nn::socket::histograms_enabled()) {
+		REQUIRE(h.send_ns.count() == 10);
+		REQUIRE(h.recv_ns.count() == 10);
+	}
+	REQUIRE(h.round_trip_ns.count() == 0);
+}
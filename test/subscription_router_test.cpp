@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/socket.hpp>
+#include <nanomsgpp/subscription_router.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+TEST_CASE("subscription router matches the longest topic", "[subscription_router]") {
+	nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+	nn::subscription_router router(sub);
+
+	std::vector<std::string> seen;
+	auto record = [&seen](const std::string& name) {
+		return [&seen, name](nn::message_view&) { seen.push_back(name); };
+	};
+	router.subscribe("prices", record("prices"));
+	router.subscribe("prices.eur", record("eur"));
+	router.subscribe("news", record("news"));
+	REQUIRE(router.size() == 3);
+
+	auto call = [&router](const std::string& s) {
+		const nn::subscription_router::handler* h = router.match(s.data(), s.size());
+		if (h != nullptr) {
+			std::string copy = s;
+			void* body = &copy[0];
+			nn::message_view view(&body, copy.size(), nullptr, 0);
+			(*h)(view);
+		}
+		return h != nullptr;
+	};
+
+	REQUIRE(call("prices.usd 1.0"));
+	REQUIRE(call("prices.eur 0.9"));
+	REQUIRE(call("news today"));
+	REQUIRE_FALSE(call("weather"));
+	REQUIRE_FALSE(call("price"));
+	REQUIRE(seen == std::vector<std::string>({ "prices", "eur", "news" }));
+
+	SECTION("a failed subscription leaves the router unchanged") {
+		sub.close();
+		REQUIRE_THROWS(router.subscribe("prices.gbp", record("gbp")));
+		REQUIRE(router.size() == 3);
+		REQUIRE(call("prices.gbp 0.8"));
+		REQUIRE(seen.back() == "prices");
+	}
+	SECTION("subscribing again replaces the handler") {
+		router.subscribe("news", record("breaking"));
+		REQUIRE(router.size() == 3);
+		REQUIRE(call("news"));
+		REQUIRE(seen.back() == "breaking");
+	}
+	SECTION("unsubscribing falls back to shorter topics") {
+		REQUIRE(router.unsubscribe("prices.eur"));
+		REQUIRE_FALSE(router.unsubscribe("prices.eur"));
+		REQUIRE_FALSE(router.unsubscribe("prices.e"));
+		REQUIRE(router.size() == 2);
+		REQUIRE(call("prices.eur 0.9"));
+		REQUIRE(seen.back() == "prices");
+
+		REQUIRE(router.unsubscribe("prices"));
+		REQUIRE_FALSE(call("prices.eur 0.9"));
+
+		// freed nodes are reused
+		router.subscribe("prices.gbp", record("gbp"));
+		REQUIRE(call("prices.gbp 0.8"));
+		REQUIRE(seen.back() == "gbp");
+	}
+	SECTION("the empty topic matches everything") {
+		router.subscribe("", record("all"));
+		REQUIRE(call("weather"));
+		REQUIRE(seen.back() == "all");
+		REQUIRE(call("news"));
+		REQUIRE(seen.back() == "news");
+	}
+}
+
+TEST_CASE("subscription router dispatches received messages", "[subscription_router]") {
+	nn::socket pub(nn::socket_domain::sp, nn::socket_type::publish);
+	REQUIRE_NOTHROW(pub.bind("inproc://router"));
+	nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+	REQUIRE_NOTHROW(sub.connect("inproc://router"));
+	sub.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 1000);
+
+	nn::subscription_router router(sub);
+	std::vector<std::string> a, b;
+	router.subscribe("a.", [&a](nn::message_view& msg) {
+		a.push_back(std::string(msg.as<char>(), msg.size()));
+	});
+	router.subscribe("b.", [&b](nn::message_view& msg) {
+		b.push_back(std::string(msg.as<char>(), msg.size()));
+	});
+
+	for (const char* s : { "a.1", "c.1", "b.1", "a.2" }) {
+		pub.send_raw(s, std::strlen(s), 0);
+	}
+	REQUIRE(router.dispatch(false));
+	REQUIRE(router.dispatch(false));
+	REQUIRE(router.dispatch(false));
+	REQUIRE_FALSE(router.dispatch());
+
+	REQUIRE(a == std::vector<std::string>({ "a.1", "a.2" }));
+	REQUIRE(b == std::vector<std::string>({ "b.1" }));
+	REQUIRE(router.dispatched() == 3);
+	REQUIRE(router.unmatched() == 0);
+}
+
+TEST_CASE("subscription router matches fixed width topics", "[subscription_router]") {
+	nn::socket sub(nn::socket_domain::sp, nn::socket_type::subscribe);
+	nn::subscription_router router(sub);
+	router.set_topic_width(4);
+
+	int hits = 0;
+	router.subscribe("EURU", [&hits](nn::message_view&) { hits += 1; });
+	router.subscribe("GBPU", [&hits](nn::message_view&) { hits += 10; });
+	REQUIRE_THROWS(router.subscribe("EUR", [](nn::message_view&) {}));
+	REQUIRE_THROWS(router.set_topic_width(3));
+
+	REQUIRE(router.match("EURUSD 1.1", 10) != nullptr);
+	REQUIRE(router.match("EUR", 3) == nullptr);
+	REQUIRE(router.match("JPYUSD", 6) == nullptr);
+	std::string msg = "GBPUSD";
+	void* body = &msg[0];
+	nn::message_view view(&body, msg.size(), nullptr, 0);
+	(*router.match(msg.data(), msg.size()))(view);
+	REQUIRE(hits == 10);
+
+	REQUIRE(router.unsubscribe("GBPU"));
+	REQUIRE_FALSE(router.unsubscribe("GBPU"));
+	REQUIRE_FALSE(router.unsubscribe("GBP"));
+	REQUIRE(router.match("GBPUSD", 6) == nullptr);
+	REQUIRE(router.size() == 1);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2014 Christopher Gilbert <christopher.john.gilbert@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "catch.hpp"
+
+#include <nanomsgpp/exception.hpp>
+#include <nanomsgpp/socket.hpp>
+#include <nanomsgpp/survey.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace nn = nanomsgpp;
+
+namespace {
+
+	// Respondents answering each survey with their index, the slowest after a delay.
+	class respondents {
+		std::vector<std::thread> d_threads;
+		std::atomic<bool>        d_running;
+
+	public:
+		respondents(const std::string& addr, int n, int slow_ms) : d_running(true) {
+			for (int i = 0; i < n; ++i) {
+				d_threads.emplace_back([this, addr, i, n, slow_ms]() {
+					nn::socket s(nn::socket_domain::sp, nn::socket_type::respondent);
+					s.connect(addr);
+					s.set_option(NN_SOL_SOCKET, nn::socket_option::receive_timeout, 20);
+					while (d_running.load()) {
+						try {
+							s.recvmsg(1, false);
+						} catch (nn::exception&) {
+							continue;
+						}
+						if (i == n - 1) {
+							std::this_thread::sleep_for(std::chrono::milliseconds(slow_ms));
+						}
+						nn::message m;
+						m << uint32_t(i);
+						s.sendmsg(std::move(m), false);
+					}
+				});
+			}
+		}
+
+		~respondents() {
+			d_running.store(false);
+			for (auto& t : d_threads) {
+				t.join();
+			}
+		}
+	};
+
+}
+
+TEST_CASE("surveys stream responses into a reducer", "[survey]") {
+	nn::socket surveyor(nn::socket_domain::sp, nn::socket_type::surveyor);
+	REQUIRE_NOTHROW(surveyor.bind("inproc://survey"));
+	respondents r("inproc://survey", 4, 150);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	nn::survey s(surveyor);
+	s.set_deadline(500);
+	REQUIRE(surveyor.get_option<int>(NN_SURVEYOR, nn::socket_option::surveyor_deadline) == 500);
+
+	uint32_t sum = 0;
+	auto add = [&sum](nn::message_view& response) { sum += *response.as<uint32_t>(); };
+
+	SECTION("until the deadline") {
+		nn::message q;
+		q << uint32_t(0);
+		nn::survey::result res = s.run(std::move(q), add);
+		REQUIRE(res.responses == 4);
+		REQUIRE(sum == 0 + 1 + 2 + 3);
+		REQUIRE(res.complete);
+		REQUIRE(res.elapsed_ns >= 400000000);
+		REQUIRE(res.p50_ns <= res.p90_ns);
+		REQUIRE(res.p90_ns <= res.max_ns);
+		REQUIRE(res.max_ns >= 150000000);
+	}
+	SECTION("until k responses arrive") {
+		s.complete_after(3);
+		nn::message q;
+		q << uint32_t(0);
+		nn::survey::result res = s.run(std::move(q), add);
+		REQUIRE(res.responses == 3);
+		REQUIRE(res.complete);
+		REQUIRE(sum == 0 + 1 + 2);
+		REQUIRE(res.elapsed_ns < 150000000);
+	}
+	SECTION("late responses are not counted by the next survey") {
+		s.complete_after(3);
+		nn::message q1;
+		q1 << uint32_t(0);
+		REQUIRE(s.run(std::move(q1), add).responses == 3);
+		// let the slow respondent answer the finished survey
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+		s.complete_after(0);
+		sum = 0;
+		nn::message q2;
+		q2 << uint32_t(0);
+		nn::survey::result res = s.run(std::move(q2), add);
+		REQUIRE(res.responses == 4);
+		REQUIRE(sum == 0 + 1 + 2 + 3);
+	}
+	SECTION("until a quorum responds") {
+		s.set_quorum(4, 0.5);
+		nn::message q;
+		q << uint32_t(0);
+		nn::survey::result res = s.run(std::move(q), add);
+		REQUIRE(res.responses == 2);
+		REQUIRE(res.complete);
+	}
+	SECTION("a quorum which is not reached") {
+		s.set_deadline(100);
+		s.complete_after(4);
+		nn::message q;
+		q << uint32_t(0);
+		nn::survey::result res = s.run(std::move(q), add);
+		REQUIRE(res.responses == 3);
+		REQUIRE_FALSE(res.complete);
+	}
+}